@@ -87,6 +87,55 @@ enum spa_audio_layout {
 	SPA_AUDIO_LAYOUT_NON_INTERLEAVED
 };
 
+/**
+ * spa_audio_channel:
+ * @SPA_AUDIO_CHANNEL_FL: front left
+ * @SPA_AUDIO_CHANNEL_FR: front right
+ * @SPA_AUDIO_CHANNEL_FC: front center
+ * @SPA_AUDIO_CHANNEL_LFE: low frequency effects
+ * @SPA_AUDIO_CHANNEL_RL: rear left
+ * @SPA_AUDIO_CHANNEL_RR: rear right
+ * @SPA_AUDIO_CHANNEL_FLC: front left of center
+ * @SPA_AUDIO_CHANNEL_FRC: front right of center
+ * @SPA_AUDIO_CHANNEL_RC: rear center
+ * @SPA_AUDIO_CHANNEL_SL: side left
+ * @SPA_AUDIO_CHANNEL_SR: side right
+ * @SPA_AUDIO_CHANNEL_TC: top center
+ * @SPA_AUDIO_CHANNEL_TFL: top front left
+ * @SPA_AUDIO_CHANNEL_TFC: top front center
+ * @SPA_AUDIO_CHANNEL_TFR: top front right
+ * @SPA_AUDIO_CHANNEL_TRL: top rear left
+ * @SPA_AUDIO_CHANNEL_TRC: top rear center
+ * @SPA_AUDIO_CHANNEL_TRR: top rear right
+ *
+ * Positions of the channels. Bit n of the channel mask is set when the
+ * channel at position n is present, the channels are in the order of
+ * the bits.
+ */
+enum spa_audio_channel {
+	SPA_AUDIO_CHANNEL_FL = 0,
+	SPA_AUDIO_CHANNEL_FR,
+	SPA_AUDIO_CHANNEL_FC,
+	SPA_AUDIO_CHANNEL_LFE,
+	SPA_AUDIO_CHANNEL_RL,
+	SPA_AUDIO_CHANNEL_RR,
+	SPA_AUDIO_CHANNEL_FLC,
+	SPA_AUDIO_CHANNEL_FRC,
+	SPA_AUDIO_CHANNEL_RC,
+	SPA_AUDIO_CHANNEL_SL,
+	SPA_AUDIO_CHANNEL_SR,
+	SPA_AUDIO_CHANNEL_TC,
+	SPA_AUDIO_CHANNEL_TFL,
+	SPA_AUDIO_CHANNEL_TFC,
+	SPA_AUDIO_CHANNEL_TFR,
+	SPA_AUDIO_CHANNEL_TRL,
+	SPA_AUDIO_CHANNEL_TRC,
+	SPA_AUDIO_CHANNEL_TRR,
+	SPA_AUDIO_CHANNEL_MAX
+};
+
+#define SPA_AUDIO_CHANNEL_MASK(ch)	(1u << SPA_AUDIO_CHANNEL_ ## ch)
+
 /**
  * spa_audio_info_raw:
  * @format: the format
@@ -94,7 +143,8 @@ enum spa_audio_layout {
  * @layout: the sample layout
  * @rate: the sample rate
  * @channels: the number of channels
- * @channel_mask: the channel mask
+ * @channel_mask: the channel mask, a bit for each spa_audio_channel or
+ *     0 for the default positions of the number of channels
  */
 struct spa_audio_info_raw {
 	uint32_t format;
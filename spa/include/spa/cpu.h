@@ -0,0 +1,96 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_CPU_H__
+#define __SPA_CPU_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <spa/defs.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+#define SPA_CPU_FLAG_SSE	(1 << 0)
+#define SPA_CPU_FLAG_SSE2	(1 << 1)
+#define SPA_CPU_FLAG_SSE3	(1 << 2)
+#define SPA_CPU_FLAG_SSSE3	(1 << 3)
+#define SPA_CPU_FLAG_SSE41	(1 << 4)
+#define SPA_CPU_FLAG_AVX	(1 << 5)
+#define SPA_CPU_FLAG_AVX2	(1 << 6)
+#define SPA_CPU_FLAG_FMA	(1 << 7)
+
+/**
+ * spa_cpu_get_flags:
+ *
+ * Get the SPA_CPU_FLAG_* of the instruction sets that can be used.
+ * AVX, AVX2 and FMA are only reported when the OS also saves the
+ * AVX state, as told by OSXSAVE and XGETBV.
+ *
+ * Returns: the cpu flags
+ */
+static inline uint32_t spa_cpu_get_flags(void)
+{
+	uint32_t flags = 0;
+#if defined(__i386__) || defined(__x86_64__)
+	unsigned int eax, ebx, ecx, edx, xcr0;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+
+	if (edx & bit_SSE)
+		flags |= SPA_CPU_FLAG_SSE;
+	if (edx & bit_SSE2)
+		flags |= SPA_CPU_FLAG_SSE2;
+	if (ecx & bit_SSE3)
+		flags |= SPA_CPU_FLAG_SSE3;
+	if (ecx & bit_SSSE3)
+		flags |= SPA_CPU_FLAG_SSSE3;
+	if (ecx & bit_SSE4_1)
+		flags |= SPA_CPU_FLAG_SSE41;
+
+	if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+		return flags;
+
+	/* the OS must save the SSE and AVX registers */
+	__asm__ ("xgetbv" : "=a" (xcr0) : "c" (0) : "%edx");
+	if ((xcr0 & 6) != 6)
+		return flags;
+
+	flags |= SPA_CPU_FLAG_AVX;
+	if (ecx & bit_FMA)
+		flags |= SPA_CPU_FLAG_FMA;
+
+	if (__get_cpuid_max(0, NULL) >= 7) {
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		if (ebx & bit_AVX2)
+			flags |= SPA_CPU_FLAG_AVX2;
+	}
+#endif
+	return flags;
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_CPU_H__ */
@@ -142,6 +142,7 @@ struct spa_fraction {
 #endif
 
 #define SPA_ROUND_UP_N(num,align) ((((num) + ((align) - 1)) & ~((align) - 1)))
+#define SPA_IS_ALIGNED(p,align) (((uintptr_t)(p) & ((align) - 1)) == 0)
 
 #ifndef SPA_LIKELY
 #ifdef __GNUC__
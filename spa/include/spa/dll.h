@@ -0,0 +1,103 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_DLL_H__
+#define __SPA_DLL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <math.h>
+
+#include <spa/defs.h>
+
+#define SPA_DLL_BW_MAX		0.128
+#define SPA_DLL_BW_MIN		0.016
+
+/**
+ * spa_dll:
+ * @bw: the bandwidth of the loop
+ *
+ * A delay-locked loop. It is fed with the error between a predicted
+ * and a measured position once per period and returns the correction
+ * of the rate that makes the error go to zero. When the rates differ by
+ * a constant amount, the correction converges to their ratio.
+ */
+struct spa_dll {
+	double bw;
+	double z1, z2, z3;
+	double w0, w1, w2;
+};
+
+/**
+ * spa_dll_init:
+ * @dll: a #struct spa_dll
+ *
+ * Reset the state of @dll, the correction starts at 1.0.
+ */
+static inline void spa_dll_init(struct spa_dll *dll)
+{
+	dll->bw = 0.0;
+	dll->z1 = dll->z2 = dll->z3 = 0.0;
+}
+
+/**
+ * spa_dll_set_bw:
+ * @dll: a #struct spa_dll
+ * @bw: the bandwidth, between #SPA_DLL_BW_MIN and #SPA_DLL_BW_MAX
+ * @period: the number of samples between updates
+ * @rate: the sample rate
+ *
+ * Set the bandwidth of @dll. A lower bandwidth filters more jitter but
+ * takes longer to lock.
+ */
+static inline void spa_dll_set_bw(struct spa_dll *dll, double bw, uint32_t period, uint32_t rate)
+{
+	double w = 2 * M_PI * bw * period / rate;
+
+	dll->w0 = 1.0 - exp(-20.0 * w);
+	dll->w1 = w * 1.5 / period;
+	dll->w2 = w / 1.5;
+	dll->bw = bw;
+}
+
+/**
+ * spa_dll_update:
+ * @dll: a #struct spa_dll
+ * @err: the error of the last period, in samples
+ *
+ * Update @dll with the error of the last period. A positive error, a
+ * prediction that runs ahead, lowers the correction.
+ *
+ * Returns: the correction to apply to the predicted rate
+ */
+static inline double spa_dll_update(struct spa_dll *dll, double err)
+{
+	dll->z1 += dll->w0 * (dll->w1 * err - dll->z1);
+	dll->z2 += dll->w0 * (dll->z1 - dll->z2);
+	dll->z3 += dll->w2 * dll->z2;
+	return 1.0 - (dll->z2 + dll->z3);
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_DLL_H__ */
@@ -36,12 +36,15 @@ extern "C" {
 #define SPA_TYPE_EVENT_NODE__Buffering		SPA_TYPE_EVENT_NODE_BASE "Buffering"
 #define SPA_TYPE_EVENT_NODE__RequestRefresh	SPA_TYPE_EVENT_NODE_BASE "RequestRefresh"
 #define SPA_TYPE_EVENT_NODE__RequestClockUpdate	SPA_TYPE_EVENT_NODE_BASE "RequestClockUpdate"
+/** the props of the port info changed, emitted from the main thread */
+#define SPA_TYPE_EVENT_NODE__PortInfoChanged	SPA_TYPE_EVENT_NODE_BASE "PortInfoChanged"
 
 struct spa_type_event_node {
 	uint32_t Error;
 	uint32_t Buffering;
 	uint32_t RequestRefresh;
 	uint32_t RequestClockUpdate;
+	uint32_t PortInfoChanged;
 };
 
 static inline void
@@ -52,6 +55,7 @@ spa_type_event_node_map(struct spa_type_map *map, struct spa_type_event_node *ty
 		type->Buffering = spa_type_map_get_id(map, SPA_TYPE_EVENT_NODE__Buffering);
 		type->RequestRefresh = spa_type_map_get_id(map, SPA_TYPE_EVENT_NODE__RequestRefresh);
 		type->RequestClockUpdate = spa_type_map_get_id(map, SPA_TYPE_EVENT_NODE__RequestClockUpdate);
+		type->PortInfoChanged = spa_type_map_get_id(map, SPA_TYPE_EVENT_NODE__PortInfoChanged);
 	}
 }
 
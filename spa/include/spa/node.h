@@ -73,6 +73,9 @@ struct spa_port_info {
 #define SPA_PORT_INFO_FLAG_NO_REF		(1<<5)	/**< the port does not keep a ref on the buffer */
 #define SPA_PORT_INFO_FLAG_LIVE			(1<<6)	/**< output buffers from this port are timestamped against
 							 *   a live clock. */
+#define SPA_PORT_INFO_FLAG_SHARE_BUFFERS	(1<<7)	/**< the input port can use the same buffers as the
+							 *   output port of the node, the node then
+							 *   processes them in-place */
 	uint32_t flags;				/**< port flags */
 	uint32_t rate;				/**< rate of sequence numbers on port */
 	const struct spa_dict *props;		/**< extra port properties */
@@ -48,6 +48,12 @@ struct spa_props {
 #define SPA_TYPE_PROPS__frequency	SPA_TYPE_PROPS_BASE "frequency"
 #define SPA_TYPE_PROPS__volume		SPA_TYPE_PROPS_BASE "volume"
 #define SPA_TYPE_PROPS__mute		SPA_TYPE_PROPS_BASE "mute"
+#define SPA_TYPE_PROPS__channelVolumes	SPA_TYPE_PROPS_BASE "channelVolumes"
+#define SPA_TYPE_PROPS__rampSamples	SPA_TYPE_PROPS_BASE "rampSamples"
+#define SPA_TYPE_PROPS__rampType	SPA_TYPE_PROPS_BASE "rampType"
+#define SPA_TYPE_PROPS__dither		SPA_TYPE_PROPS_BASE "dither"
+#define SPA_TYPE_PROPS__quality		SPA_TYPE_PROPS_BASE "quality"
+#define SPA_TYPE_PROPS__rate		SPA_TYPE_PROPS_BASE "rate"
 #define SPA_TYPE_PROPS__patternType	SPA_TYPE_PROPS_BASE "patternType"
 
 static inline uint32_t
@@ -129,6 +129,69 @@ static inline struct spa_pod_prop *find_prop(const struct spa_pod *pod, uint32_t
 	return NULL;
 }
 
+#define MAX_INDEX_PROPS	64
+
+struct prop_ref {
+	uint32_t key;
+	uint32_t idx;
+	struct spa_pod_prop *prop;
+};
+
+/* collect the properties of pod sorted on key. Returns the number of
+ * properties or SPA_ID_INVALID when there are more than max */
+static uint32_t
+collect_props(const struct spa_pod *pod, uint32_t size, struct prop_ref *refs, uint32_t max)
+{
+	const struct spa_pod *res;
+	uint32_t i, n = 0;
+
+	SPA_POD_FOREACH(pod, size, res) {
+		struct spa_pod_prop *p;
+
+		if (res->type != SPA_POD_TYPE_PROP)
+			continue;
+		if (n == max)
+			return SPA_ID_INVALID;
+
+		p = (struct spa_pod_prop *) res;
+		/* insertion sort, there are only a few properties and they are
+		 * mostly in key order already. Equal keys keep their order. */
+		for (i = n; i > 0 && refs[i - 1].key > p->body.key; i--)
+			refs[i] = refs[i - 1];
+		refs[i].key = p->body.key;
+		refs[i].idx = n;
+		refs[i].prop = p;
+		n++;
+	}
+	return n;
+}
+
+/* for each property in props, find the first property in filter with
+ * the same key with one pass over both sorted key lists */
+static bool
+match_props(const struct spa_pod *props, uint32_t props_size,
+	    const struct spa_pod *filter, uint32_t filter_size,
+	    struct spa_pod_prop **matches)
+{
+	struct prop_ref prefs[MAX_INDEX_PROPS], frefs[MAX_INDEX_PROPS];
+	uint32_t i, j, n_props, n_filter;
+
+	if ((n_props = collect_props(props, props_size, prefs, MAX_INDEX_PROPS)) == SPA_ID_INVALID)
+		return false;
+	if ((n_filter = collect_props(filter, filter_size, frefs, MAX_INDEX_PROPS)) == SPA_ID_INVALID)
+		return false;
+
+	for (i = 0, j = 0; i < n_props; i++) {
+		while (j < n_filter && frefs[j].key < prefs[i].key)
+			j++;
+		if (j < n_filter && frefs[j].key == prefs[i].key)
+			matches[prefs[i].idx] = frefs[j].prop;
+		else
+			matches[prefs[i].idx] = NULL;
+	}
+	return true;
+}
+
 int
 spa_props_filter(struct spa_pod_builder *b,
 		 const struct spa_pod *props,
@@ -138,6 +201,12 @@ spa_props_filter(struct spa_pod_builder *b,
 {
 	int j, k;
 	const struct spa_pod *pr;
+	struct spa_pod_prop *matches[MAX_INDEX_PROPS];
+	bool indexed;
+	uint32_t idx = 0;
+
+	indexed = filter != NULL &&
+	    match_props(props, props_size, filter, filter_size, matches);
 
 	SPA_POD_FOREACH(props, props_size, pr) {
 		struct spa_pod_frame f;
@@ -151,7 +220,14 @@ spa_props_filter(struct spa_pod_builder *b,
 
 		p1 = (struct spa_pod_prop *) pr;
 
-		if (filter == NULL || (p2 = find_prop(filter, filter_size, p1->body.key)) == NULL) {
+		if (indexed)
+			p2 = matches[idx++];
+		else if (filter != NULL)
+			p2 = find_prop(filter, filter_size, p1->body.key);
+		else
+			p2 = NULL;
+
+		if (p2 == NULL) {
 			/* no filter, copy the complete property */
 			spa_pod_builder_raw_padded(b, p1, SPA_POD_SIZE(p1));
 			continue;
@@ -164,9 +240,9 @@ spa_props_filter(struct spa_pod_builder *b,
 		rt1 = p1->body.flags & SPA_POD_PROP_RANGE_MASK;
 		rt2 = p2->body.flags & SPA_POD_PROP_RANGE_MASK;
 
-		/* else we filter. start with copying the property */
-		spa_pod_builder_push_prop(b, &f, p1->body.key, 0),
-		    np = SPA_POD_BUILDER_DEREF(b, f.ref, struct spa_pod_prop);
+		/* else we filter. start with copying the property. The builder
+		 * memory can move while writing, np is looked up again when needed */
+		spa_pod_builder_push_prop(b, &f, p1->body.key, 0);
 
 		/* default value */
 		spa_pod_builder_raw(b, &p1->body.value,
@@ -209,6 +285,7 @@ spa_props_filter(struct spa_pod_builder *b,
 			}
 			if (n_copied == 0)
 				return SPA_RESULT_INCOMPATIBLE_PROPS;
+			np = SPA_POD_BUILDER_DEREF(b, f.ref, struct spa_pod_prop);
 			np->body.flags |= SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET;
 		}
 
@@ -227,6 +304,7 @@ spa_props_filter(struct spa_pod_builder *b,
 			}
 			if (n_copied == 0)
 				return SPA_RESULT_INCOMPATIBLE_PROPS;
+			np = SPA_POD_BUILDER_DEREF(b, f.ref, struct spa_pod_prop);
 			np->body.flags |= SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET;
 		}
 
@@ -250,6 +328,7 @@ spa_props_filter(struct spa_pod_builder *b,
 			}
 			if (n_copied == 0)
 				return SPA_RESULT_INCOMPATIBLE_PROPS;
+			np = SPA_POD_BUILDER_DEREF(b, f.ref, struct spa_pod_prop);
 			np->body.flags |= SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET;
 		}
 
@@ -267,6 +346,7 @@ spa_props_filter(struct spa_pod_builder *b,
 			else
 				spa_pod_builder_raw(b, alt2, p2->body.value.size);
 
+			np = SPA_POD_BUILDER_DEREF(b, f.ref, struct spa_pod_prop);
 			np->body.flags |= SPA_POD_PROP_RANGE_MIN_MAX | SPA_POD_PROP_FLAG_UNSET;
 		}
 
@@ -306,6 +386,7 @@ spa_props_filter(struct spa_pod_builder *b,
 			return SPA_RESULT_NOT_IMPLEMENTED;
 
 		spa_pod_builder_pop(b, &f);
+		np = SPA_POD_BUILDER_DEREF(b, f.ref, struct spa_pod_prop);
 		fix_default(np);
 	}
 	return SPA_RESULT_OK;
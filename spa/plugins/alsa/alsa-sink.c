@@ -78,14 +78,14 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 
 	if (props == NULL) {
 		reset_props(&this->props);
-		return SPA_RESULT_OK;
 	} else {
 		spa_props_query(props,
 				this->type.prop_device, -SPA_POD_TYPE_STRING,
 					this->props.device, sizeof(this->props.device),
 				this->type.prop_min_latency, SPA_POD_TYPE_INT, &this->props.min_latency, 0);
 	}
-	return SPA_RESULT_OK;
+	/* the latency can change while running */
+	return spa_alsa_set_latency(this, this->props.min_latency);
 }
 
 static int do_send_done(struct spa_loop *loop, bool async, uint32_t seq, size_t size, const void *data, void *user_data)
@@ -605,6 +605,46 @@ static const struct spa_node impl_node = {
 	impl_node_process_output,
 };
 
+static int impl_clock_get_props(struct spa_clock *clock, struct spa_props **props)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int impl_clock_set_props(struct spa_clock *clock, const struct spa_props *props)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int impl_clock_get_time(struct spa_clock *clock,
+			       int32_t *rate,
+			       int64_t *ticks,
+			       int64_t *monotonic_time)
+{
+	struct state *this;
+
+	spa_return_val_if_fail(clock != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(clock, struct state, clock);
+
+	if (rate)
+		*rate = this->rate;
+	if (ticks)
+		*ticks = this->last_ticks;
+	if (monotonic_time)
+		*monotonic_time = this->last_monotonic;
+
+	return SPA_RESULT_OK;
+}
+
+static const struct spa_clock impl_clock = {
+	SPA_VERSION_CLOCK,
+	NULL,
+	SPA_CLOCK_STATE_STOPPED,
+	impl_clock_get_props,
+	impl_clock_set_props,
+	impl_clock_get_time,
+};
+
 static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id, void **interface)
 {
 	struct state *this;
@@ -616,6 +656,8 @@ static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id,
 
 	if (interface_id == this->type.node)
 		*interface = &this->node;
+	else if (interface_id == this->type.clock)
+		*interface = &this->clock;
 	else
 		return SPA_RESULT_UNKNOWN_INTERFACE;
 
@@ -667,6 +709,7 @@ impl_init(const struct spa_handle_factory *factory,
 	init_type(&this->type, this->map);
 
 	this->node = impl_node;
+	this->clock = impl_clock;
 	this->stream = SND_PCM_STREAM_PLAYBACK;
 	reset_props(&this->props);
 
@@ -683,6 +726,7 @@ impl_init(const struct spa_handle_factory *factory,
 
 static const struct spa_interface_info impl_interfaces[] = {
 	{SPA_TYPE__Node,},
+	{SPA_TYPE__Clock,},
 };
 
 static int
@@ -692,13 +736,11 @@ impl_enum_interface_info(const struct spa_handle_factory *factory,
 	spa_return_val_if_fail(factory != NULL, SPA_RESULT_INVALID_ARGUMENTS);
 	spa_return_val_if_fail(info != NULL, SPA_RESULT_INVALID_ARGUMENTS);
 
-	switch (index) {
-	case 0:
-		*info = &impl_interfaces[index];
-		break;
-	default:
+	if (index >= SPA_N_ELEMENTS(impl_interfaces))
 		return SPA_RESULT_ENUM_END;
-	}
+
+	*info = &impl_interfaces[index];
+
 	return SPA_RESULT_OK;
 }
 
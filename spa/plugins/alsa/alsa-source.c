@@ -79,15 +79,14 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 
 	if (props == NULL) {
 		reset_props(&this->props);
-		return SPA_RESULT_OK;
 	} else {
 		spa_props_query(props,
 				this->type.prop_device, -SPA_POD_TYPE_STRING,
 					this->props.device, sizeof(this->props.device),
 				this->type.prop_min_latency, SPA_POD_TYPE_INT, &this->props.min_latency, 0);
 	}
-
-	return SPA_RESULT_OK;
+	/* the latency can change while running */
+	return spa_alsa_set_latency(this, this->props.min_latency);
 }
 
 static int do_send_done(struct spa_loop *loop, bool async, uint32_t seq, size_t size, const void *data, void *user_data)
@@ -637,7 +636,7 @@ static int impl_clock_get_time(struct spa_clock *clock,
 	this = SPA_CONTAINER_OF(clock, struct state, clock);
 
 	if (rate)
-		*rate = SPA_USEC_PER_SEC;
+		*rate = this->rate;
 	if (ticks)
 		*ticks = this->last_ticks;
 	if (monotonic_time)
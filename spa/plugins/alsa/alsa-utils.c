@@ -16,6 +16,9 @@
 
 #define CHECK(s,msg) if ((err = (s)) < 0) { spa_log_error(state->log, msg ": %s", snd_strerror(err)); return err; }
 
+#define MIN_HEADROOM	32		/* frames kept in the device without jitter */
+#define JITTER_DECAY	(1.0 / 64.0)	/* how fast a jitter peak is forgotten */
+
 static int spa_alsa_open(struct state *state)
 {
 	int err;
@@ -199,6 +202,71 @@ spa_alsa_enum_format(struct state *state, struct spa_format **format, const stru
 	return SPA_RESULT_OK;
 }
 
+/* frames per wakeup for @latency, it must leave room for the headroom */
+static uint32_t latency_to_threshold(struct state *state, uint32_t latency)
+{
+	return SPA_CLAMP(latency, 1, state->buffer_frames / 2);
+}
+
+static void update_port_info(struct state *state)
+{
+	uint32_t latency = latency_to_threshold(state, state->props.min_latency);
+
+	snprintf(state->info_latency, sizeof(state->info_latency), "%u", latency);
+	snprintf(state->info_buffer_frames, sizeof(state->info_buffer_frames), "%lu",
+		 state->buffer_frames);
+
+	state->info_items[0].key = SPA_ALSA_INFO_LATENCY;
+	state->info_items[0].value = state->info_latency;
+	state->info_items[1].key = SPA_ALSA_INFO_BUFFER_FRAMES;
+	state->info_items[1].value = state->info_buffer_frames;
+	state->info_props.n_items = 2;
+	state->info_props.items = state->info_items;
+	state->info.props = &state->info_props;
+
+	if (state->callbacks && state->callbacks->event) {
+		struct spa_event event = SPA_EVENT_INIT(state->type.event_node.PortInfoChanged);
+		state->callbacks->event(state->callbacks_data, &event);
+	}
+}
+
+static int do_set_latency(struct spa_loop *loop, bool async, uint32_t seq,
+			  size_t size, const void *data, void *user_data)
+{
+	struct state *state = user_data;
+
+	state->threshold = *(uint32_t *) data;
+	state->headroom = SPA_MIN(state->headroom, state->buffer_frames - state->threshold);
+
+	spa_log_debug(state->log, "alsa %p: latency %d", state, state->threshold);
+
+	return SPA_RESULT_OK;
+}
+
+/** Change the frames per wakeup and with it the fill level of the device.
+ * The hardware buffer is not changed so this works while running, the
+ * latency is limited to half the buffer */
+int spa_alsa_set_latency(struct state *state, uint32_t latency)
+{
+	uint32_t threshold;
+
+	state->props.min_latency = latency;
+
+	/* without a format, the latency is applied when the buffer is known */
+	if (!state->have_format)
+		return SPA_RESULT_OK;
+
+	update_port_info(state);
+
+	if (!state->started)
+		return SPA_RESULT_OK;
+
+	threshold = latency_to_threshold(state, latency);
+
+	return spa_loop_invoke(state->data_loop, do_set_latency, ++state->seq,
+			       sizeof(uint32_t), &threshold, false, state);
+}
+
 int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_t flags)
 {
 	unsigned int rrate, rchannels;
@@ -280,6 +348,8 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 	/* write the parameters to device */
 	CHECK(snd_pcm_hw_params(hndl, params), "set_hw_params");
 
+	update_port_info(state);
+
 	return 0;
 }
 
@@ -451,13 +521,13 @@ static int alsa_try_resume(struct state *state)
 }
 
 static inline void calc_timeout(size_t target, size_t current,
-				size_t rate, snd_htimestamp_t *now,
+				double rate, snd_htimestamp_t *now,
 				struct timespec *ts)
 {
 	ts->tv_sec = now->tv_sec;
 	ts->tv_nsec = now->tv_nsec;
 	if (target > current)
-		ts->tv_nsec += ((target - current) * SPA_NSEC_PER_SEC) / rate;
+		ts->tv_nsec += (target - current) * SPA_NSEC_PER_SEC / rate;
 
 	while (ts->tv_nsec >= SPA_NSEC_PER_SEC) {
 		ts->tv_sec++;
@@ -465,6 +535,78 @@ static inline void calc_timeout(size_t target, size_t current,
 	}
 }
 
+static void reset_time(struct state *state)
+{
+	spa_dll_init(&state->dll);
+	state->rate_diff = 1.0;
+	state->position = 0.0;
+	state->last_monotonic = 0;
+	state->next_time = 0;
+	state->jitter = 0.0;
+	state->headroom = SPA_MIN(MIN_HEADROOM, state->buffer_frames - state->threshold);
+}
+
+/* Lock to the rate of the device with the position it had at @now and
+ * measure how late the timer fired. The wakeups are planned with the
+ * measured rate and the playback headroom grows with the jitter. */
+static void update_time(struct state *state, int64_t ticks, int64_t now)
+{
+	double err, late;
+	snd_pcm_uframes_t jitter_frames;
+
+	if (state->next_time != 0) {
+		late = fabs((double) (now - state->next_time));
+		if (late > state->jitter)
+			state->jitter = late;
+		else
+			state->jitter += (late - state->jitter) * JITTER_DECAY;
+
+		jitter_frames = state->jitter * state->rate / SPA_NSEC_PER_SEC;
+		state->headroom = SPA_MIN(MIN_HEADROOM + 2 * jitter_frames,
+					  state->buffer_frames - state->threshold);
+	}
+
+	if (state->last_monotonic != 0 && ticks == state->last_ticks)
+		return;
+
+	if (state->last_monotonic != 0 && ticks > state->last_ticks) {
+		if (state->dll.bw == 0.0)
+			spa_dll_set_bw(&state->dll, SPA_DLL_BW_MAX, state->threshold, state->rate);
+
+		state->position += (double) (now - state->last_monotonic) *
+				state->rate * state->rate_diff / SPA_NSEC_PER_SEC;
+		err = state->position - ticks;
+
+		/* a big error is an xrun or a suspend, start again */
+		if (fabs(err) < state->rate / 10) {
+			state->rate_diff = spa_dll_update(&state->dll, err);
+			goto done;
+		}
+		spa_log_debug(state->log, "alsa %p: position error %f, resync", state, err);
+	}
+	spa_dll_init(&state->dll);
+	state->rate_diff = 1.0;
+	state->position = ticks;
+
+      done:
+	state->last_ticks = ticks;
+	state->last_monotonic = now;
+}
+
+static void set_timeout(struct state *state, size_t target, size_t current,
+			snd_htimestamp_t *now)
+{
+	struct itimerspec ts;
+
+	calc_timeout(target, current, state->rate * state->rate_diff, now, &ts.it_value);
+
+	ts.it_interval.tv_sec = 0;
+	ts.it_interval.tv_nsec = 0;
+	timerfd_settime(state->timerfd, TFD_TIMER_ABSTIME, &ts, NULL);
+
+	state->next_time = SPA_TIMESPEC_TO_TIME(&ts.it_value);
+}
+
 static void alsa_on_playback_timeout_event(struct spa_source *source)
 {
 	uint64_t exp;
@@ -472,8 +614,7 @@ static void alsa_on_playback_timeout_event(struct spa_source *source)
 	struct state *state = source->data;
 	snd_pcm_t *hndl = state->hndl;
 	snd_pcm_sframes_t avail;
-	struct itimerspec ts;
-	snd_pcm_uframes_t total_written = 0, filled;
+	snd_pcm_uframes_t total_written = 0, filled, target;
 	const snd_pcm_channel_area_t *my_areas;
 	snd_pcm_status_t *status;
 	snd_htimestamp_t htstamp;
@@ -496,20 +637,22 @@ static void alsa_on_playback_timeout_event(struct spa_source *source)
 
 	filled = state->buffer_frames - avail;
 
-	state->last_ticks = state->sample_count - filled;
-	state->last_monotonic = (int64_t) htstamp.tv_sec * SPA_NSEC_PER_SEC + (int64_t) htstamp.tv_nsec;
+	update_time(state, state->sample_count - filled, SPA_TIMESPEC_TO_TIME(&htstamp));
 
-	spa_log_trace(state->log, "timeout %ld %d %ld %ld %ld", filled, state->threshold,
-		      state->sample_count, htstamp.tv_sec, htstamp.tv_nsec);
+	/* keep one wakeup of samples in the device above the headroom */
+	target = state->threshold + state->headroom;
 
-	if (filled > state->threshold) {
+	spa_log_trace(state->log, "timeout %ld %d %ld %ld %ld %f", filled, state->threshold,
+		      state->sample_count, htstamp.tv_sec, htstamp.tv_nsec, state->rate_diff);
+
+	if (filled >= target) {
 		if (snd_pcm_state(hndl) == SND_PCM_STATE_SUSPENDED) {
 			spa_log_error(state->log, "suspended: try resume");
 			if ((res = alsa_try_resume(state)) < 0)
 				return;
 		}
 	} else {
-		snd_pcm_uframes_t to_write = state->buffer_frames - filled;
+		snd_pcm_uframes_t to_write = target - filled;
 		bool do_pull = true;
 
 		while (total_written < to_write) {
@@ -543,11 +686,7 @@ static void alsa_on_playback_timeout_event(struct spa_source *source)
 		state->alsa_started = true;
 	}
 
-	calc_timeout(total_written + filled, state->threshold, state->rate, &htstamp, &ts.it_value);
-
-	ts.it_interval.tv_sec = 0;
-	ts.it_interval.tv_nsec = 0;
-	timerfd_settime(state->timerfd, TFD_TIMER_ABSTIME, &ts, NULL);
+	set_timeout(state, total_written + filled, state->headroom, &htstamp);
 }
 
 
@@ -559,7 +698,6 @@ static void alsa_on_capture_timeout_event(struct spa_source *source)
 	snd_pcm_t *hndl = state->hndl;
 	snd_pcm_sframes_t avail;
 	snd_pcm_uframes_t total_read = 0;
-	struct itimerspec ts;
 	const snd_pcm_channel_area_t *my_areas;
 	snd_pcm_status_t *status;
 	snd_htimestamp_t htstamp;
@@ -577,8 +715,7 @@ static void alsa_on_capture_timeout_event(struct spa_source *source)
 	avail = snd_pcm_status_get_avail(status);
 	snd_pcm_status_get_htstamp(status, &htstamp);
 
-	state->last_ticks = state->sample_count + avail;
-	state->last_monotonic = (int64_t) htstamp.tv_sec * SPA_NSEC_PER_SEC + (int64_t) htstamp.tv_nsec;
+	update_time(state, state->sample_count + avail, SPA_TIMESPEC_TO_TIME(&htstamp));
 
 	spa_log_trace(state->log, "timeout %ld %d %ld %ld %ld", avail, state->threshold,
 		      state->sample_count, htstamp.tv_sec, htstamp.tv_nsec);
@@ -614,11 +751,7 @@ static void alsa_on_capture_timeout_event(struct spa_source *source)
 		}
 		state->sample_count += total_read;
 	}
-	calc_timeout(state->threshold, avail - total_read, state->rate, &htstamp, &ts.it_value);
-
-	ts.it_interval.tv_sec = 0;
-	ts.it_interval.tv_nsec = 0;
-	timerfd_settime(state->timerfd, TFD_TIMER_ABSTIME, &ts, NULL);
+	set_timeout(state, state->threshold, avail - total_read, &htstamp);
 }
 
 int spa_alsa_start(struct state *state, bool xrun_recover)
@@ -650,7 +783,8 @@ int spa_alsa_start(struct state *state, bool xrun_recover)
 	state->source.rmask = 0;
 	spa_loop_add_source(state->data_loop, &state->source);
 
-	state->threshold = state->props.min_latency;
+	state->threshold = latency_to_threshold(state, state->props.min_latency);
+	reset_time(state);
 
 	if (state->stream == SND_PCM_STREAM_PLAYBACK) {
 		state->alsa_started = false;
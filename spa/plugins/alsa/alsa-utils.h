@@ -36,9 +36,15 @@ extern "C" {
 #include <spa/param-alloc.h>
 #include <spa/loop.h>
 #include <spa/ringbuffer.h>
+#include <spa/dll.h>
 #include <spa/audio/format-utils.h>
 #include <spa/format-builder.h>
 
+/** port info keys, the number of frames that is kept in the device and
+ * the size of the device buffer */
+#define SPA_ALSA_INFO_LATENCY		"alsa.latency"
+#define SPA_ALSA_INFO_BUFFER_FRAMES	"alsa.buffer-frames"
+
 struct props {
 	char device[64];
 	char device_name[128];
@@ -139,6 +145,10 @@ struct state {
 	size_t frame_size;
 
 	struct spa_port_info info;
+	struct spa_dict_item info_items[2];
+	struct spa_dict info_props;
+	char info_latency[16];
+	char info_buffer_frames[16];
 	uint32_t params[3];
 	uint8_t params_buffer[1024];
 	struct spa_port_io *io;
@@ -159,6 +169,13 @@ struct state {
 	int64_t sample_count;
 	int64_t last_ticks;
 	int64_t last_monotonic;
+
+	struct spa_dll dll;		/* locks to the rate of the device */
+	double rate_diff;		/* measured rate against the monotonic clock */
+	double position;		/* predicted position of the device */
+	int64_t next_time;		/* monotonic time of the next wakeup */
+	double jitter;			/* lateness of the wakeups in nanoseconds */
+	snd_pcm_uframes_t headroom;	/* frames kept in the device for the jitter */
 };
 
 #define PROP(f,key,type,...)							\
@@ -180,6 +197,8 @@ spa_alsa_enum_format(struct state *state,
 
 int spa_alsa_set_format(struct state *state, struct spa_audio_info *info, uint32_t flags);
 
+int spa_alsa_set_latency(struct state *state, uint32_t latency);
+
 int spa_alsa_start(struct state *state, bool xrun_recover);
 int spa_alsa_pause(struct state *state, bool xrun_recover);
 int spa_alsa_close(struct state *state);
@@ -0,0 +1,56 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <spa/defs.h>
+
+#include <xmmintrin.h>
+
+#include "channelmix-ops.h"
+
+/* the planes of the buffers are not always aligned, unaligned loads and
+ * stores are used */
+
+void mix_scale_f32_sse(float *d, const float *s, float gain, uint32_t n_samples)
+{
+	__m128 g = _mm_set1_ps(gain);
+	uint32_t n, unrolled = n_samples & ~7;
+
+	for (n = 0; n < unrolled; n += 8) {
+		_mm_storeu_ps(&d[n], _mm_mul_ps(_mm_loadu_ps(&s[n]), g));
+		_mm_storeu_ps(&d[n + 4], _mm_mul_ps(_mm_loadu_ps(&s[n + 4]), g));
+	}
+	for (; n < n_samples; n++)
+		d[n] = s[n] * gain;
+}
+
+void mix_add_scale_f32_sse(float *d, const float *s, float gain, uint32_t n_samples)
+{
+	__m128 g = _mm_set1_ps(gain);
+	uint32_t n, unrolled = n_samples & ~7;
+
+	for (n = 0; n < unrolled; n += 8) {
+		_mm_storeu_ps(&d[n], _mm_add_ps(_mm_loadu_ps(&d[n]),
+				_mm_mul_ps(_mm_loadu_ps(&s[n]), g)));
+		_mm_storeu_ps(&d[n + 4], _mm_add_ps(_mm_loadu_ps(&d[n + 4]),
+				_mm_mul_ps(_mm_loadu_ps(&s[n + 4]), g)));
+	}
+	for (; n < n_samples; n++)
+		d[n] += s[n] * gain;
+}
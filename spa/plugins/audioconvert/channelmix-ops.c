@@ -0,0 +1,297 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include <spa/cpu.h>
+
+#include "channelmix-ops.h"
+
+#define _M(ch)		(1u << SPA_AUDIO_CHANNEL_ ## ch)
+#define MAX_FOLDS	5
+
+/* an input that is not in the output is mixed into the first set of
+ * positions that are all in the output */
+struct fold {
+	uint32_t mask;
+	float gain;
+};
+
+static const struct fold folds[SPA_AUDIO_CHANNEL_MAX][MAX_FOLDS] = {
+	[SPA_AUDIO_CHANNEL_FL] = { { _M(FC), 0.5f }, },
+	[SPA_AUDIO_CHANNEL_FR] = { { _M(FC), 0.5f }, },
+	[SPA_AUDIO_CHANNEL_FC] = { { _M(FL) | _M(FR), M_SQRT1_2 }, },
+	/* the LFE channel is dropped */
+	[SPA_AUDIO_CHANNEL_RL] = { { _M(SL), 1.0f }, { _M(FL), M_SQRT1_2 }, { _M(FC), 0.5f }, },
+	[SPA_AUDIO_CHANNEL_RR] = { { _M(SR), 1.0f }, { _M(FR), M_SQRT1_2 }, { _M(FC), 0.5f }, },
+	[SPA_AUDIO_CHANNEL_FLC] = { { _M(FL), 1.0f }, { _M(FC), 0.5f }, },
+	[SPA_AUDIO_CHANNEL_FRC] = { { _M(FR), 1.0f }, { _M(FC), 0.5f }, },
+	[SPA_AUDIO_CHANNEL_RC] = { { _M(RL) | _M(RR), M_SQRT1_2 }, { _M(SL) | _M(SR), M_SQRT1_2 },
+				   { _M(FL) | _M(FR), 0.5f }, { _M(FC), M_SQRT1_2 }, },
+	[SPA_AUDIO_CHANNEL_SL] = { { _M(RL), 1.0f }, { _M(FL), M_SQRT1_2 }, { _M(FC), 0.5f }, },
+	[SPA_AUDIO_CHANNEL_SR] = { { _M(RR), 1.0f }, { _M(FR), M_SQRT1_2 }, { _M(FC), 0.5f }, },
+	[SPA_AUDIO_CHANNEL_TC] = { { _M(FC), M_SQRT1_2 }, { _M(FL) | _M(FR), 0.5f }, },
+	[SPA_AUDIO_CHANNEL_TFL] = { { _M(FL), 1.0f }, { _M(FC), 0.5f }, },
+	[SPA_AUDIO_CHANNEL_TFC] = { { _M(FC), 1.0f }, { _M(FL) | _M(FR), M_SQRT1_2 }, },
+	[SPA_AUDIO_CHANNEL_TFR] = { { _M(FR), 1.0f }, { _M(FC), 0.5f }, },
+	[SPA_AUDIO_CHANNEL_TRL] = { { _M(RL), 1.0f }, { _M(SL), 1.0f }, { _M(FL), M_SQRT1_2 },
+				    { _M(FC), 0.5f }, },
+	[SPA_AUDIO_CHANNEL_TRC] = { { _M(RC), 1.0f }, { _M(RL) | _M(RR), M_SQRT1_2 },
+				    { _M(SL) | _M(SR), M_SQRT1_2 }, { _M(FL) | _M(FR), 0.5f },
+				    { _M(FC), M_SQRT1_2 }, },
+	[SPA_AUDIO_CHANNEL_TRR] = { { _M(RR), 1.0f }, { _M(SR), 1.0f }, { _M(FR), M_SQRT1_2 },
+				    { _M(FC), 0.5f }, },
+};
+
+uint32_t channelmix_default_mask(uint32_t channels)
+{
+	switch (channels) {
+	case 1:
+		return _M(FC);
+	case 2:
+		return _M(FL) | _M(FR);
+	case 3:
+		return _M(FL) | _M(FR) | _M(LFE);
+	case 4:
+		return _M(FL) | _M(FR) | _M(RL) | _M(RR);
+	case 5:
+		return _M(FL) | _M(FR) | _M(FC) | _M(RL) | _M(RR);
+	case 6:
+		return _M(FL) | _M(FR) | _M(FC) | _M(LFE) | _M(RL) | _M(RR);
+	case 7:
+		return _M(FL) | _M(FR) | _M(FC) | _M(LFE) | _M(RC) | _M(SL) | _M(SR);
+	case 8:
+		return _M(FL) | _M(FR) | _M(FC) | _M(LFE) | _M(RL) | _M(RR) | _M(SL) | _M(SR);
+	default:
+		return 0;
+	}
+}
+
+static uint32_t get_mask(uint32_t mask, uint32_t channels)
+{
+	if (mask == 0 || (uint32_t) __builtin_popcount(mask) != channels)
+		mask = channelmix_default_mask(channels);
+	return mask;
+}
+
+/* the channel of position @pos in @mask */
+static inline uint32_t pos_to_channel(uint32_t mask, uint32_t pos)
+{
+	return __builtin_popcount(mask & ((1u << pos) - 1));
+}
+
+static void make_matrix(struct channelmix *mix, uint32_t src_mask, uint32_t dst_mask)
+{
+	float m[SPA_AUDIO_CHANNEL_MAX][SPA_AUDIO_CHANNEL_MAX] = { { 0.0f, }, };
+	uint32_t i, j, k;
+
+	for (i = 0; i < SPA_AUDIO_CHANNEL_MAX; i++) {
+		if (!(src_mask & (1u << i)))
+			continue;
+
+		if (dst_mask & (1u << i)) {
+			m[i][i] = 1.0f;
+		} else if (src_mask == _M(FC) && (dst_mask & (_M(FL) | _M(FR))) == (_M(FL) | _M(FR))) {
+			/* mono goes to the left and right at full level */
+			m[SPA_AUDIO_CHANNEL_FL][i] = m[SPA_AUDIO_CHANNEL_FR][i] = 1.0f;
+		} else {
+			for (k = 0; k < MAX_FOLDS && folds[i][k].mask; k++) {
+				if ((dst_mask & folds[i][k].mask) != folds[i][k].mask)
+					continue;
+				for (j = 0; j < SPA_AUDIO_CHANNEL_MAX; j++)
+					if (folds[i][k].mask & (1u << j))
+						m[j][i] = folds[i][k].gain;
+				break;
+			}
+		}
+	}
+	for (i = 0; i < SPA_AUDIO_CHANNEL_MAX; i++) {
+		if (!(dst_mask & (1u << i)))
+			continue;
+		for (j = 0; j < SPA_AUDIO_CHANNEL_MAX; j++) {
+			if (!(src_mask & (1u << j)))
+				continue;
+			mix->matrix[pos_to_channel(dst_mask, i)][pos_to_channel(src_mask, j)] = m[i][j];
+		}
+	}
+}
+
+void mix_scale_f32_c(float *d, const float *s, float gain, uint32_t n_samples)
+{
+	uint32_t i;
+
+	for (i = 0; i < n_samples; i++)
+		d[i] = s[i] * gain;
+}
+
+void mix_add_scale_f32_c(float *d, const float *s, float gain, uint32_t n_samples)
+{
+	uint32_t i;
+
+	for (i = 0; i < n_samples; i++)
+		d[i] += s[i] * gain;
+}
+
+static void
+channelmix_zero(struct channelmix *mix, void *dst[], const void *src[], uint32_t n_samples)
+{
+	uint32_t i;
+
+	for (i = 0; i < mix->dst_chan; i++)
+		memset(dst[i], 0, n_samples * sizeof(float));
+}
+
+static void
+channelmix_copy(struct channelmix *mix, void *dst[], const void *src[], uint32_t n_samples)
+{
+	uint32_t i;
+
+	for (i = 0; i < mix->dst_chan; i++) {
+		if (dst[i] != src[i])
+			memcpy(dst[i], src[i], n_samples * sizeof(float));
+	}
+}
+
+static void
+channelmix_permute(struct channelmix *mix, void *dst[], const void *src[], uint32_t n_samples)
+{
+	uint32_t i;
+
+	for (i = 0; i < mix->dst_chan; i++) {
+		if (mix->map[i] == SPA_ID_INVALID)
+			memset(dst[i], 0, n_samples * sizeof(float));
+		else
+			memcpy(dst[i], src[mix->map[i]], n_samples * sizeof(float));
+	}
+}
+
+/* each output is the sum of the inputs with a gain, inputs that are
+ * not used in the output are skipped */
+static void
+channelmix_f32(struct channelmix *mix, void *dst[], const void *src[], uint32_t n_samples)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < mix->dst_chan; i++) {
+		float *d = dst[i];
+		bool empty = true;
+
+		for (j = 0; j < mix->src_chan; j++) {
+			float gain = mix->matrix[i][j];
+
+			if (gain == 0.0f)
+				continue;
+
+			if (empty && gain == 1.0f)
+				memcpy(d, src[j], n_samples * sizeof(float));
+			else if (empty)
+				mix->scale(d, src[j], gain, n_samples);
+			else
+				mix->add_scale(d, src[j], gain, n_samples);
+			empty = false;
+		}
+		if (empty)
+			memset(d, 0, n_samples * sizeof(float));
+	}
+}
+
+uint32_t channelmix_get_cpu_flags(void)
+{
+	uint32_t cpu_flags = spa_cpu_get_flags(), flags = 0;
+
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		flags |= CHANNELMIX_CPU_SSE;
+	return flags;
+}
+
+int channelmix_init(struct channelmix *mix)
+{
+	uint32_t i, j, src_mask, dst_mask;
+	bool zero = true, identity, permutation = true;
+
+	if (mix->src_chan == 0 || mix->src_chan > CHANNELMIX_MAX_CHANNELS ||
+	    mix->dst_chan == 0 || mix->dst_chan > CHANNELMIX_MAX_CHANNELS)
+		return -EINVAL;
+
+	memset(mix->matrix, 0, sizeof(mix->matrix));
+
+	src_mask = get_mask(mix->src_mask, mix->src_chan);
+	dst_mask = get_mask(mix->dst_mask, mix->dst_chan);
+
+	if (src_mask == 0 || dst_mask == 0) {
+		/* without positions, the channels are kept in order */
+		for (i = 0; i < SPA_MIN(mix->src_chan, mix->dst_chan); i++)
+			mix->matrix[i][i] = 1.0f;
+	} else {
+		make_matrix(mix, src_mask, dst_mask);
+	}
+
+	identity = mix->src_chan == mix->dst_chan;
+	for (i = 0; i < mix->dst_chan; i++) {
+		uint32_t n_gains = 0;
+
+		mix->map[i] = SPA_ID_INVALID;
+		for (j = 0; j < mix->src_chan; j++) {
+			float gain = mix->matrix[i][j];
+
+			if (gain == 0.0f)
+				continue;
+			n_gains++;
+			if (gain == 1.0f)
+				mix->map[i] = j;
+		}
+		if (n_gains > 0)
+			zero = false;
+		if (n_gains > 1 || (n_gains == 1 && mix->map[i] == SPA_ID_INVALID))
+			permutation = false;
+		if (mix->map[i] != i || n_gains != 1)
+			identity = false;
+	}
+
+	mix->flags = 0;
+	if (zero)
+		mix->flags |= CHANNELMIX_FLAG_ZERO;
+	if (identity)
+		mix->flags |= CHANNELMIX_FLAG_IDENTITY;
+	if (permutation)
+		mix->flags |= CHANNELMIX_FLAG_PERMUTATION;
+
+	mix->scale = mix_scale_f32_c;
+	mix->add_scale = mix_add_scale_f32_c;
+#if defined(HAVE_SSE)
+	if (mix->cpu_flags & CHANNELMIX_CPU_SSE) {
+		mix->scale = mix_scale_f32_sse;
+		mix->add_scale = mix_add_scale_f32_sse;
+	}
+#endif
+
+	if (zero)
+		mix->process = channelmix_zero;
+	else if (identity)
+		mix->process = channelmix_copy;
+	else if (permutation)
+		mix->process = channelmix_permute;
+	else
+		mix->process = channelmix_f32;
+
+	return 0;
+}
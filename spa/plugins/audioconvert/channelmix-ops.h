@@ -0,0 +1,82 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __SPA_CHANNELMIX_OPS_H__
+#define __SPA_CHANNELMIX_OPS_H__
+
+#include <spa/defs.h>
+#include <spa/audio/raw.h>
+
+#define CHANNELMIX_MAX_CHANNELS	64
+
+#define CHANNELMIX_CPU_SSE	(1 << 0)
+
+/* all outputs are silent */
+#define CHANNELMIX_FLAG_ZERO		(1 << 0)
+/* the outputs are the inputs */
+#define CHANNELMIX_FLAG_IDENTITY	(1 << 1)
+/* each output is a copy of one input or silent */
+#define CHANNELMIX_FLAG_PERMUTATION	(1 << 2)
+
+/* d[i] = s[i] * gain */
+typedef void (*mix_scale_func_t) (float *d, const float *s, float gain, uint32_t n_samples);
+/* d[i] += s[i] * gain */
+typedef void (*mix_add_scale_func_t) (float *d, const float *s, float gain, uint32_t n_samples);
+
+/* mixes planar F32 channels with a matrix made from the channel positions */
+struct channelmix {
+	uint32_t cpu_flags;
+	uint32_t src_chan;
+	uint32_t src_mask;	/**< 0 for the default positions */
+	uint32_t dst_chan;
+	uint32_t dst_mask;	/**< 0 for the default positions */
+
+	uint32_t flags;
+	/* the gain of each input channel in each output channel */
+	float matrix[CHANNELMIX_MAX_CHANNELS][CHANNELMIX_MAX_CHANNELS];
+	/* with CHANNELMIX_FLAG_PERMUTATION, the input of each output or
+	 * SPA_ID_INVALID for silence */
+	uint32_t map[CHANNELMIX_MAX_CHANNELS];
+
+	mix_scale_func_t scale;
+	mix_add_scale_func_t add_scale;
+
+	void (*process) (struct channelmix *mix, void *dst[], const void *src[],
+			 uint32_t n_samples);
+};
+
+uint32_t channelmix_get_cpu_flags(void);
+
+/* the positions that are used for @channels when there is no channel mask */
+uint32_t channelmix_default_mask(uint32_t channels);
+
+/* make the matrix for the channels and masks in @mix and pick the
+ * process function */
+int channelmix_init(struct channelmix *mix);
+
+void mix_scale_f32_c(float *d, const float *s, float gain, uint32_t n_samples);
+void mix_add_scale_f32_c(float *d, const float *s, float gain, uint32_t n_samples);
+
+#if defined(HAVE_SSE)
+void mix_scale_f32_sse(float *d, const float *s, float gain, uint32_t n_samples);
+void mix_add_scale_f32_sse(float *d, const float *s, float gain, uint32_t n_samples);
+#endif
+
+#endif /* __SPA_CHANNELMIX_OPS_H__ */
@@ -0,0 +1,973 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <string.h>
+#include <stddef.h>
+
+#include <spa/log.h>
+#include <spa/type-map.h>
+#include <spa/node.h>
+#include <spa/list.h>
+#include <spa/audio/format-utils.h>
+#include <spa/format-builder.h>
+#include <spa/param-alloc.h>
+#include <lib/props.h>
+#include <lib/format.h>
+
+#include "fmt-ops.h"
+#include "channelmix-ops.h"
+
+#define NAME "channelmix"
+
+#define MAX_BUFFERS     16
+/* frames mixed at a time for interleaved ports */
+#define TMP_FRAMES	256
+
+struct buffer {
+	struct spa_buffer *outbuf;
+	bool outstanding;
+	struct spa_meta_header *h;
+	struct spa_list link;
+};
+
+struct port {
+	bool have_format;
+	struct spa_audio_info format;
+	uint32_t fmt;		/**< one of the FMT_ sample formats */
+	uint32_t layout;	/**< FMT_INTERLEAVED or FMT_PLANAR */
+	uint32_t stride;	/**< bytes of one frame in a plane */
+	uint32_t n_planes;
+
+	struct spa_port_info info;
+	uint8_t params_buffer[1024];
+
+	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+	struct spa_port_io *io;
+
+	struct spa_list empty;
+};
+
+struct type {
+	uint32_t node;
+	uint32_t format;
+	uint32_t props;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+	struct spa_type_event_node event_node;
+	struct spa_type_command_node command_node;
+	struct spa_type_param_alloc_buffers param_alloc_buffers;
+	struct spa_type_param_alloc_meta_enable param_alloc_meta_enable;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+	spa_type_event_node_map(map, &type->event_node);
+	spa_type_command_node_map(map, &type->command_node);
+	spa_type_param_alloc_buffers_map(map, &type->param_alloc_buffers);
+	spa_type_param_alloc_meta_enable_map(map, &type->param_alloc_meta_enable);
+}
+
+struct impl {
+	struct spa_handle handle;
+	struct spa_node node;
+
+	struct type type;
+	struct spa_type_map *map;
+	struct spa_log *log;
+
+	const struct spa_node_callbacks *callbacks;
+	void *callbacks_data;
+
+	uint8_t format_buffer[1024];
+
+	struct port in_ports[1];
+	struct port out_ports[1];
+
+	struct spa_fmt_ops ops;
+	struct channelmix mix;
+	bool have_mix;
+
+	float tmp_in[CHANNELMIX_MAX_CHANNELS][TMP_FRAMES] SPA_ALIGNED(16);
+	float tmp_out[CHANNELMIX_MAX_CHANNELS][TMP_FRAMES] SPA_ALIGNED(16);
+
+	bool started;
+};
+
+#define CHECK_IN_PORT(this,d,p)  ((d) == SPA_DIRECTION_INPUT && (p) == 0)
+#define CHECK_OUT_PORT(this,d,p) ((d) == SPA_DIRECTION_OUTPUT && (p) == 0)
+#define CHECK_PORT(this,d,p)     ((p) == 0)
+#define GET_IN_PORT(this,p)	 (&this->in_ports[p])
+#define GET_OUT_PORT(this,p)	 (&this->out_ports[p])
+#define GET_PORT(this,d,p)	 (d == SPA_DIRECTION_INPUT ? GET_IN_PORT(this,p) : GET_OUT_PORT(this,p))
+#define GET_OTHER_PORT(this,d)	 (d == SPA_DIRECTION_INPUT ? GET_OUT_PORT(this,0) : GET_IN_PORT(this,0))
+
+#define PROP(f,key,type,...)							\
+	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
+#define PROP_U_MM(f,key,type,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_U_EN(f,key,type,n,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
+
+/* make the matrix for the channels of the ports, called when one of the
+ * formats changes */
+static void setup_mix(struct impl *this)
+{
+	struct port *in = GET_IN_PORT(this, 0), *out = GET_OUT_PORT(this, 0);
+
+	this->have_mix = false;
+
+	if (!in->have_format || !out->have_format)
+		return;
+
+	this->mix.cpu_flags = channelmix_get_cpu_flags();
+	this->mix.src_chan = in->format.info.raw.channels;
+	this->mix.src_mask = in->format.info.raw.channel_mask;
+	this->mix.dst_chan = out->format.info.raw.channels;
+	this->mix.dst_mask = out->format.info.raw.channel_mask;
+
+	if (channelmix_init(&this->mix) < 0)
+		return;
+
+	this->have_mix = true;
+
+	spa_log_info(this->log, NAME " %p: mix %d (%08x) -> %d (%08x) flags %08x", this,
+		     this->mix.src_chan, this->mix.src_mask,
+		     this->mix.dst_chan, this->mix.dst_mask, this->mix.flags);
+}
+
+static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int impl_node_set_props(struct spa_node *node, const struct spa_props *props)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int impl_node_send_command(struct spa_node *node, const struct spa_command *command)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(command != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (SPA_COMMAND_TYPE(command) == this->type.command_node.Start) {
+		this->started = true;
+	} else if (SPA_COMMAND_TYPE(command) == this->type.command_node.Pause) {
+		this->started = false;
+	} else
+		return SPA_RESULT_NOT_IMPLEMENTED;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_set_callbacks(struct spa_node *node,
+			const struct spa_node_callbacks *callbacks,
+			void *data)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	this->callbacks = callbacks;
+	this->callbacks_data = data;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_get_n_ports(struct spa_node *node,
+		      uint32_t *n_input_ports,
+		      uint32_t *max_input_ports,
+		      uint32_t *n_output_ports,
+		      uint32_t *max_output_ports)
+{
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	if (n_input_ports)
+		*n_input_ports = 1;
+	if (max_input_ports)
+		*max_input_ports = 1;
+	if (n_output_ports)
+		*n_output_ports = 1;
+	if (max_output_ports)
+		*max_output_ports = 1;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_get_port_ids(struct spa_node *node,
+		       uint32_t n_input_ports,
+		       uint32_t *input_ids,
+		       uint32_t n_output_ports,
+		       uint32_t *output_ids)
+{
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	if (n_input_ports > 0 && input_ids)
+		input_ids[0] = 0;
+	if (n_output_ports > 0 && output_ids)
+		output_ids[0] = 0;
+
+	return SPA_RESULT_OK;
+}
+
+static int impl_node_add_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int
+impl_node_remove_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int
+impl_node_port_enum_formats(struct spa_node *node,
+			    enum spa_direction direction,
+			    uint32_t port_id,
+			    struct spa_format **format,
+			    const struct spa_format *filter,
+			    uint32_t index)
+{
+	struct impl *this;
+	int res;
+	struct spa_format *fmt;
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+	uint32_t count, match;
+	struct port *other;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(format != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	other = GET_OTHER_PORT(this, direction);
+
+	count = match = filter ? 0 : index;
+
+      next:
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (count++) {
+	case 0:
+		if (other->have_format) {
+			/* the rate can not change, the channels of the other
+			 * port are preferred, they need no mixing */
+			spa_pod_builder_format(&b, &f[0], this->type.format,
+				this->type.media_type.audio,
+				this->type.media_subtype.raw,
+				PROP(&f[1], this->type.format_audio.format, SPA_POD_TYPE_ID,
+					this->type.audio_format.F32),
+				PROP_U_EN(&f[1], this->type.format_audio.layout, SPA_POD_TYPE_INT, 3,
+					other->format.info.raw.layout,
+					SPA_AUDIO_LAYOUT_INTERLEAVED,
+					SPA_AUDIO_LAYOUT_NON_INTERLEAVED),
+				PROP(&f[1], this->type.format_audio.rate, SPA_POD_TYPE_INT,
+					other->format.info.raw.rate),
+				PROP_U_MM(&f[1], this->type.format_audio.channels, SPA_POD_TYPE_INT,
+					other->format.info.raw.channels,
+					1, CHANNELMIX_MAX_CHANNELS));
+		} else {
+			spa_pod_builder_format(&b, &f[0], this->type.format,
+				this->type.media_type.audio,
+				this->type.media_subtype.raw,
+				PROP(&f[1], this->type.format_audio.format, SPA_POD_TYPE_ID,
+					this->type.audio_format.F32),
+				PROP_U_EN(&f[1], this->type.format_audio.layout, SPA_POD_TYPE_INT, 3,
+					SPA_AUDIO_LAYOUT_INTERLEAVED,
+					SPA_AUDIO_LAYOUT_INTERLEAVED,
+					SPA_AUDIO_LAYOUT_NON_INTERLEAVED),
+				PROP_U_MM(&f[1], this->type.format_audio.rate, SPA_POD_TYPE_INT,
+					44100,
+					1, INT32_MAX),
+				PROP_U_MM(&f[1], this->type.format_audio.channels, SPA_POD_TYPE_INT,
+					2,
+					1, CHANNELMIX_MAX_CHANNELS));
+		}
+		break;
+	default:
+		return SPA_RESULT_ENUM_END;
+	}
+	fmt = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+
+	if ((res = spa_format_filter(fmt, filter, &b)) != SPA_RESULT_OK || match++ != index)
+		goto next;
+
+	*format = SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format);
+
+	return SPA_RESULT_OK;
+}
+
+static int clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_info(this->log, NAME " %p: clear buffers %p", this, port);
+		port->n_buffers = 0;
+		spa_list_init(&port->empty);
+	}
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_set_format(struct spa_node *node,
+			  enum spa_direction direction,
+			  uint32_t port_id,
+			  uint32_t flags,
+			  const struct spa_format *format)
+{
+	struct impl *this;
+	struct port *port, *other;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+	other = GET_OTHER_PORT(this, direction);
+
+	if (format == NULL) {
+		port->have_format = false;
+		clear_buffers(this, port);
+	} else {
+		struct spa_audio_info info = { SPA_FORMAT_MEDIA_TYPE(format),
+			SPA_FORMAT_MEDIA_SUBTYPE(format),
+		};
+
+		if (info.media_type != this->type.media_type.audio ||
+		    info.media_subtype != this->type.media_subtype.raw)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if (!spa_format_audio_raw_parse(format, &info.info.raw, &this->type.format_audio))
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if (info.info.raw.format != this->type.audio_format.F32)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if (info.info.raw.channels == 0 || info.info.raw.channels > CHANNELMIX_MAX_CHANNELS)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		/* we only change the channels */
+		if (other->have_format && info.info.raw.rate != other->format.info.raw.rate)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		port->format = info;
+		port->fmt = FMT_F32;
+		if (info.info.raw.layout == SPA_AUDIO_LAYOUT_NON_INTERLEAVED) {
+			port->layout = FMT_PLANAR;
+			port->stride = sizeof(float);
+			port->n_planes = info.info.raw.channels;
+		} else {
+			port->layout = FMT_INTERLEAVED;
+			port->stride = sizeof(float) * info.info.raw.channels;
+			port->n_planes = 1;
+		}
+		port->have_format = true;
+	}
+	setup_mix(this);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_get_format(struct spa_node *node,
+			  enum spa_direction direction,
+			  uint32_t port_id,
+			  const struct spa_format **format)
+{
+	struct impl *this;
+	struct port *port;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(format != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+	spa_pod_builder_format(&b, &f[0], this->type.format,
+		this->type.media_type.audio,
+		this->type.media_subtype.raw,
+		PROP(&f[1], this->type.format_audio.format, SPA_POD_TYPE_ID,
+			port->format.info.raw.format),
+		PROP(&f[1], this->type.format_audio.layout, SPA_POD_TYPE_INT,
+			port->format.info.raw.layout),
+		PROP(&f[1], this->type.format_audio.rate, SPA_POD_TYPE_INT,
+			port->format.info.raw.rate),
+		PROP(&f[1], this->type.format_audio.channels, SPA_POD_TYPE_INT,
+			port->format.info.raw.channels));
+	*format = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_get_info(struct spa_node *node,
+			enum spa_direction direction,
+			uint32_t port_id,
+			const struct spa_port_info **info)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(info != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+	*info = &port->info;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_enum_params(struct spa_node *node,
+			   enum spa_direction direction,
+			   uint32_t port_id,
+			   uint32_t index,
+			   struct spa_param **param)
+{
+	struct spa_pod_builder b = { NULL };
+	struct spa_pod_frame f[2];
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(param != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	spa_pod_builder_init(&b, port->params_buffer, sizeof(port->params_buffer));
+
+	switch (index) {
+	case 0:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_buffers.Buffers,
+			PROP_U_MM(&f[1], this->type.param_alloc_buffers.size,    SPA_POD_TYPE_INT,
+										  1024 * port->stride,
+										  16 * port->stride,
+										  INT32_MAX / port->stride),
+			PROP     (&f[1], this->type.param_alloc_buffers.stride,  SPA_POD_TYPE_INT,
+										  port->stride),
+			PROP_U_MM(&f[1], this->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+										  2, 1, MAX_BUFFERS),
+			PROP     (&f[1], this->type.param_alloc_buffers.align,   SPA_POD_TYPE_INT, 16));
+		break;
+
+	case 1:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+			PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+				this->type.meta.Header),
+			PROP(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+				sizeof(struct spa_meta_header)));
+		break;
+
+	default:
+		return SPA_RESULT_NOT_IMPLEMENTED;
+	}
+
+	*param = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_set_param(struct spa_node *node,
+			 enum spa_direction direction,
+			 uint32_t port_id,
+			 const struct spa_param *param)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int
+impl_node_port_use_buffers(struct spa_node *node,
+			   enum spa_direction direction,
+			   uint32_t port_id,
+			   struct spa_buffer **buffers,
+			   uint32_t n_buffers)
+{
+	struct impl *this;
+	struct port *port;
+	uint32_t i, j;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	clear_buffers(this, port);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b;
+		struct spa_data *d = buffers[i]->datas;
+
+		b = &port->buffers[i];
+		b->outbuf = buffers[i];
+		b->outstanding = direction == SPA_DIRECTION_INPUT;
+		b->h = spa_buffer_find_meta(buffers[i], this->type.meta.Header);
+
+		if (buffers[i]->n_datas < port->n_planes) {
+			spa_log_error(this->log, NAME " %p: buffer %p has %d of %d planes", this,
+				      buffers[i], buffers[i]->n_datas, port->n_planes);
+			return SPA_RESULT_ERROR;
+		}
+		for (j = 0; j < port->n_planes; j++) {
+			if (!((d[j].type == this->type.data.MemPtr ||
+			       d[j].type == this->type.data.MemFd ||
+			       d[j].type == this->type.data.DmaBuf) && d[j].data != NULL)) {
+				spa_log_error(this->log, NAME " %p: invalid memory on buffer %p", this,
+					      buffers[i]);
+				return SPA_RESULT_ERROR;
+			}
+		}
+		if (!b->outstanding)
+			spa_list_insert(port->empty.prev, &b->link);
+	}
+	port->n_buffers = n_buffers;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_alloc_buffers(struct spa_node *node,
+			     enum spa_direction direction,
+			     uint32_t port_id,
+			     struct spa_param **params,
+			     uint32_t n_params,
+			     struct spa_buffer **buffers,
+			     uint32_t *n_buffers)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int
+impl_node_port_set_io(struct spa_node *node,
+		      enum spa_direction direction,
+		      uint32_t port_id,
+		      struct spa_port_io *io)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+	port->io = io;
+
+	return SPA_RESULT_OK;
+}
+
+static void recycle_buffer(struct impl *this, uint32_t id)
+{
+	struct port *port = GET_OUT_PORT(this, 0);
+	struct buffer *b = &port->buffers[id];
+
+	if (!b->outstanding) {
+		spa_log_warn(this->log, NAME " %p: buffer %d not outstanding", this, id);
+		return;
+	}
+
+	spa_list_insert(port->empty.prev, &b->link);
+	b->outstanding = false;
+	spa_log_trace(this->log, NAME " %p: recycle buffer %d", this, id);
+}
+
+static int impl_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, SPA_DIRECTION_OUTPUT, port_id),
+			       SPA_RESULT_INVALID_PORT);
+
+	port = GET_OUT_PORT(this, port_id);
+
+	if (port->n_buffers == 0)
+		return SPA_RESULT_NO_BUFFERS;
+
+	if (buffer_id >= port->n_buffers)
+		return SPA_RESULT_INVALID_BUFFER_ID;
+
+	recycle_buffer(this, buffer_id);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_send_command(struct spa_node *node,
+			    enum spa_direction direction,
+			    uint32_t port_id,
+			    const struct spa_command *command)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static struct spa_buffer *find_free_buffer(struct impl *this, struct port *port)
+{
+	struct buffer *b;
+
+	if (spa_list_is_empty(&port->empty))
+		return NULL;
+
+	b = spa_list_first(&port->empty, struct buffer, link);
+	spa_list_remove(&b->link);
+	b->outstanding = true;
+
+	return b->outbuf;
+}
+
+/* mix in blocks of TMP_FRAMES through the planar buffers, planar ports
+ * are used directly */
+static void
+mix_blocks(struct impl *this, void *dst[], const void *src[], uint32_t n_frames)
+{
+	struct port *in = GET_IN_PORT(this, 0), *out = GET_OUT_PORT(this, 0);
+	uint32_t i, n, c;
+	uint32_t src_chan = in->format.info.raw.channels, dst_chan = out->format.info.raw.channels;
+	const void *s[CHANNELMIX_MAX_CHANNELS];
+	void *d[CHANNELMIX_MAX_CHANNELS];
+
+	for (i = 0; i < n_frames; i += n) {
+		n = SPA_MIN(n_frames - i, TMP_FRAMES);
+
+		if (in->layout == FMT_PLANAR) {
+			for (c = 0; c < src_chan; c++)
+				s[c] = SPA_MEMBER(src[c], i * in->stride, void);
+		} else {
+			const void *is[1] = { SPA_MEMBER(src[0], i * in->stride, void) };
+
+			for (c = 0; c < src_chan; c++)
+				s[c] = this->tmp_in[c];
+			this->ops.deinterleave[FMT_F32]((void **) s, is, src_chan, n);
+		}
+		if (out->layout == FMT_PLANAR) {
+			for (c = 0; c < dst_chan; c++)
+				d[c] = SPA_MEMBER(dst[c], i * out->stride, void);
+		} else {
+			for (c = 0; c < dst_chan; c++)
+				d[c] = this->tmp_out[c];
+		}
+
+		this->mix.process(&this->mix, d, s, n);
+
+		if (out->layout == FMT_INTERLEAVED) {
+			void *od[1] = { SPA_MEMBER(dst[0], i * out->stride, void) };
+			this->ops.interleave[FMT_F32](od, (const void **) d, dst_chan, n);
+		}
+	}
+}
+
+static void do_mix(struct impl *this, struct spa_buffer *dbuf, struct spa_buffer *sbuf)
+{
+	struct port *in = GET_IN_PORT(this, 0), *out = GET_OUT_PORT(this, 0);
+	uint32_t i, n_frames;
+	const void *src[CHANNELMIX_MAX_CHANNELS];
+	void *dst[CHANNELMIX_MAX_CHANNELS];
+	struct spa_data *sd = sbuf->datas, *dd = dbuf->datas;
+
+	n_frames = UINT32_MAX;
+	for (i = 0; i < in->n_planes; i++) {
+		src[i] = SPA_MEMBER(sd[i].data, sd[i].chunk->offset, void);
+		n_frames = SPA_MIN(n_frames, sd[i].chunk->size / in->stride);
+	}
+	for (i = 0; i < out->n_planes; i++) {
+		dst[i] = dd[i].data;
+		n_frames = SPA_MIN(n_frames, dd[i].maxsize / out->stride);
+	}
+
+	spa_log_trace(this->log, NAME " %p: mix %d frames", this, n_frames);
+
+	/* the same channels in the same layout are copied */
+	if ((this->mix.flags & CHANNELMIX_FLAG_IDENTITY) && in->layout == out->layout) {
+		for (i = 0; i < in->n_planes; i++)
+			memcpy(dst[i], src[i], n_frames * in->stride);
+	} else {
+		mix_blocks(this, dst, src, n_frames);
+	}
+
+	for (i = 0; i < out->n_planes; i++) {
+		dd[i].chunk->offset = 0;
+		dd[i].chunk->size = n_frames * out->stride;
+		dd[i].chunk->stride = out->stride;
+	}
+}
+
+static int impl_node_process_input(struct spa_node *node)
+{
+	struct impl *this;
+	struct spa_port_io *input, *output;
+	struct port *in_port, *out_port;
+	struct spa_buffer *dbuf, *sbuf;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = GET_OUT_PORT(this, 0);
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, SPA_RESULT_ERROR);
+
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
+
+	in_port = GET_IN_PORT(this, 0);
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, SPA_RESULT_ERROR);
+
+	if (!this->have_mix)
+		return SPA_RESULT_NO_FORMAT;
+
+	if (input->buffer_id >= in_port->n_buffers)
+		return SPA_RESULT_NEED_BUFFER;
+
+	if ((dbuf = find_free_buffer(this, out_port)) == NULL)
+		return SPA_RESULT_OUT_OF_BUFFERS;
+
+	sbuf = in_port->buffers[input->buffer_id].outbuf;
+
+	input->status = SPA_RESULT_NEED_BUFFER;
+
+	do_mix(this, dbuf, sbuf);
+
+	output->buffer_id = dbuf->id;
+	output->status = SPA_RESULT_HAVE_BUFFER;
+
+	return SPA_RESULT_HAVE_BUFFER;
+}
+
+static int impl_node_process_output(struct spa_node *node)
+{
+	struct impl *this;
+	struct port *in_port, *out_port;
+	struct spa_port_io *input, *output;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = GET_OUT_PORT(this, 0);
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, SPA_RESULT_ERROR);
+
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
+
+	in_port = GET_IN_PORT(this, 0);
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, SPA_RESULT_ERROR);
+
+	if (output->buffer_id < out_port->n_buffers) {
+		recycle_buffer(this, output->buffer_id);
+		output->buffer_id = SPA_ID_INVALID;
+	}
+
+	/* the input needs the same number of frames */
+	input->range = output->range;
+	input->range.min_size = output->range.min_size / out_port->stride * in_port->stride;
+	input->range.max_size = output->range.max_size / out_port->stride * in_port->stride;
+	input->status = SPA_RESULT_NEED_BUFFER;
+
+	return SPA_RESULT_NEED_BUFFER;
+}
+
+static const struct spa_node impl_node = {
+	SPA_VERSION_NODE,
+	NULL,
+	impl_node_get_props,
+	impl_node_set_props,
+	impl_node_send_command,
+	impl_node_set_callbacks,
+	impl_node_get_n_ports,
+	impl_node_get_port_ids,
+	impl_node_add_port,
+	impl_node_remove_port,
+	impl_node_port_enum_formats,
+	impl_node_port_set_format,
+	impl_node_port_get_format,
+	impl_node_port_get_info,
+	impl_node_port_enum_params,
+	impl_node_port_set_param,
+	impl_node_port_use_buffers,
+	impl_node_port_alloc_buffers,
+	impl_node_port_set_io,
+	impl_node_port_reuse_buffer,
+	impl_node_port_send_command,
+	impl_node_process_input,
+	impl_node_process_output,
+};
+
+static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id, void **interface)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(interface != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = (struct impl *) handle;
+
+	if (interface_id == this->type.node)
+		*interface = &this->node;
+	else
+		return SPA_RESULT_UNKNOWN_INTERFACE;
+
+	return SPA_RESULT_OK;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_init(const struct spa_handle_factory *factory,
+	  struct spa_handle *handle,
+	  const struct spa_dict *info,
+	  const struct spa_support *support,
+	  uint32_t n_support)
+{
+	struct impl *this;
+	uint32_t i;
+
+	spa_return_val_if_fail(factory != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	this = (struct impl *) handle;
+
+	for (i = 0; i < n_support; i++) {
+		if (strcmp(support[i].type, SPA_TYPE__TypeMap) == 0)
+			this->map = support[i].data;
+		else if (strcmp(support[i].type, SPA_TYPE__Log) == 0)
+			this->log = support[i].data;
+	}
+	if (this->map == NULL) {
+		spa_log_error(this->log, "a type-map is needed");
+		return SPA_RESULT_ERROR;
+	}
+	init_type(&this->type, this->map);
+
+	this->node = impl_node;
+	spa_fmt_init_ops(&this->ops, spa_fmt_get_cpu_flags());
+
+	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	spa_list_init(&this->in_ports[0].empty);
+
+	this->out_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
+	    SPA_PORT_INFO_FLAG_NO_REF;
+	spa_list_init(&this->out_ports[0].empty);
+
+	return SPA_RESULT_OK;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE__Node,},
+};
+
+static int
+impl_enum_interface_info(const struct spa_handle_factory *factory,
+			 const struct spa_interface_info **info,
+			 uint32_t index)
+{
+	spa_return_val_if_fail(factory != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(info != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	switch (index) {
+	case 0:
+		*info = &impl_interfaces[index];
+		break;
+	default:
+		return SPA_RESULT_ENUM_END;
+	}
+	return SPA_RESULT_OK;
+}
+
+const struct spa_handle_factory spa_channelmix_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	NAME,
+	NULL,
+	sizeof(struct impl),
+	impl_init,
+	impl_enum_interface_info,
+};
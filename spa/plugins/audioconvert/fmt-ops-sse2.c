@@ -0,0 +1,173 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <emmintrin.h>
+
+#include "fmt-ops.h"
+
+/* The vector versions handle mono and stereo, the common cases, and
+ * leave other channel counts and the last frames to the C versions. */
+
+static inline void
+offset_planes(void *planes[], void *const base[], uint32_t n_planes, uint32_t offset)
+{
+	uint32_t i;
+	for (i = 0; i < n_planes; i++)
+		planes[i] = SPA_MEMBER(base[i], offset, void);
+}
+
+static void
+conv_s16_to_f32d_sse2(void *dst[], const void *src[], uint32_t n_channels, uint32_t n_frames)
+{
+	const int16_t *s = src[0];
+	float *d0 = dst[0], *d1 = n_channels > 1 ? dst[1] : NULL;
+	const __m128 scale = _mm_set1_ps(1.0f / 32767.0f);
+	__m128i in, lo, hi;
+	__m128 fl, fh;
+	uint32_t i = 0, n;
+	void *d[2];
+
+	if (n_channels == 1) {
+		for (n = n_frames & ~7; i < n; i += 8) {
+			in = _mm_loadu_si128((const __m128i *) &s[i]);
+			lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+			hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+			_mm_storeu_ps(&d0[i], _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			_mm_storeu_ps(&d0[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+	} else if (n_channels == 2) {
+		for (n = n_frames & ~3; i < n; i += 4) {
+			/* L0 R0 L1 R1 and L2 R2 L3 R3 */
+			in = _mm_loadu_si128((const __m128i *) &s[i * 2]);
+			lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+			hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+			fl = _mm_mul_ps(_mm_cvtepi32_ps(lo), scale);
+			fh = _mm_mul_ps(_mm_cvtepi32_ps(hi), scale);
+			_mm_storeu_ps(&d0[i], _mm_shuffle_ps(fl, fh, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(&d1[i], _mm_shuffle_ps(fl, fh, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	if (i == n_frames)
+		return;
+
+	offset_planes(d, dst, SPA_MIN(n_channels, 2), i * sizeof(float));
+	if (n_channels <= 2)
+		conv_s16_to_f32d_c(d, (const void *[]) { &s[i * n_channels] },
+				   n_channels, n_frames - i);
+	else
+		conv_s16_to_f32d_c(dst, src, n_channels, n_frames);
+}
+
+static void
+conv_f32d_to_s16_sse2(void *dst[], const void *src[], uint32_t n_channels, uint32_t n_frames)
+{
+	const float *s0 = src[0], *s1 = n_channels > 1 ? src[1] : NULL;
+	int16_t *d = dst[0];
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	const __m128 min = _mm_set1_ps(-1.0f), max = _mm_set1_ps(1.0f);
+	__m128i l, r;
+	uint32_t i = 0, n;
+	const void *s[2];
+
+#define TO_S16(v) _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(v, min), max), scale))
+
+	if (n_channels == 1) {
+		for (n = n_frames & ~7; i < n; i += 8) {
+			l = TO_S16(_mm_loadu_ps(&s0[i]));
+			r = TO_S16(_mm_loadu_ps(&s0[i + 4]));
+			_mm_storeu_si128((__m128i *) &d[i], _mm_packs_epi32(l, r));
+		}
+	} else if (n_channels == 2) {
+		for (n = n_frames & ~3; i < n; i += 4) {
+			l = TO_S16(_mm_loadu_ps(&s0[i]));
+			r = TO_S16(_mm_loadu_ps(&s1[i]));
+			_mm_storeu_si128((__m128i *) &d[i * 2],
+					 _mm_packs_epi32(_mm_unpacklo_epi32(l, r),
+							 _mm_unpackhi_epi32(l, r)));
+		}
+	}
+#undef TO_S16
+	if (i == n_frames)
+		return;
+
+	if (n_channels <= 2) {
+		offset_planes((void **) s, (void *const *) src, n_channels, i * sizeof(float));
+		conv_f32d_to_s16_c((void *[]) { &d[i * n_channels] }, s, n_channels, n_frames - i);
+	} else
+		conv_f32d_to_s16_c(dst, src, n_channels, n_frames);
+}
+
+static void
+conv_f32_to_f32d_sse2(void *dst[], const void *src[], uint32_t n_channels, uint32_t n_frames)
+{
+	const float *s = src[0];
+	float *d0 = dst[0], *d1 = n_channels > 1 ? dst[1] : NULL;
+	__m128 lo, hi;
+	uint32_t i = 0, n;
+	void *d[2];
+
+	if (n_channels != 2) {
+		conv_f32_to_f32d_c(dst, src, n_channels, n_frames);
+		return;
+	}
+	for (n = n_frames & ~3; i < n; i += 4) {
+		lo = _mm_loadu_ps(&s[i * 2]);
+		hi = _mm_loadu_ps(&s[i * 2 + 4]);
+		_mm_storeu_ps(&d0[i], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(&d1[i], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+	if (i < n_frames) {
+		offset_planes(d, dst, 2, i * sizeof(float));
+		conv_f32_to_f32d_c(d, (const void *[]) { &s[i * 2] }, 2, n_frames - i);
+	}
+}
+
+static void
+conv_f32d_to_f32_sse2(void *dst[], const void *src[], uint32_t n_channels, uint32_t n_frames)
+{
+	const float *s0 = src[0], *s1 = n_channels > 1 ? src[1] : NULL;
+	float *d = dst[0];
+	__m128 l, r;
+	uint32_t i = 0, n;
+	const void *s[2];
+
+	if (n_channels != 2) {
+		conv_f32d_to_f32_c(dst, src, n_channels, n_frames);
+		return;
+	}
+	for (n = n_frames & ~3; i < n; i += 4) {
+		l = _mm_loadu_ps(&s0[i]);
+		r = _mm_loadu_ps(&s1[i]);
+		_mm_storeu_ps(&d[i * 2], _mm_unpacklo_ps(l, r));
+		_mm_storeu_ps(&d[i * 2 + 4], _mm_unpackhi_ps(l, r));
+	}
+	if (i < n_frames) {
+		offset_planes((void **) s, (void *const *) src, 2, i * sizeof(float));
+		conv_f32d_to_f32_c((void *[]) { &d[i * 2] }, s, 2, n_frames - i);
+	}
+}
+
+void spa_fmt_init_ops_sse2(struct spa_fmt_ops *ops)
+{
+	ops->to_f32d[FMT_S16][FMT_INTERLEAVED] = conv_s16_to_f32d_sse2;
+	ops->from_f32d[FMT_S16][FMT_INTERLEAVED] = conv_f32d_to_s16_sse2;
+	ops->to_f32d[FMT_F32][FMT_INTERLEAVED] = conv_f32_to_f32d_sse2;
+	ops->from_f32d[FMT_F32][FMT_INTERLEAVED] = conv_f32d_to_f32_sse2;
+}
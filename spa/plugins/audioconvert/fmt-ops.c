@@ -0,0 +1,298 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <math.h>
+#include <endian.h>
+
+#include <spa/cpu.h>
+
+#include "fmt-ops.h"
+
+#define U8_SCALE	127.0f
+#define S16_SCALE	32767.0f
+#define S24_SCALE	8388607.0f
+#define S32_SCALE	2147483647.0
+
+const uint32_t spa_fmt_sizes[FMT_MAX] = {
+	[FMT_U8] = sizeof(uint8_t),
+	[FMT_S16] = sizeof(int16_t),
+	[FMT_S24] = 3,
+	[FMT_S24_32] = sizeof(int32_t),
+	[FMT_S32] = sizeof(int32_t),
+	[FMT_F32] = sizeof(float),
+	[FMT_F64] = sizeof(double),
+};
+
+static inline float read_u8(const void *p)
+{
+	return (*(const uint8_t *) p - 128) * (1.0f / U8_SCALE);
+}
+
+static inline float read_s16(const void *p)
+{
+	return *(const int16_t *) p * (1.0f / S16_SCALE);
+}
+
+static inline float read_s24(const void *p)
+{
+	const uint8_t *b = p;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	int32_t v = (int32_t) (((uint32_t) b[2] << 24) | (b[1] << 16) | (b[0] << 8)) >> 8;
+#else
+	int32_t v = (int32_t) (((uint32_t) b[0] << 24) | (b[1] << 16) | (b[2] << 8)) >> 8;
+#endif
+	return v * (1.0f / S24_SCALE);
+}
+
+static inline float read_s24_32(const void *p)
+{
+	int32_t v = (int32_t) ((uint32_t) *(const int32_t *) p << 8) >> 8;
+	return v * (1.0f / S24_SCALE);
+}
+
+static inline float read_s32(const void *p)
+{
+	return *(const int32_t *) p * (1.0 / S32_SCALE);
+}
+
+static inline float read_f32(const void *p)
+{
+	return *(const float *) p;
+}
+
+static inline float read_f64(const void *p)
+{
+	return *(const double *) p;
+}
+
+static inline void write_u8(void *p, float v)
+{
+	*(uint8_t *) p = lrintf(SPA_CLAMP(v, -1.0f, 1.0f) * U8_SCALE) + 128;
+}
+
+static inline void write_s16(void *p, float v)
+{
+	*(int16_t *) p = lrintf(SPA_CLAMP(v, -1.0f, 1.0f) * S16_SCALE);
+}
+
+static inline void write_s24(void *p, float v)
+{
+	int32_t t = lrintf(SPA_CLAMP(v, -1.0f, 1.0f) * S24_SCALE);
+	uint8_t *b = p;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	b[0] = t;
+	b[1] = t >> 8;
+	b[2] = t >> 16;
+#else
+	b[0] = t >> 16;
+	b[1] = t >> 8;
+	b[2] = t;
+#endif
+}
+
+static inline void write_s24_32(void *p, float v)
+{
+	*(int32_t *) p = lrintf(SPA_CLAMP(v, -1.0f, 1.0f) * S24_SCALE);
+}
+
+static inline void write_s32(void *p, float v)
+{
+	*(int32_t *) p = lrint(SPA_CLAMP(v, -1.0f, 1.0f) * S32_SCALE);
+}
+
+static inline void write_f32(void *p, float v)
+{
+	*(float *) p = v;
+}
+
+static inline void write_f64(void *p, float v)
+{
+	*(double *) p = v;
+}
+
+/* make the converters between planar F32 and interleaved samples */
+#define MAKE_CONV(fmt,size,qual)							\
+qual void conv_##fmt##_to_f32d_c(void *dst[], const void *src[],			\
+		uint32_t n_channels, uint32_t n_frames)					\
+{											\
+	const uint8_t *s = src[0];							\
+	uint32_t i, c;									\
+	for (i = 0; i < n_frames; i++) {						\
+		for (c = 0; c < n_channels; c++, s += size)				\
+			((float *) dst[c])[i] = read_##fmt(s);				\
+	}										\
+}											\
+qual void conv_f32d_to_##fmt##_c(void *dst[], const void *src[],			\
+		uint32_t n_channels, uint32_t n_frames)					\
+{											\
+	uint8_t *d = dst[0];								\
+	uint32_t i, c;									\
+	for (i = 0; i < n_frames; i++) {						\
+		for (c = 0; c < n_channels; c++, d += size)				\
+			write_##fmt(d, ((const float *) src[c])[i]);			\
+	}										\
+}
+
+/* make the converters between planar F32 and planar samples */
+#define MAKE_CONV_D(fmt,size)								\
+static void conv_##fmt##d_to_f32d_c(void *dst[], const void *src[],			\
+		uint32_t n_channels, uint32_t n_frames)					\
+{											\
+	uint32_t i, c;									\
+	for (c = 0; c < n_channels; c++) {						\
+		const uint8_t *s = src[c];						\
+		float *d = dst[c];							\
+		for (i = 0; i < n_frames; i++, s += size)				\
+			d[i] = read_##fmt(s);						\
+	}										\
+}											\
+static void conv_f32d_to_##fmt##d_c(void *dst[], const void *src[],			\
+		uint32_t n_channels, uint32_t n_frames)					\
+{											\
+	uint32_t i, c;									\
+	for (c = 0; c < n_channels; c++) {						\
+		const float *s = src[c];						\
+		uint8_t *d = dst[c];							\
+		for (i = 0; i < n_frames; i++, d += size)				\
+			write_##fmt(d, s[i]);						\
+	}										\
+}
+
+MAKE_CONV(u8, 1, static)
+MAKE_CONV(s16, 2, )
+MAKE_CONV(s24, 3, static)
+MAKE_CONV(s24_32, 4, static)
+MAKE_CONV(s32, 4, static)
+MAKE_CONV(f32, 4, )
+MAKE_CONV(f64, 8, static)
+
+MAKE_CONV_D(u8, 1)
+MAKE_CONV_D(s16, 2)
+MAKE_CONV_D(s24, 3)
+MAKE_CONV_D(s24_32, 4)
+MAKE_CONV_D(s32, 4)
+MAKE_CONV_D(f64, 8)
+
+static void conv_f32d_to_f32d_c(void *dst[], const void *src[],
+		uint32_t n_channels, uint32_t n_frames)
+{
+	uint32_t c;
+	for (c = 0; c < n_channels; c++)
+		memcpy(dst[c], src[c], n_frames * sizeof(float));
+}
+
+/* change the layout of samples of @size bytes */
+#define MAKE_LAYOUT(size)								\
+static void interleave_##size(void *dst[], const void *src[],				\
+		uint32_t n_channels, uint32_t n_frames)					\
+{											\
+	uint8_t *d = dst[0];								\
+	uint32_t i, c;									\
+	for (c = 0; c < n_channels; c++) {						\
+		const uint8_t *s = src[c];						\
+		for (i = 0; i < n_frames; i++)						\
+			memcpy(&d[(i * n_channels + c) * size], &s[i * size], size);	\
+	}										\
+}											\
+static void deinterleave_##size(void *dst[], const void *src[],			\
+		uint32_t n_channels, uint32_t n_frames)					\
+{											\
+	const uint8_t *s = src[0];							\
+	uint32_t i, c;									\
+	for (c = 0; c < n_channels; c++) {						\
+		uint8_t *d = dst[c];							\
+		for (i = 0; i < n_frames; i++)						\
+			memcpy(&d[i * size], &s[(i * n_channels + c) * size], size);	\
+	}										\
+}
+
+MAKE_LAYOUT(1)
+MAKE_LAYOUT(2)
+MAKE_LAYOUT(3)
+MAKE_LAYOUT(4)
+MAKE_LAYOUT(8)
+
+void spa_fmt_dither_f32(float *data, uint32_t n_samples, float scale, uint32_t *seed)
+{
+	uint32_t i, s = *seed, r1, r2;
+
+	for (i = 0; i < n_samples; i++) {
+		/* the difference of two uniform values has a triangular
+		 * distribution between -scale and scale */
+		r1 = s = s * 1664525 + 1013904223;
+		r2 = s = s * 1664525 + 1013904223;
+		data[i] += ((int32_t) (r1 >> 1) - (int32_t) (r2 >> 1)) * (scale / (1u << 31));
+	}
+	*seed = s;
+}
+
+uint32_t spa_fmt_get_cpu_flags(void)
+{
+	uint32_t cpu_flags = spa_cpu_get_flags(), flags = 0;
+
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		flags |= SPA_FMT_CPU_SSE2;
+	return flags;
+}
+
+#define INIT_CONV(ops,FMT,fmt)								\
+	ops->to_f32d[FMT][FMT_INTERLEAVED] = conv_##fmt##_to_f32d_c;			\
+	ops->from_f32d[FMT][FMT_INTERLEAVED] = conv_f32d_to_##fmt##_c;
+
+#define INIT_CONV_D(ops,FMT,fmt)							\
+	ops->to_f32d[FMT][FMT_PLANAR] = conv_##fmt##d_to_f32d_c;			\
+	ops->from_f32d[FMT][FMT_PLANAR] = conv_f32d_to_##fmt##d_c;
+
+#define INIT_LAYOUT(ops,FMT,size)							\
+	ops->interleave[FMT] = interleave_##size;					\
+	ops->deinterleave[FMT] = deinterleave_##size;
+
+void spa_fmt_init_ops(struct spa_fmt_ops *ops, uint32_t cpu_flags)
+{
+	INIT_CONV(ops, FMT_U8, u8)
+	INIT_CONV(ops, FMT_S16, s16)
+	INIT_CONV(ops, FMT_S24, s24)
+	INIT_CONV(ops, FMT_S24_32, s24_32)
+	INIT_CONV(ops, FMT_S32, s32)
+	INIT_CONV(ops, FMT_F32, f32)
+	INIT_CONV(ops, FMT_F64, f64)
+
+	INIT_CONV_D(ops, FMT_U8, u8)
+	INIT_CONV_D(ops, FMT_S16, s16)
+	INIT_CONV_D(ops, FMT_S24, s24)
+	INIT_CONV_D(ops, FMT_S24_32, s24_32)
+	INIT_CONV_D(ops, FMT_S32, s32)
+	INIT_CONV_D(ops, FMT_F64, f64)
+	ops->to_f32d[FMT_F32][FMT_PLANAR] = conv_f32d_to_f32d_c;
+	ops->from_f32d[FMT_F32][FMT_PLANAR] = conv_f32d_to_f32d_c;
+
+	INIT_LAYOUT(ops, FMT_U8, 1)
+	INIT_LAYOUT(ops, FMT_S16, 2)
+	INIT_LAYOUT(ops, FMT_S24, 3)
+	INIT_LAYOUT(ops, FMT_S24_32, 4)
+	INIT_LAYOUT(ops, FMT_S32, 4)
+	INIT_LAYOUT(ops, FMT_F32, 4)
+	INIT_LAYOUT(ops, FMT_F64, 8)
+
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_FMT_CPU_SSE2)
+		spa_fmt_init_ops_sse2(ops);
+#endif
+}
@@ -0,0 +1,82 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <string.h>
+#include <stdio.h>
+#include <spa/defs.h>
+
+#define FMT_MAX_CHANNELS	64
+
+/* Convert @n_frames of @n_channels. @src and @dst have a pointer for each
+ * plane, interleaved samples use only the first plane and planar samples
+ * have a plane for each channel. */
+typedef void (*convert_func_t) (void *dst[], const void *src[],
+				uint32_t n_channels, uint32_t n_frames);
+
+enum {
+	FMT_U8,
+	FMT_S16,
+	FMT_S24,
+	FMT_S24_32,
+	FMT_S32,
+	FMT_F32,
+	FMT_F64,
+	FMT_MAX,
+};
+
+enum {
+	FMT_INTERLEAVED,
+	FMT_PLANAR,
+	FMT_LAYOUT_MAX,
+};
+
+struct spa_fmt_ops {
+	/* from a format to planar F32 */
+	convert_func_t to_f32d[FMT_MAX][FMT_LAYOUT_MAX];
+	/* from planar F32 to a format */
+	convert_func_t from_f32d[FMT_MAX][FMT_LAYOUT_MAX];
+	/* change the layout without changing the format */
+	convert_func_t interleave[FMT_MAX];
+	convert_func_t deinterleave[FMT_MAX];
+};
+
+/* size of one sample of each format */
+extern const uint32_t spa_fmt_sizes[FMT_MAX];
+
+#define SPA_FMT_CPU_SSE2	(1 << 0)
+
+uint32_t spa_fmt_get_cpu_flags(void);
+
+/* fill @ops with the fastest functions for @cpu_flags */
+void spa_fmt_init_ops(struct spa_fmt_ops *ops, uint32_t cpu_flags);
+
+/* add triangular dither of @scale to @n_samples floats, @seed is the
+ * state of the noise generator */
+void spa_fmt_dither_f32(float *data, uint32_t n_samples, float scale, uint32_t *seed);
+
+/* plain C versions, also used for the tails of the vector versions */
+void conv_s16_to_f32d_c(void *dst[], const void *src[], uint32_t n_channels, uint32_t n_frames);
+void conv_f32d_to_s16_c(void *dst[], const void *src[], uint32_t n_channels, uint32_t n_frames);
+void conv_f32_to_f32d_c(void *dst[], const void *src[], uint32_t n_channels, uint32_t n_frames);
+void conv_f32d_to_f32_c(void *dst[], const void *src[], uint32_t n_channels, uint32_t n_frames);
+
+#if defined(HAVE_SSE2)
+void spa_fmt_init_ops_sse2(struct spa_fmt_ops *ops);
+#endif
@@ -0,0 +1,61 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <spa/defs.h>
+
+#include <immintrin.h>
+
+#include "resample.h"
+
+static inline float hsum_avx(__m256 sum)
+{
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x55));
+	return _mm_cvtss_f32(s);
+}
+
+/* @taps is aligned to 32 bytes and @n_taps is a multiple of 8 */
+void inner_product_avx(float *d, const float *s, const float *taps, uint32_t n_taps)
+{
+	__m256 sum = _mm256_setzero_ps();
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i += 8)
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(s + i),
+						       _mm256_load_ps(taps + i)));
+	*d = hsum_avx(sum);
+}
+
+void inner_product_ip_avx(float *d, const float *s, const float *t0, const float *t1,
+			  float x, uint32_t n_taps)
+{
+	__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps(), ss;
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i += 8) {
+		ss = _mm256_loadu_ps(s + i);
+		sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(ss, _mm256_load_ps(t0 + i)));
+		sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(ss, _mm256_load_ps(t1 + i)));
+	}
+	sum1 = _mm256_sub_ps(sum1, sum0);
+	sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(sum1, _mm256_set1_ps(x)));
+	*d = hsum_avx(sum0);
+}
@@ -0,0 +1,67 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <spa/defs.h>
+
+#include <xmmintrin.h>
+
+#include "resample.h"
+
+/* @taps is aligned to 16 bytes and @n_taps is a multiple of 8 */
+static inline __m128 dot_sse(const float *s, const float *taps, uint32_t n_taps)
+{
+	__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(s + i), _mm_load_ps(taps + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(s + i + 4), _mm_load_ps(taps + i + 4)));
+	}
+	return _mm_add_ps(sum0, sum1);
+}
+
+static inline float hsum_sse(__m128 sum)
+{
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+	return _mm_cvtss_f32(sum);
+}
+
+void inner_product_sse(float *d, const float *s, const float *taps, uint32_t n_taps)
+{
+	*d = hsum_sse(dot_sse(s, taps, n_taps));
+}
+
+void inner_product_ip_sse(float *d, const float *s, const float *t0, const float *t1,
+			  float x, uint32_t n_taps)
+{
+	__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps(), ss;
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i += 4) {
+		ss = _mm_loadu_ps(s + i);
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(ss, _mm_load_ps(t0 + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(ss, _mm_load_ps(t1 + i)));
+	}
+	/* interpolate the sums, it is the same as interpolating the taps */
+	sum1 = _mm_sub_ps(sum1, sum0);
+	sum0 = _mm_add_ps(sum0, _mm_mul_ps(sum1, _mm_set1_ps(x)));
+	*d = hsum_sse(sum0);
+}
@@ -0,0 +1,400 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <errno.h>
+
+#include <spa/defs.h>
+#include <spa/cpu.h>
+
+#include "resample.h"
+
+/* frames of input that are copied into the history at a time */
+#define BLOCK_SIZE	1024
+/* above this many phases the filter bank is made with INTER_PHASES phases
+ * and interpolated. Below it, the bank has a multiple of the phases of the
+ * exact ratio, at least INTER_PHASES, so that it can also be interpolated
+ * when the rate changes */
+#define MAX_PHASES	1024
+#define INTER_PHASES	256
+#define MAX_TAPS	2048
+
+struct quality {
+	uint32_t n_taps;
+	double cutoff;
+};
+
+static const struct quality window_qualities[] = {
+	{ 8, 0.53, },
+	{ 16, 0.67, },
+	{ 24, 0.75, },
+	{ 32, 0.80, },
+	{ 48, 0.85, },
+	{ 64, 0.88, },
+	{ 80, 0.895, },
+	{ 96, 0.910, },
+	{ 128, 0.930, },
+	{ 160, 0.940, },
+	{ 256, 0.950, },
+};
+
+struct native_data {
+	double rate;		/**< speed, 1.0 is the nominal ratio */
+	uint32_t in_rate;	/**< input rate divided by the gcd */
+	uint32_t out_rate;	/**< output rate divided by the gcd */
+	uint32_t n_taps;
+	uint32_t n_phases;
+	bool exact;		/**< phases advance exactly with in_rate */
+	uint32_t inc;		/**< input frames per output frame */
+	uint32_t frac;		/**< remaining phases per output frame */
+	uint32_t exact_step;	/**< phases per output frame, when exact */
+	double step;		/**< phases per output frame when interpolating */
+
+	uint32_t index;		/**< first history frame of the next output */
+	double phase;		/**< filter phase of the next output */
+	uint32_t hist_len;	/**< valid frames in the history */
+	uint32_t hist_size;
+
+	inner_product_func_t func;
+	inner_product_ip_func_t func_ip;
+
+	float *filter;		/**< n_phases + 1 phases of n_taps, aligned to 32 bytes */
+	float *history[RESAMPLE_MAX_CHANNELS];
+	void *mem;
+};
+
+static inline double sinc(double x)
+{
+	if (x < 1e-6 && x > -1e-6)
+		return 1.0;
+	x *= M_PI;
+	return sin(x) / x;
+}
+
+/* blackman-harris window for @x between -n_taps/2 and n_taps/2 */
+static inline double window(double x, uint32_t n_taps)
+{
+	double w = 2.0 * M_PI * (x / n_taps + 0.5);
+	return 0.35875 - 0.48829 * cos(w) + 0.14128 * cos(2.0 * w) - 0.01168 * cos(3.0 * w);
+}
+
+/* phase p of the bank is the filter for an output p/n_phases frames after
+ * the center tap, the extra last phase is used for interpolation */
+static void build_filter(float *filter, uint32_t n_taps, uint32_t n_phases, double cutoff)
+{
+	uint32_t i, p, center = n_taps / 2 - 1;
+
+	for (p = 0; p <= n_phases; p++) {
+		float *taps = &filter[p * n_taps];
+		double sum = 0.0;
+
+		for (i = 0; i < n_taps; i++) {
+			double t = (double) i - center - (double) p / n_phases;
+			taps[i] = cutoff * sinc(cutoff * t) * window(t, n_taps);
+			sum += taps[i];
+		}
+		/* unity gain for DC */
+		for (i = 0; i < n_taps; i++)
+			taps[i] /= sum;
+	}
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b != 0) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+void inner_product_c(float *d, const float *s, const float *taps, uint32_t n_taps)
+{
+	float sum = 0.0f;
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i++)
+		sum += s[i] * taps[i];
+	*d = sum;
+}
+
+void inner_product_ip_c(float *d, const float *s, const float *t0, const float *t1,
+			float x, uint32_t n_taps)
+{
+	float sum0 = 0.0f, sum1 = 0.0f;
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i++) {
+		sum0 += s[i] * t0[i];
+		sum1 += s[i] * t1[i];
+	}
+	*d = sum0 + (sum1 - sum0) * x;
+}
+
+uint32_t resample_get_cpu_flags(void)
+{
+	uint32_t cpu_flags = spa_cpu_get_flags(), flags = 0;
+
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		flags |= RESAMPLE_CPU_SSE;
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		flags |= RESAMPLE_CPU_AVX;
+	return flags;
+}
+
+void resample_update_rate(struct resample *r, double rate)
+{
+	struct native_data *d = r->data;
+
+	d->rate = rate;
+	d->step = (double) d->n_phases * r->i_rate / r->o_rate * rate;
+	d->exact = rate == 1.0 && d->n_phases % d->out_rate == 0;
+	if (d->exact) {
+		/* continue on the nearest exact phase */
+		d->phase = floor(d->phase);
+		if (d->phase >= d->n_phases)
+			d->phase = d->n_phases - 1;
+	}
+}
+
+void resample_reset(struct resample *r)
+{
+	struct native_data *d = r->data;
+	uint32_t c;
+
+	/* start with the center tap on the first input frame */
+	d->index = 0;
+	d->phase = 0.0;
+	d->hist_len = d->n_taps / 2 - 1;
+	for (c = 0; c < r->channels; c++)
+		memset(d->history[c], 0, d->hist_len * sizeof(float));
+}
+
+uint32_t resample_delay(struct resample *r)
+{
+	struct native_data *d = r->data;
+	return d->n_taps / 2;
+}
+
+int resample_init(struct resample *r)
+{
+	struct native_data *d;
+	const struct quality *q;
+	uint32_t c, g, n_taps, n_phases, in_rate, out_rate;
+	double cutoff;
+	size_t filter_size, history_size;
+
+	if (r->channels == 0 || r->channels > RESAMPLE_MAX_CHANNELS ||
+	    r->i_rate == 0 || r->o_rate == 0)
+		return -EINVAL;
+
+	r->quality = SPA_MIN(r->quality, RESAMPLE_MAX_QUALITY);
+	q = &window_qualities[r->quality];
+
+	g = gcd(r->i_rate, r->o_rate);
+	in_rate = r->i_rate / g;
+	out_rate = r->o_rate / g;
+
+	/* when downsampling, lower the cutoff below the new nyquist
+	 * frequency and make the filter longer to keep the same steepness */
+	cutoff = q->cutoff;
+	n_taps = q->n_taps;
+	if (r->i_rate > r->o_rate) {
+		cutoff = cutoff * r->o_rate / r->i_rate;
+		n_taps = ceil(n_taps * (double) r->i_rate / r->o_rate);
+	}
+	/* a multiple of 8 for the vector functions */
+	n_taps = SPA_MIN(SPA_ROUND_UP_N(n_taps, 8), MAX_TAPS);
+	if (out_rate <= MAX_PHASES)
+		n_phases = out_rate * ((INTER_PHASES + out_rate - 1) / out_rate);
+	else
+		n_phases = INTER_PHASES;
+
+	filter_size = (n_phases + 1) * n_taps * sizeof(float);
+	history_size = SPA_ROUND_UP_N((n_taps + BLOCK_SIZE) * sizeof(float), 32);
+
+	d = calloc(1, sizeof(struct native_data));
+	if (d == NULL)
+		return -ENOMEM;
+
+	d->mem = malloc(filter_size + history_size * r->channels + 32);
+	if (d->mem == NULL) {
+		free(d);
+		return -ENOMEM;
+	}
+
+	r->data = d;
+	d->in_rate = in_rate;
+	d->out_rate = out_rate;
+	d->n_taps = n_taps;
+	d->n_phases = n_phases;
+	d->inc = in_rate / out_rate;
+	d->frac = (in_rate % out_rate) * (n_phases / out_rate);
+	d->exact_step = in_rate * (n_phases / out_rate);
+	d->hist_size = n_taps + BLOCK_SIZE;
+
+	d->filter = (float *) SPA_ROUND_UP_N((uintptr_t) d->mem, 32);
+	for (c = 0; c < r->channels; c++)
+		d->history[c] = SPA_MEMBER(d->filter, filter_size + history_size * c, float);
+
+	build_filter(d->filter, n_taps, n_phases, cutoff);
+
+	d->func = inner_product_c;
+	d->func_ip = inner_product_ip_c;
+#if defined(HAVE_SSE)
+	if (r->cpu_flags & RESAMPLE_CPU_SSE) {
+		d->func = inner_product_sse;
+		d->func_ip = inner_product_ip_sse;
+	}
+#endif
+#if defined(HAVE_AVX)
+	if (r->cpu_flags & RESAMPLE_CPU_AVX) {
+		d->func = inner_product_avx;
+		d->func_ip = inner_product_ip_avx;
+	}
+#endif
+	resample_update_rate(r, 1.0);
+	resample_reset(r);
+
+	return 0;
+}
+
+void resample_free(struct resample *r)
+{
+	struct native_data *d = r->data;
+
+	if (d) {
+		free(d->mem);
+		free(d);
+		r->data = NULL;
+	}
+}
+
+/* the phases advance with a fixed number of phases for each output */
+static uint32_t
+process_exact(struct resample *r, struct native_data *d, void *dst[],
+	      uint32_t offset, uint32_t n_out)
+{
+	uint32_t c, o, index = d->index, phase = d->phase, n_taps = d->n_taps;
+
+	for (o = offset; o < n_out && index + n_taps <= d->hist_len; o++) {
+		const float *taps = &d->filter[phase * n_taps];
+
+		for (c = 0; c < r->channels; c++)
+			d->func(&((float *) dst[c])[o], &d->history[c][index], taps, n_taps);
+
+		index += d->inc;
+		phase += d->frac;
+		if (phase >= d->n_phases) {
+			phase -= d->n_phases;
+			index++;
+		}
+	}
+	d->index = index;
+	d->phase = phase;
+
+	return o - offset;
+}
+
+/* arbitrary steps, the filter is interpolated between the two nearest phases */
+static uint32_t
+process_inter(struct resample *r, struct native_data *d, void *dst[],
+	      uint32_t offset, uint32_t n_out)
+{
+	uint32_t c, o, index = d->index, n_taps = d->n_taps;
+	double phase = d->phase;
+
+	for (o = offset; o < n_out && index + n_taps <= d->hist_len; o++) {
+		uint32_t p = (uint32_t) phase;
+		float x = phase - p;
+		const float *t0 = &d->filter[p * n_taps];
+
+		for (c = 0; c < r->channels; c++)
+			d->func_ip(&((float *) dst[c])[o], &d->history[c][index],
+				   t0, t0 + n_taps, x, n_taps);
+
+		phase += d->step;
+		if (phase >= d->n_phases) {
+			uint32_t n = phase / d->n_phases;
+			index += n;
+			phase -= (double) n * d->n_phases;
+		}
+	}
+	d->index = index;
+	d->phase = phase;
+
+	return o - offset;
+}
+
+void resample_process(struct resample *r, const void *src[], uint32_t *in_len,
+		      void *dst[], uint32_t *out_len)
+{
+	struct native_data *d = r->data;
+	uint32_t c, n, in = 0, out = 0, n_in = *in_len, n_out = *out_len;
+
+	while (true) {
+		n = SPA_MIN(n_in - in, d->hist_size - d->hist_len);
+		if (n > 0) {
+			for (c = 0; c < r->channels; c++)
+				memcpy(&d->history[c][d->hist_len],
+				       SPA_MEMBER(src[c], in * sizeof(float), void),
+				       n * sizeof(float));
+			d->hist_len += n;
+			in += n;
+		}
+
+		if (d->exact)
+			out += process_exact(r, d, dst, out, n_out);
+		else
+			out += process_inter(r, d, dst, out, n_out);
+
+		/* keep the frames that are still needed at the start */
+		if (d->index >= d->hist_len) {
+			d->index -= d->hist_len;
+			d->hist_len = 0;
+		} else if (d->index > 0) {
+			n = d->hist_len - d->index;
+			for (c = 0; c < r->channels; c++)
+				memmove(d->history[c], &d->history[c][d->index], n * sizeof(float));
+			d->hist_len = n;
+			d->index = 0;
+		}
+		if (in == n_in || out == n_out)
+			break;
+	}
+	*in_len = in;
+	*out_len = out;
+}
+
+uint32_t resample_out_len(struct resample *r, uint32_t in_len)
+{
+	struct native_data *d = r->data;
+	uint64_t avail = (uint64_t) d->hist_len + in_len;
+	double step = d->exact ? d->exact_step : d->step;
+
+	/* an output can be made while its first frame is before this position */
+	if (avail + 1 <= (uint64_t) d->index + d->n_taps)
+		return 0;
+
+	return ceil(((avail + 1 - d->index - d->n_taps) * (double) d->n_phases - d->phase) / step);
+}
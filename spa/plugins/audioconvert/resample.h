@@ -0,0 +1,95 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __SPA_RESAMPLE_H__
+#define __SPA_RESAMPLE_H__
+
+#include <spa/defs.h>
+
+#define RESAMPLE_MAX_CHANNELS	64
+
+#define RESAMPLE_DEFAULT_QUALITY	4
+#define RESAMPLE_MAX_QUALITY		10
+
+#define RESAMPLE_CPU_SSE	(1 << 0)
+#define RESAMPLE_CPU_AVX	(1 << 1)
+
+/* a windowed-sinc polyphase resampler for planar F32 samples */
+struct resample {
+	uint32_t cpu_flags;
+	uint32_t quality;	/**< 0 to RESAMPLE_MAX_QUALITY */
+	uint32_t channels;
+	uint32_t i_rate;
+	uint32_t o_rate;
+
+	void *data;
+};
+
+/* dot product of @n_taps samples from @s with the filter @taps */
+typedef void (*inner_product_func_t) (float *d, const float *s,
+				      const float *taps, uint32_t n_taps);
+/* dot product of @s with the filter phases @t0 and @t1, interpolated with @x */
+typedef void (*inner_product_ip_func_t) (float *d, const float *s,
+					 const float *t0, const float *t1, float x,
+					 uint32_t n_taps);
+
+uint32_t resample_get_cpu_flags(void);
+
+/* set up @r for the configured rates, channels and quality. The filter
+ * bank is calculated here so that processing does no allocations */
+int resample_init(struct resample *r);
+void resample_free(struct resample *r);
+
+/* change the speed of the resampler. @rate multiplies the ratio of the
+ * rates, values slightly off 1.0 are used to compensate for clock drift.
+ * Can be called between every process call */
+void resample_update_rate(struct resample *r, double rate);
+
+/* drop the history */
+void resample_reset(struct resample *r);
+
+/* resample @in_len frames from @src into @dst that has room for @out_len frames.
+ * On return @in_len and @out_len contain the consumed and produced frames */
+void resample_process(struct resample *r, const void *src[], uint32_t *in_len,
+		      void *dst[], uint32_t *out_len);
+
+/* the number of output frames that can be made from @in_len input frames,
+ * including the frames in the history */
+uint32_t resample_out_len(struct resample *r, uint32_t in_len);
+
+/* the delay of the filter in input frames */
+uint32_t resample_delay(struct resample *r);
+
+void inner_product_c(float *d, const float *s, const float *taps, uint32_t n_taps);
+void inner_product_ip_c(float *d, const float *s, const float *t0, const float *t1,
+			float x, uint32_t n_taps);
+
+#if defined(HAVE_SSE)
+void inner_product_sse(float *d, const float *s, const float *taps, uint32_t n_taps);
+void inner_product_ip_sse(float *d, const float *s, const float *t0, const float *t1,
+			  float x, uint32_t n_taps);
+#endif
+#if defined(HAVE_AVX)
+void inner_product_avx(float *d, const float *s, const float *taps, uint32_t n_taps);
+void inner_product_ip_avx(float *d, const float *s, const float *t0, const float *t1,
+			  float x, uint32_t n_taps);
+#endif
+
+#endif /* __SPA_RESAMPLE_H__ */
@@ -36,6 +36,9 @@
 #define MAX_BUFFERS     64
 #define MAX_PORTS       128
 
+#define DEFAULT_VOLUME	1.0
+#define DEFAULT_MUTE	false
+
 struct buffer {
 	struct spa_buffer *outbuf;
 	bool outstanding;
@@ -50,6 +53,9 @@ struct port {
 
 	struct spa_port_info info;
 
+	double volume;
+	bool mute;
+
 	bool have_format;
 
 	struct buffer buffers[MAX_BUFFERS];
@@ -63,6 +69,9 @@ struct port {
 struct type {
 	uint32_t node;
 	uint32_t format;
+	uint32_t props;
+	uint32_t prop_volume;
+	uint32_t prop_mute;
 	struct spa_type_media_type media_type;
 	struct spa_type_media_subtype media_subtype;
 	struct spa_type_format_audio format_audio;
@@ -76,6 +85,9 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 {
 	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
 	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
+	type->prop_mute = spa_type_map_get_id(map, SPA_TYPE_PROPS__mute);
 	spa_type_media_type_map(map, &type->media_type);
 	spa_type_media_subtype_map(map, &type->media_subtype);
 	spa_type_format_audio_map(map, &type->format_audio);
@@ -108,8 +120,10 @@ struct impl {
 	int n_formats;
 	struct spa_audio_info format;
 
+	mix_n_func_t mix;
 	mix_func_t copy;
 	mix_func_t add;
+	uint32_t n_planes;
 
 	bool started;
 };
@@ -246,6 +260,8 @@ static int impl_node_add_port(struct spa_node *node, enum spa_direction directio
 
 	port = GET_IN_PORT (this, port_id);
 	port->valid = true;
+	port->volume = DEFAULT_VOLUME;
+	port->mute = DEFAULT_MUTE;
 	spa_list_init(&port->queue);
 	port->info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
 			   SPA_PORT_INFO_FLAG_REMOVABLE |
@@ -308,7 +324,7 @@ impl_node_port_enum_formats(struct spa_node *node,
 	struct impl *this;
 	int res;
 	struct spa_format *fmt;
-	uint8_t buffer[256];
+	uint8_t buffer[1024];
 	struct spa_pod_builder b = { NULL, };
 	struct spa_pod_frame f[2];
 	uint32_t count, match;
@@ -330,10 +346,17 @@ impl_node_port_enum_formats(struct spa_node *node,
 		spa_pod_builder_format(&b, &f[0], this->type.format,
 			this->type.media_type.audio,
 			this->type.media_subtype.raw,
-			PROP_U_EN(&f[1], this->type.format_audio.format, SPA_POD_TYPE_ID, 3,
+			PROP_U_EN(&f[1], this->type.format_audio.format, SPA_POD_TYPE_ID, 6,
 				this->type.audio_format.S16,
 				this->type.audio_format.S16,
-				this->type.audio_format.F32),
+				this->type.audio_format.F32,
+				this->type.audio_format.S24_32,
+				this->type.audio_format.S32,
+				this->type.audio_format.F64),
+			PROP_U_EN(&f[1], this->type.format_audio.layout, SPA_POD_TYPE_INT, 3,
+				SPA_AUDIO_LAYOUT_INTERLEAVED,
+				SPA_AUDIO_LAYOUT_INTERLEAVED,
+				SPA_AUDIO_LAYOUT_NON_INTERLEAVED),
 			PROP_U_MM(&f[1], this->type.format_audio.rate, SPA_POD_TYPE_INT,
 				44100,
 				1, INT32_MAX),
@@ -366,6 +389,21 @@ static int clear_buffers(struct impl *this, struct port *port)
 	return SPA_RESULT_OK;
 }
 
+static int find_conv(struct impl *this, uint32_t format)
+{
+	if (format == this->type.audio_format.S16)
+		return CONV_S16_S16;
+	else if (format == this->type.audio_format.F32)
+		return CONV_F32_F32;
+	else if (format == this->type.audio_format.S24_32)
+		return CONV_S24_32_S24_32;
+	else if (format == this->type.audio_format.S32)
+		return CONV_S32_S32;
+	else if (format == this->type.audio_format.F64)
+		return CONV_F64_F64;
+	return -1;
+}
+
 static int
 impl_node_port_set_format(struct spa_node *node,
 			  enum spa_direction direction,
@@ -395,6 +433,7 @@ impl_node_port_set_format(struct spa_node *node,
 		struct spa_audio_info info = { SPA_FORMAT_MEDIA_TYPE(format),
 			SPA_FORMAT_MEDIA_SUBTYPE(format),
 		};
+		int conv;
 
 		if (info.media_type != this->type.media_type.audio ||
 		    info.media_subtype != this->type.media_subtype.raw)
@@ -403,20 +442,21 @@ impl_node_port_set_format(struct spa_node *node,
 		if (!spa_format_audio_raw_parse(format, &info.info.raw, &this->type.format_audio))
 			return SPA_RESULT_INVALID_MEDIA_TYPE;
 
+		if ((conv = find_conv(this, info.info.raw.format)) < 0)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
 		if (this->have_format) {
 			if (memcmp(&info, &this->format, sizeof(struct spa_audio_info)))
 				return SPA_RESULT_INVALID_MEDIA_TYPE;
 		} else {
 			this->have_format = true;
 			this->format = info;
-			if (info.info.raw.format == this->type.audio_format.S16) {
-				this->copy = this->ops.copy[CONV_S16_S16];
-				this->add = this->ops.add[CONV_S16_S16];
-			}
-			else if (info.info.raw.format == this->type.audio_format.F32) {
-				this->copy = this->ops.copy[CONV_F32_F32];
-				this->add = this->ops.add[CONV_F32_F32];
-			}
+			this->mix = this->ops.mix_n[conv];
+			this->copy = this->ops.copy[conv];
+			this->add = this->ops.add[conv];
+			/* planar audio has a data block for each channel */
+			this->n_planes = info.info.raw.layout == SPA_AUDIO_LAYOUT_NON_INTERLEAVED ?
+				info.info.raw.channels : 1;
 		}
 		if (!port->have_format) {
 			this->n_formats++;
@@ -457,6 +497,8 @@ impl_node_port_get_format(struct spa_node *node,
 		this->type.media_subtype.raw,
 		PROP(&f[1], this->type.format_audio.format, SPA_POD_TYPE_ID,
 			this->format.info.raw.format),
+		PROP(&f[1], this->type.format_audio.layout, SPA_POD_TYPE_INT,
+			this->format.info.raw.layout),
 		PROP(&f[1], this->type.format_audio.rate, SPA_POD_TYPE_INT,
 			this->format.info.raw.rate),
 		PROP(&f[1], this->type.format_audio.channels, SPA_POD_TYPE_INT,
@@ -504,7 +546,30 @@ impl_node_port_set_param(struct spa_node *node,
 			 uint32_t port_id,
 			 const struct spa_param *param)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(param != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_IN_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_IN_PORT(this, port_id);
+
+	/* the gain of an input is set with a props object */
+	if (!spa_pod_is_object_type((struct spa_pod *) &param->object.pod, this->type.props))
+		return SPA_RESULT_NOT_IMPLEMENTED;
+
+	spa_props_query((const struct spa_props *) param,
+			this->type.prop_volume, SPA_POD_TYPE_DOUBLE, &port->volume,
+			this->type.prop_mute, SPA_POD_TYPE_BOOL, &port->mute, 0);
+
+	spa_log_info(this->log, NAME " %p: port %d volume %f mute %d", this, port_id,
+		     port->volume, port->mute);
+
+	return SPA_RESULT_OK;
 }
 
 static int
@@ -533,19 +598,27 @@ impl_node_port_use_buffers(struct spa_node *node,
 	for (i = 0; i < n_buffers; i++) {
 		struct buffer *b;
 		struct spa_data *d = buffers[i]->datas;
+		uint32_t j;
 
 		b = &port->buffers[i];
 		b->outbuf = buffers[i];
 		b->outstanding = direction == SPA_DIRECTION_INPUT ? true : false;
 		b->h = spa_buffer_find_meta(buffers[i], this->type.meta.Header);
 
-		if (!((d[0].type == this->type.data.MemPtr ||
-		       d[0].type == this->type.data.MemFd ||
-		       d[0].type == this->type.data.DmaBuf) && d[0].data != NULL)) {
-			spa_log_error(this->log, NAME " %p: invalid memory on buffer %p", this,
-				      buffers[i]);
+		if (buffers[i]->n_datas < this->n_planes) {
+			spa_log_error(this->log, NAME " %p: buffer %p has %d of %d planes", this,
+				      buffers[i], buffers[i]->n_datas, this->n_planes);
 			return SPA_RESULT_ERROR;
 		}
+		for (j = 0; j < this->n_planes; j++) {
+			if (!((d[j].type == this->type.data.MemPtr ||
+			       d[j].type == this->type.data.MemFd ||
+			       d[j].type == this->type.data.DmaBuf) && d[j].data != NULL)) {
+				spa_log_error(this->log, NAME " %p: invalid memory on buffer %p", this,
+					      buffers[i]);
+				return SPA_RESULT_ERROR;
+			}
+		}
 		if (!b->outstanding)
 			spa_list_insert(port->queue.prev, &b->link);
 	}
@@ -628,48 +701,54 @@ impl_node_port_send_command(struct spa_node *node,
 }
 
 static inline void
-add_port_data(struct impl *this, void *out, size_t outsize, struct port *port, int layer)
+consume_port_data(struct impl *this, struct port *port, size_t n_bytes)
 {
-	void *in;
-	size_t insize;
-	struct buffer *b;
-	struct spa_data *id;
-
-	b = spa_list_first(&port->queue, struct buffer, link);
+	struct buffer *b = spa_list_first(&port->queue, struct buffer, link);
+	size_t insize = b->outbuf->datas[0].chunk->size - port->queued_offset;
 
-	id = b->outbuf->datas;
-	in = SPA_MEMBER(id[0].data, port->queued_offset + id[0].chunk->offset, void);
-	insize = id[0].chunk->size - port->queued_offset;
-	outsize = SPA_MIN(outsize, insize);
-
-	if (layer == 0)
-		this->copy(out, in, outsize);
-	else
-		this->add(out, in, outsize);
+	port->queued_offset += n_bytes;
+	port->queued_bytes -= n_bytes;
 
-	port->queued_offset += outsize;
-	port->queued_bytes -= outsize;
-
-	if (outsize == insize) {
+	if (n_bytes == insize) {
 		spa_log_trace(this->log, NAME " %p: return buffer %d on port %p %zd",
-			      this, b->outbuf->id, port, outsize);
+			      this, b->outbuf->id, port, n_bytes);
 		port->io->buffer_id = b->outbuf->id;
 		spa_list_remove(&b->link);
 		b->outstanding = true;
 		port->queued_offset = 0;
 	} else {
 		spa_log_trace(this->log, NAME " %p: keeping buffer %d on port %p %zd %zd",
-			      this, b->outbuf->id, port, port->queued_bytes, outsize);
+			      this, b->outbuf->id, port, port->queued_bytes, n_bytes);
 	}
 }
 
+/* one or two inputs at full volume give the same result with copy and add,
+ * which is faster than the float sum of mix_n */
+static inline void mix_plane(struct impl *this, void *dst, const void *src[],
+			     const float gain[], uint32_t n_src, int n_bytes)
+{
+	if (n_src == 0 || n_src > 2 || gain[0] != 1.0f ||
+	    (n_src == 2 && gain[1] != 1.0f)) {
+		this->mix(dst, src, gain, n_src, n_bytes);
+		return;
+	}
+	this->copy(dst, src[0], n_bytes);
+	if (n_src == 2)
+		this->add(dst, src[1], n_bytes);
+}
+
 static int mix_output(struct impl *this, size_t n_bytes)
 {
 	struct buffer *outbuf;
-	int i, layer;
-	struct port *outport;
+	int i;
+	struct port *outport, *ports[MAX_PORTS];
 	struct spa_port_io *outio;
 	struct spa_data *od;
+	struct port *srcs[MAX_PORTS];
+	struct spa_data *datas[MAX_PORTS];
+	const void *src[MAX_PORTS];
+	float gain[MAX_PORTS];
+	uint32_t j, p, n_ports = 0, n_src = 0;
 
 	outport = GET_OUT_PORT(this, 0);
 	outio = outport->io;
@@ -683,14 +762,12 @@ static int mix_output(struct impl *this, size_t n_bytes)
 
 	od = outbuf->outbuf->datas;
 	n_bytes = SPA_MIN(n_bytes, od[0].maxsize);
-	od[0].chunk->offset = 0;
-	od[0].chunk->size = n_bytes;
-	od[0].chunk->stride = 0;
 
-	spa_log_trace(this->log, NAME " %p: dequeue output buffer %d %zd",
-		      this, outbuf->outbuf->id, n_bytes);
-	for (layer = 0, i = 0; i < this->last_port; i++) {
+	/* collect the data of all inputs first */
+	for (i = 0; i < this->last_port; i++) {
 		struct port *in_port = GET_IN_PORT(this, i);
+		struct buffer *b;
+		struct spa_data *id;
 
 		if (in_port->io == NULL || in_port->n_buffers == 0)
 			continue;
@@ -701,8 +778,39 @@ static int mix_output(struct impl *this, size_t n_bytes)
 			in_port->queued_offset = 0;
 			continue;
 		}
-		add_port_data(this, od[0].data, n_bytes, in_port, layer++);
+		b = spa_list_first(&in_port->queue, struct buffer, link);
+		id = b->outbuf->datas;
+		n_bytes = SPA_MIN(n_bytes, id[0].chunk->size - in_port->queued_offset);
+
+		ports[n_ports++] = in_port;
+
+		if (in_port->mute || in_port->volume <= 0.0)
+			continue;
+
+		srcs[n_src] = in_port;
+		datas[n_src] = id;
+		gain[n_src++] = in_port->volume;
+	}
+
+	spa_log_trace(this->log, NAME " %p: mix %d of %d inputs in output buffer %d %zd",
+		      this, n_src, n_ports, outbuf->outbuf->id, n_bytes);
+
+	/* and sum them in one pass over each plane of the output */
+	for (p = 0; p < this->n_planes; p++) {
+		for (j = 0; j < n_src; j++)
+			src[j] = SPA_MEMBER(datas[j][p].data,
+					    srcs[j]->queued_offset + datas[j][p].chunk->offset, void);
+
+		od[p].chunk->offset = 0;
+		od[p].chunk->size = n_bytes;
+		od[p].chunk->stride = 0;
+
+		mix_plane(this, od[p].data, src, gain, n_src, n_bytes);
 	}
+
+	for (j = 0; j < n_ports; j++)
+		consume_port_data(this, ports[j], n_bytes);
+
 	outio->buffer_id = outbuf->outbuf->id;
 	outio->status = SPA_RESULT_HAVE_BUFFER;
 
@@ -0,0 +1,79 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <immintrin.h>
+
+#include "conv.h"
+
+#define ALIGN	32
+#define N_S16	16
+#define N_S32	8
+#define N_F32	8
+#define N_F64	4
+#define BLOCK	32
+
+#define FUNC(name)	name##_avx2
+
+typedef __m256i vec_i;
+typedef __m256 vec_f;
+typedef __m256d vec_d;
+
+#define V_LOAD_I(p)		_mm256_load_si256((const __m256i *) (p))
+#define V_LOADU_I(p)		_mm256_loadu_si256((const __m256i *) (p))
+#define V_STORE_I(p,v)		_mm256_store_si256((__m256i *) (p), v)
+#define V_SET1_S16(v)		_mm256_set1_epi16(v)
+#define V_ADDS_S16(a,b)		_mm256_adds_epi16(a, b)
+#define V_MULHI_S16(a,b)	_mm256_mulhi_epi16(a, b)
+#define V_UNPACKLO_S16(a,b)	_mm256_unpacklo_epi16(a, b)
+#define V_UNPACKHI_S16(a,b)	_mm256_unpackhi_epi16(a, b)
+#define V_SRAI_S32(a,n)		_mm256_srai_epi32(a, n)
+#define V_SET1_S32(v)		_mm256_set1_epi32(v)
+#define V_ADD_S32(a,b)		_mm256_add_epi32(a, b)
+#define V_CMPGT_S32(a,b)	_mm256_cmpgt_epi32(a, b)
+#define V_AND_I(a,b)		_mm256_and_si256(a, b)
+#define V_ANDNOT_I(a,b)		_mm256_andnot_si256(a, b)
+#define V_OR_I(a,b)		_mm256_or_si256(a, b)
+#define V_XOR_I(a,b)		_mm256_xor_si256(a, b)
+#define V_PACKS_S32(a,b)	_mm256_packs_epi32(a, b)
+#define V_LOAD_F(p)		_mm256_load_ps(p)
+#define V_LOADU_F(p)		_mm256_loadu_ps(p)
+#define V_STORE_F(p,v)		_mm256_store_ps(p, v)
+#define V_ZERO_F()		_mm256_setzero_ps()
+#define V_SET1_F(v)		_mm256_set1_ps(v)
+#define V_ADD_F(a,b)		_mm256_add_ps(a, b)
+#define V_MUL_F(a,b)		_mm256_mul_ps(a, b)
+#define V_MIN_F(a,b)		_mm256_min_ps(a, b)
+#define V_MAX_F(a,b)		_mm256_max_ps(a, b)
+#define V_CVT_S32_F(a)		_mm256_cvtepi32_ps(a)
+#define V_CVTT_F_S32(a)		_mm256_cvttps_epi32(a)
+#define V_LOAD_D(p)		_mm256_load_pd(p)
+#define V_LOADU_D(p)		_mm256_loadu_pd(p)
+#define V_STORE_D(p,v)		_mm256_store_pd(p, v)
+#define V_ZERO_D()		_mm256_setzero_pd()
+#define V_SET1_D(v)		_mm256_set1_pd(v)
+#define V_ADD_D(a,b)		_mm256_add_pd(a, b)
+#define V_MUL_D(a,b)		_mm256_mul_pd(a, b)
+#define V_MIN_D(a,b)		_mm256_min_pd(a, b)
+#define V_MAX_D(a,b)		_mm256_max_pd(a, b)
+#define V_CVTLO_S32_D(a)	_mm256_cvtepi32_pd(_mm256_castsi256_si128(a))
+#define V_CVTHI_S32_D(a)	_mm256_cvtepi32_pd(_mm256_extracti128_si256(a, 1))
+#define V_CVTT_D_S32(lo,hi)	_mm256_inserti128_si256(_mm256_castsi128_si256(		\
+					_mm256_cvttpd_epi32(lo)), _mm256_cvttpd_epi32(hi), 1)
+
+#include "conv-simd.h"
@@ -0,0 +1,610 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* The mixing kernels for one vector width. The including file selects the
+ * instruction set and defines:
+ *
+ *  ALIGN, BLOCK	the alignment of the vector stores and the samples per block
+ *  N_S16, N_S32,
+ *  N_F32, N_F64	the number of samples in a vector
+ *  vec_i, vec_f,
+ *  vec_d		the integer, float and double vector types
+ *  V_*		the vector operations
+ *  FUNC(name)		the name of a function for this instruction set
+ *
+ * The vector loops work on blocks of BLOCK samples with the destination
+ * aligned to ALIGN bytes. The unaligned head and the tail are done by the
+ * plain C functions so that the result is the same. */
+
+static inline int head_samples(const void *d, int size, int n_samples)
+{
+	int n;
+
+	if (!SPA_IS_ALIGNED(d, size))
+		return n_samples;
+	n = ((ALIGN - ((uintptr_t) d & (ALIGN - 1))) & (ALIGN - 1)) / size;
+	return SPA_MIN(n, n_samples);
+}
+
+static inline vec_i load_i(const void *p, bool aligned)
+{
+	return aligned ? V_LOAD_I(p) : V_LOADU_I(p);
+}
+
+static inline vec_f load_f(const float *p, bool aligned)
+{
+	return aligned ? V_LOAD_F(p) : V_LOADU_F(p);
+}
+
+static inline void
+add_s16_blocks(int16_t *d, const int16_t *s, int n, bool aligned)
+{
+	int i, j;
+
+	for (i = 0; i < n; i += BLOCK) {
+		for (j = 0; j < BLOCK; j += N_S16)
+			V_STORE_I(&d[i + j], V_ADDS_S16(V_LOAD_I(&d[i + j]),
+							 load_i(&s[i + j], aligned)));
+	}
+}
+
+static void
+FUNC(add_s16_s16)(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n = n_bytes / sizeof(int16_t), head, blocks;
+
+	head = head_samples(d, sizeof(int16_t), n);
+	add_s16_s16_c(d, s, head * sizeof(int16_t));
+	d += head, s += head, n -= head;
+
+	blocks = n & ~(BLOCK - 1);
+	if (SPA_IS_ALIGNED(s, ALIGN))
+		add_s16_blocks(d, s, blocks, true);
+	else
+		add_s16_blocks(d, s, blocks, false);
+
+	add_s16_s16_c(d + blocks, s + blocks, (n - blocks) * sizeof(int16_t));
+}
+
+static inline void
+add_f32_blocks(float *d, const float *s, int n, bool aligned)
+{
+	int i, j;
+
+	for (i = 0; i < n; i += BLOCK) {
+		for (j = 0; j < BLOCK; j += N_F32)
+			V_STORE_F(&d[i + j], V_ADD_F(V_LOAD_F(&d[i + j]),
+						      load_f(&s[i + j], aligned)));
+	}
+}
+
+static void
+FUNC(add_f32_f32)(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n = n_bytes / sizeof(float), head, blocks;
+
+	head = head_samples(d, sizeof(float), n);
+	add_f32_f32_c(d, s, head * sizeof(float));
+	d += head, s += head, n -= head;
+
+	blocks = n & ~(BLOCK - 1);
+	if (SPA_IS_ALIGNED(s, ALIGN))
+		add_f32_blocks(d, s, blocks, true);
+	else
+		add_f32_blocks(d, s, blocks, false);
+
+	add_f32_f32_c(d + blocks, s + blocks, (n - blocks) * sizeof(float));
+}
+
+/* (s * v) >> 16 is exactly the high half of the 16x16 bit product and
+ * always fits in 16 bits */
+static inline void
+scale_s16_blocks(int16_t *d, const int16_t *s, int16_t scale, int n, bool add, bool aligned)
+{
+	int i, j;
+	vec_i v = V_SET1_S16(scale), t;
+
+	for (i = 0; i < n; i += BLOCK) {
+		for (j = 0; j < BLOCK; j += N_S16) {
+			t = V_MULHI_S16(load_i(&s[i + j], aligned), v);
+			if (add)
+				t = V_ADDS_S16(V_LOAD_I(&d[i + j]), t);
+			V_STORE_I(&d[i + j], t);
+		}
+	}
+}
+
+static inline void
+scale_s16(void *dst, const void *src, const void *scale, int n_bytes, bool add)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n = n_bytes / sizeof(int16_t), head, blocks;
+	int16_t v = *(int16_t *) scale;
+
+	head = head_samples(d, sizeof(int16_t), n);
+	if (add)
+		add_scale_s16_s16_c(d, s, scale, head * sizeof(int16_t));
+	else
+		copy_scale_s16_s16_c(d, s, scale, head * sizeof(int16_t));
+	d += head, s += head, n -= head;
+
+	blocks = n & ~(BLOCK - 1);
+	if (SPA_IS_ALIGNED(s, ALIGN))
+		scale_s16_blocks(d, s, v, blocks, add, true);
+	else
+		scale_s16_blocks(d, s, v, blocks, add, false);
+
+	d += blocks, s += blocks, n -= blocks;
+	if (add)
+		add_scale_s16_s16_c(d, s, scale, n * sizeof(int16_t));
+	else
+		copy_scale_s16_s16_c(d, s, scale, n * sizeof(int16_t));
+}
+
+static void
+FUNC(copy_scale_s16_s16)(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	scale_s16(dst, src, scale, n_bytes, false);
+}
+
+static void
+FUNC(add_scale_s16_s16)(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	scale_s16(dst, src, scale, n_bytes, true);
+}
+
+static inline void
+scale_f32_blocks(float *d, const float *s, float scale, int n, bool add, bool aligned)
+{
+	int i, j;
+	vec_f v = V_SET1_F(scale), t;
+
+	for (i = 0; i < n; i += BLOCK) {
+		for (j = 0; j < BLOCK; j += N_F32) {
+			t = V_MUL_F(load_f(&s[i + j], aligned), v);
+			if (add)
+				t = V_ADD_F(V_LOAD_F(&d[i + j]), t);
+			V_STORE_F(&d[i + j], t);
+		}
+	}
+}
+
+static inline void
+scale_f32(void *dst, const void *src, const void *scale, int n_bytes, bool add)
+{
+	const float *s = src;
+	float *d = dst;
+	int n = n_bytes / sizeof(float), head, blocks;
+	float v = *(float *) scale;
+
+	head = head_samples(d, sizeof(float), n);
+	if (add)
+		add_scale_f32_f32_c(d, s, scale, head * sizeof(float));
+	else
+		copy_scale_f32_f32_c(d, s, scale, head * sizeof(float));
+	d += head, s += head, n -= head;
+
+	blocks = n & ~(BLOCK - 1);
+	if (SPA_IS_ALIGNED(s, ALIGN))
+		scale_f32_blocks(d, s, v, blocks, add, true);
+	else
+		scale_f32_blocks(d, s, v, blocks, add, false);
+
+	d += blocks, s += blocks, n -= blocks;
+	if (add)
+		add_scale_f32_f32_c(d, s, scale, n * sizeof(float));
+	else
+		copy_scale_f32_f32_c(d, s, scale, n * sizeof(float));
+}
+
+static void
+FUNC(copy_scale_f32_f32)(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	scale_f32(dst, src, scale, n_bytes, false);
+}
+
+static void
+FUNC(add_scale_f32_f32)(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	scale_f32(dst, src, scale, n_bytes, true);
+}
+
+/* mix_n accumulates in float like the plain C version, sample per sample
+ * in the same order, so that the result is the same. The samples are
+ * widened within each 128 bit lane and packed again the same way, so they
+ * come out in order with any vector width */
+static inline void
+mix_n_s16_samples(int16_t *d, const void *src[], const float gain[], uint32_t n_src, int i, int n)
+{
+	uint32_t j;
+	float acc;
+
+	for (n += i; i < n; i++) {
+		for (j = 0, acc = 0.0f; j < n_src; j++)
+			acc += ((const int16_t *) src[j])[i] * gain[j];
+		d[i] = SPA_CLAMP(acc, INT16_MIN, INT16_MAX);
+	}
+}
+
+static inline void
+mix_n_s16_blocks(int16_t *d, const void *src[], const float gain[], uint32_t n_src, int i, int n)
+{
+	vec_f acc[BLOCK / N_F32], g;
+	vec_f min = V_SET1_F(INT16_MIN), max = V_SET1_F(INT16_MAX);
+	vec_i t, lo, hi;
+	uint32_t j;
+	int k;
+
+	for (n += i; i < n; i += BLOCK) {
+		for (k = 0; k < BLOCK / N_F32; k++)
+			acc[k] = V_ZERO_F();
+
+		for (j = 0; j < n_src; j++) {
+			const int16_t *s = (const int16_t *) src[j] + i;
+
+			g = V_SET1_F(gain[j]);
+			for (k = 0; k < BLOCK / N_S16; k++) {
+				t = V_LOADU_I(&s[k * N_S16]);
+				lo = V_SRAI_S32(V_UNPACKLO_S16(t, t), 16);
+				hi = V_SRAI_S32(V_UNPACKHI_S16(t, t), 16);
+				acc[2 * k] = V_ADD_F(acc[2 * k], V_MUL_F(V_CVT_S32_F(lo), g));
+				acc[2 * k + 1] = V_ADD_F(acc[2 * k + 1], V_MUL_F(V_CVT_S32_F(hi), g));
+			}
+		}
+		for (k = 0; k < BLOCK / N_S16; k++) {
+			lo = V_CVTT_F_S32(V_MIN_F(V_MAX_F(acc[2 * k], min), max));
+			hi = V_CVTT_F_S32(V_MIN_F(V_MAX_F(acc[2 * k + 1], min), max));
+			V_STORE_I(&d[i + k * N_S16], V_PACKS_S32(lo, hi));
+		}
+	}
+}
+
+static void
+FUNC(mix_n_s16_s16)(void *dst, const void *src[], const float gain[], uint32_t n_src, int n_bytes)
+{
+	int16_t *d = dst;
+	int n = n_bytes / sizeof(int16_t), head, blocks;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_bytes);
+		return;
+	}
+	head = head_samples(d, sizeof(int16_t), n);
+	blocks = (n - head) & ~(BLOCK - 1);
+
+	mix_n_s16_samples(d, src, gain, n_src, 0, head);
+	mix_n_s16_blocks(d, src, gain, n_src, head, blocks);
+	mix_n_s16_samples(d, src, gain, n_src, head + blocks, n - head - blocks);
+}
+
+static inline void
+mix_n_f32_samples(float *d, const void *src[], const float gain[], uint32_t n_src, int i, int n)
+{
+	uint32_t j;
+	float acc;
+
+	for (n += i; i < n; i++) {
+		for (j = 0, acc = 0.0f; j < n_src; j++)
+			acc += ((const float *) src[j])[i] * gain[j];
+		d[i] = acc;
+	}
+}
+
+static inline void
+mix_n_f32_blocks(float *d, const void *src[], const float gain[], uint32_t n_src, int i, int n)
+{
+	vec_f acc[BLOCK / N_F32], g;
+	uint32_t j;
+	int k;
+
+	for (n += i; i < n; i += BLOCK) {
+		for (k = 0; k < BLOCK / N_F32; k++)
+			acc[k] = V_ZERO_F();
+
+		for (j = 0; j < n_src; j++) {
+			const float *s = (const float *) src[j] + i;
+
+			g = V_SET1_F(gain[j]);
+			for (k = 0; k < BLOCK / N_F32; k++)
+				acc[k] = V_ADD_F(acc[k], V_MUL_F(V_LOADU_F(&s[k * N_F32]), g));
+		}
+		for (k = 0; k < BLOCK / N_F32; k++)
+			V_STORE_F(&d[i + k * N_F32], acc[k]);
+	}
+}
+
+static void
+FUNC(mix_n_f32_f32)(void *dst, const void *src[], const float gain[], uint32_t n_src, int n_bytes)
+{
+	float *d = dst;
+	int n = n_bytes / sizeof(float), head, blocks;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_bytes);
+		return;
+	}
+	head = head_samples(d, sizeof(float), n);
+	blocks = (n - head) & ~(BLOCK - 1);
+
+	mix_n_f32_samples(d, src, gain, n_src, 0, head);
+	mix_n_f32_blocks(d, src, gain, n_src, head, blocks);
+	mix_n_f32_samples(d, src, gain, n_src, head + blocks, n - head - blocks);
+}
+
+/* the 32 bit sum wraps when it overflows, the sign of the result is then
+ * different from the sign of both inputs and the sum saturates to the side
+ * of the sign of @a */
+static inline vec_i adds_s32(vec_i a, vec_i b)
+{
+	vec_i t = V_ADD_S32(a, b);
+	vec_i o = V_SRAI_S32(V_AND_I(V_XOR_I(a, t), V_XOR_I(b, t)), 31);
+	vec_i sat = V_XOR_I(V_SRAI_S32(a, 31), V_SET1_S32(INT32_MAX));
+
+	return V_OR_I(V_ANDNOT_I(o, t), V_AND_I(o, sat));
+}
+
+static inline vec_i clamp_s32(vec_i v, vec_i min, vec_i max)
+{
+	vec_i m;
+
+	m = V_CMPGT_S32(v, max);
+	v = V_OR_I(V_ANDNOT_I(m, v), V_AND_I(m, max));
+	m = V_CMPGT_S32(min, v);
+	return V_OR_I(V_ANDNOT_I(m, v), V_AND_I(m, min));
+}
+
+/* the saturated 32 bit sum clamps to the same value as the 64 bit sum of
+ * the plain C version */
+static inline void
+add_s32_blocks(int32_t *d, const int32_t *s, int n, int32_t min, int32_t max, bool aligned)
+{
+	vec_i vmin = V_SET1_S32(min), vmax = V_SET1_S32(max), t;
+	int i, j;
+
+	for (i = 0; i < n; i += BLOCK) {
+		for (j = 0; j < BLOCK; j += N_S32) {
+			t = adds_s32(V_LOAD_I(&d[i + j]), load_i(&s[i + j], aligned));
+			if (min != INT32_MIN || max != INT32_MAX)
+				t = clamp_s32(t, vmin, vmax);
+			V_STORE_I(&d[i + j], t);
+		}
+	}
+}
+
+static inline void
+add_s32(void *dst, const void *src, int n_bytes, int32_t min, int32_t max,
+	void (*add_c) (void *dst, const void *src, int n_bytes))
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int n = n_bytes / sizeof(int32_t), head, blocks;
+
+	head = head_samples(d, sizeof(int32_t), n);
+	add_c(d, s, head * sizeof(int32_t));
+	d += head, s += head, n -= head;
+
+	blocks = n & ~(BLOCK - 1);
+	if (SPA_IS_ALIGNED(s, ALIGN))
+		add_s32_blocks(d, s, blocks, min, max, true);
+	else
+		add_s32_blocks(d, s, blocks, min, max, false);
+
+	add_c(d + blocks, s + blocks, (n - blocks) * sizeof(int32_t));
+}
+
+static void
+FUNC(add_s24_32_s24_32)(void *dst, const void *src, int n_bytes)
+{
+	add_s32(dst, src, n_bytes, -8388608, 8388607, add_s24_32_s24_32_c);
+}
+
+static void
+FUNC(add_s32_s32)(void *dst, const void *src, int n_bytes)
+{
+	add_s32(dst, src, n_bytes, INT32_MIN, INT32_MAX, add_s32_s32_c);
+}
+
+static inline void
+add_f64_blocks(double *d, const double *s, int n, bool aligned)
+{
+	int i, j;
+
+	for (i = 0; i < n; i += BLOCK) {
+		for (j = 0; j < BLOCK; j += N_F64)
+			V_STORE_D(&d[i + j], V_ADD_D(V_LOAD_D(&d[i + j]),
+						      aligned ? V_LOAD_D(&s[i + j]) :
+								V_LOADU_D(&s[i + j])));
+	}
+}
+
+static void
+FUNC(add_f64_f64)(void *dst, const void *src, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+	int n = n_bytes / sizeof(double), head, blocks;
+
+	head = head_samples(d, sizeof(double), n);
+	add_f64_f64_c(d, s, head * sizeof(double));
+	d += head, s += head, n -= head;
+
+	blocks = n & ~(BLOCK - 1);
+	if (SPA_IS_ALIGNED(s, ALIGN))
+		add_f64_blocks(d, s, blocks, true);
+	else
+		add_f64_blocks(d, s, blocks, false);
+
+	add_f64_f64_c(d + blocks, s + blocks, (n - blocks) * sizeof(double));
+}
+
+/* the 32 bit formats are accumulated in double like the plain C version,
+ * converting the samples to double is exact */
+static inline void
+mix_n_s32_samples(int32_t *d, const void *src[], const float gain[], uint32_t n_src,
+		  int i, int n, double min, double max)
+{
+	uint32_t j;
+	double acc;
+
+	for (n += i; i < n; i++) {
+		for (j = 0, acc = 0.0; j < n_src; j++)
+			acc += ((const int32_t *) src[j])[i] * (double) gain[j];
+		d[i] = SPA_CLAMP(acc, min, max);
+	}
+}
+
+static inline void
+mix_n_s32_blocks(int32_t *d, const void *src[], const float gain[], uint32_t n_src,
+		 int i, int n, double min, double max)
+{
+	vec_d acc[BLOCK / N_F64], g, lo, hi;
+	vec_d vmin = V_SET1_D(min), vmax = V_SET1_D(max);
+	vec_i t;
+	uint32_t j;
+	int k;
+
+	for (n += i; i < n; i += BLOCK) {
+		for (k = 0; k < BLOCK / N_F64; k++)
+			acc[k] = V_ZERO_D();
+
+		for (j = 0; j < n_src; j++) {
+			const int32_t *s = (const int32_t *) src[j] + i;
+
+			g = V_SET1_D(gain[j]);
+			for (k = 0; k < BLOCK / N_S32; k++) {
+				t = V_LOADU_I(&s[k * N_S32]);
+				acc[2 * k] = V_ADD_D(acc[2 * k], V_MUL_D(V_CVTLO_S32_D(t), g));
+				acc[2 * k + 1] = V_ADD_D(acc[2 * k + 1], V_MUL_D(V_CVTHI_S32_D(t), g));
+			}
+		}
+		for (k = 0; k < BLOCK / N_S32; k++) {
+			lo = V_MIN_D(V_MAX_D(acc[2 * k], vmin), vmax);
+			hi = V_MIN_D(V_MAX_D(acc[2 * k + 1], vmin), vmax);
+			V_STORE_I(&d[i + k * N_S32], V_CVTT_D_S32(lo, hi));
+		}
+	}
+}
+
+static inline void
+mix_n_s32(void *dst, const void *src[], const float gain[], uint32_t n_src, int n_bytes,
+	  double min, double max)
+{
+	int32_t *d = dst;
+	int n = n_bytes / sizeof(int32_t), head, blocks;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_bytes);
+		return;
+	}
+	head = head_samples(d, sizeof(int32_t), n);
+	blocks = (n - head) & ~(BLOCK - 1);
+
+	mix_n_s32_samples(d, src, gain, n_src, 0, head, min, max);
+	mix_n_s32_blocks(d, src, gain, n_src, head, blocks, min, max);
+	mix_n_s32_samples(d, src, gain, n_src, head + blocks, n - head - blocks, min, max);
+}
+
+static void
+FUNC(mix_n_s24_32_s24_32)(void *dst, const void *src[], const float gain[], uint32_t n_src, int n_bytes)
+{
+	mix_n_s32(dst, src, gain, n_src, n_bytes, -8388608, 8388607);
+}
+
+static void
+FUNC(mix_n_s32_s32)(void *dst, const void *src[], const float gain[], uint32_t n_src, int n_bytes)
+{
+	mix_n_s32(dst, src, gain, n_src, n_bytes, INT32_MIN, INT32_MAX);
+}
+
+static inline void
+mix_n_f64_samples(double *d, const void *src[], const float gain[], uint32_t n_src, int i, int n)
+{
+	uint32_t j;
+	double acc;
+
+	for (n += i; i < n; i++) {
+		for (j = 0, acc = 0.0; j < n_src; j++)
+			acc += ((const double *) src[j])[i] * (double) gain[j];
+		d[i] = acc;
+	}
+}
+
+static inline void
+mix_n_f64_blocks(double *d, const void *src[], const float gain[], uint32_t n_src, int i, int n)
+{
+	vec_d acc[BLOCK / N_F64], g;
+	uint32_t j;
+	int k;
+
+	for (n += i; i < n; i += BLOCK) {
+		for (k = 0; k < BLOCK / N_F64; k++)
+			acc[k] = V_ZERO_D();
+
+		for (j = 0; j < n_src; j++) {
+			const double *s = (const double *) src[j] + i;
+
+			g = V_SET1_D(gain[j]);
+			for (k = 0; k < BLOCK / N_F64; k++)
+				acc[k] = V_ADD_D(acc[k], V_MUL_D(V_LOADU_D(&s[k * N_F64]), g));
+		}
+		for (k = 0; k < BLOCK / N_F64; k++)
+			V_STORE_D(&d[i + k * N_F64], acc[k]);
+	}
+}
+
+static void
+FUNC(mix_n_f64_f64)(void *dst, const void *src[], const float gain[], uint32_t n_src, int n_bytes)
+{
+	double *d = dst;
+	int n = n_bytes / sizeof(double), head, blocks;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_bytes);
+		return;
+	}
+	head = head_samples(d, sizeof(double), n);
+	blocks = (n - head) & ~(BLOCK - 1);
+
+	mix_n_f64_samples(d, src, gain, n_src, 0, head);
+	mix_n_f64_blocks(d, src, gain, n_src, head, blocks);
+	mix_n_f64_samples(d, src, gain, n_src, head + blocks, n - head - blocks);
+}
+
+void FUNC(spa_audiomixer_init_ops)(struct spa_audiomixer_ops *ops)
+{
+	ops->add[CONV_S16_S16] = FUNC(add_s16_s16);
+	ops->add[CONV_F32_F32] = FUNC(add_f32_f32);
+	ops->copy_scale[CONV_S16_S16] = FUNC(copy_scale_s16_s16);
+	ops->copy_scale[CONV_F32_F32] = FUNC(copy_scale_f32_f32);
+	ops->add_scale[CONV_S16_S16] = FUNC(add_scale_s16_s16);
+	ops->add_scale[CONV_F32_F32] = FUNC(add_scale_f32_f32);
+	ops->mix_n[CONV_S16_S16] = FUNC(mix_n_s16_s16);
+	ops->mix_n[CONV_F32_F32] = FUNC(mix_n_f32_f32);
+	ops->add[CONV_S24_32_S24_32] = FUNC(add_s24_32_s24_32);
+	ops->add[CONV_S32_S32] = FUNC(add_s32_s32);
+	ops->add[CONV_F64_F64] = FUNC(add_f64_f64);
+	ops->mix_n[CONV_S24_32_S24_32] = FUNC(mix_n_s24_32_s24_32);
+	ops->mix_n[CONV_S32_S32] = FUNC(mix_n_s32_s32);
+	ops->mix_n[CONV_F64_F64] = FUNC(mix_n_f64_f64);
+}
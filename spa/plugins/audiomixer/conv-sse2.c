@@ -0,0 +1,78 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <emmintrin.h>
+
+#include "conv.h"
+
+#define ALIGN	16
+#define N_S16	8
+#define N_S32	4
+#define N_F32	4
+#define N_F64	2
+#define BLOCK	16
+
+#define FUNC(name)	name##_sse2
+
+typedef __m128i vec_i;
+typedef __m128 vec_f;
+typedef __m128d vec_d;
+
+#define V_LOAD_I(p)		_mm_load_si128((const __m128i *) (p))
+#define V_LOADU_I(p)		_mm_loadu_si128((const __m128i *) (p))
+#define V_STORE_I(p,v)		_mm_store_si128((__m128i *) (p), v)
+#define V_SET1_S16(v)		_mm_set1_epi16(v)
+#define V_ADDS_S16(a,b)		_mm_adds_epi16(a, b)
+#define V_MULHI_S16(a,b)	_mm_mulhi_epi16(a, b)
+#define V_UNPACKLO_S16(a,b)	_mm_unpacklo_epi16(a, b)
+#define V_UNPACKHI_S16(a,b)	_mm_unpackhi_epi16(a, b)
+#define V_SRAI_S32(a,n)		_mm_srai_epi32(a, n)
+#define V_SET1_S32(v)		_mm_set1_epi32(v)
+#define V_ADD_S32(a,b)		_mm_add_epi32(a, b)
+#define V_CMPGT_S32(a,b)	_mm_cmpgt_epi32(a, b)
+#define V_AND_I(a,b)		_mm_and_si128(a, b)
+#define V_ANDNOT_I(a,b)		_mm_andnot_si128(a, b)
+#define V_OR_I(a,b)		_mm_or_si128(a, b)
+#define V_XOR_I(a,b)		_mm_xor_si128(a, b)
+#define V_PACKS_S32(a,b)	_mm_packs_epi32(a, b)
+#define V_LOAD_F(p)		_mm_load_ps(p)
+#define V_LOADU_F(p)		_mm_loadu_ps(p)
+#define V_STORE_F(p,v)		_mm_store_ps(p, v)
+#define V_ZERO_F()		_mm_setzero_ps()
+#define V_SET1_F(v)		_mm_set1_ps(v)
+#define V_ADD_F(a,b)		_mm_add_ps(a, b)
+#define V_MUL_F(a,b)		_mm_mul_ps(a, b)
+#define V_MIN_F(a,b)		_mm_min_ps(a, b)
+#define V_MAX_F(a,b)		_mm_max_ps(a, b)
+#define V_CVT_S32_F(a)		_mm_cvtepi32_ps(a)
+#define V_CVTT_F_S32(a)		_mm_cvttps_epi32(a)
+#define V_LOAD_D(p)		_mm_load_pd(p)
+#define V_LOADU_D(p)		_mm_loadu_pd(p)
+#define V_STORE_D(p,v)		_mm_store_pd(p, v)
+#define V_ZERO_D()		_mm_setzero_pd()
+#define V_SET1_D(v)		_mm_set1_pd(v)
+#define V_ADD_D(a,b)		_mm_add_pd(a, b)
+#define V_MUL_D(a,b)		_mm_mul_pd(a, b)
+#define V_MIN_D(a,b)		_mm_min_pd(a, b)
+#define V_MAX_D(a,b)		_mm_max_pd(a, b)
+#define V_CVTLO_S32_D(a)	_mm_cvtepi32_pd(a)
+#define V_CVTHI_S32_D(a)	_mm_cvtepi32_pd(_mm_srli_si128(a, 8))
+#define V_CVTT_D_S32(lo,hi)	_mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi))
+
+#include "conv-simd.h"
@@ -17,22 +17,24 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <spa/cpu.h>
+
 #include "conv.h"
 
-static void
-copy_s16_s16(void *dst, const void *src, int n_bytes)
+void
+copy_s16_s16_c(void *dst, const void *src, int n_bytes)
 {
 	memcpy(dst, src, n_bytes);
 }
 
-static void
-copy_f32_f32(void *dst, const void *src, int n_bytes)
+void
+copy_f32_f32_c(void *dst, const void *src, int n_bytes)
 {
 	memcpy(dst, src, n_bytes);
 }
 
-static void
-add_s16_s16(void *dst, const void *src, int n_bytes)
+void
+add_s16_s16_c(void *dst, const void *src, int n_bytes)
 {
 	const int16_t *s = src;
 	int16_t *d = dst;
@@ -47,8 +49,8 @@ add_s16_s16(void *dst, const void *src, int n_bytes)
 	}
 }
 
-static void
-add_f32_f32(void *dst, const void *src, int n_bytes)
+void
+add_f32_f32_c(void *dst, const void *src, int n_bytes)
 {
 	const float *s = src;
 	float *d = dst;
@@ -61,11 +63,11 @@ add_f32_f32(void *dst, const void *src, int n_bytes)
 	}
 }
 
-static void
-copy_scale_s16_s16(void *dst, const void *src, const void *scale, int n_bytes)
+void
+copy_scale_s16_s16_c(void *dst, const void *src, const void *scale, int n_bytes)
 {
 	const int16_t *s = src;
-	int16_t *d = dst;;
+	int16_t *d = dst;
 	int32_t v = *(int16_t*)scale, t;
 
 	n_bytes /= sizeof(int16_t);
@@ -77,8 +79,8 @@ copy_scale_s16_s16(void *dst, const void *src, const void *scale, int n_bytes)
 	}
 }
 
-static void
-copy_scale_f32_f32(void *dst, const void *src, const void *scale, int n_bytes)
+void
+copy_scale_f32_f32_c(void *dst, const void *src, const void *scale, int n_bytes)
 {
 	const float *s = src;
 	float *d = dst;
@@ -92,8 +94,8 @@ copy_scale_f32_f32(void *dst, const void *src, const void *scale, int n_bytes)
 	}
 }
 
-static void
-add_scale_s16_s16(void *dst, const void *src, const void *scale, int n_bytes)
+void
+add_scale_s16_s16_c(void *dst, const void *src, const void *scale, int n_bytes)
 {
 	const int16_t *s = src;
 	int16_t *d = dst;
@@ -108,8 +110,8 @@ add_scale_s16_s16(void *dst, const void *src, const void *scale, int n_bytes)
 	}
 }
 
-static void
-add_scale_f32_f32(void *dst, const void *src, const void *scale, int n_bytes)
+void
+add_scale_f32_f32_c(void *dst, const void *src, const void *scale, int n_bytes)
 {
 	const float *s = src;
 	float *d = dst;
@@ -243,22 +245,236 @@ add_scale_f32_f32_i(void *dst, int dst_stride, const void *src, int src_stride,
 	}
 }
 
+/* The sources are summed for a block of dst at a time, so that dst is
+ * written only once and the partial sums stay in the cache */
+#define MIX_BLOCK_BYTES	64
+
+static void
+mix_n_s16_s16(void *dst, const void *src[], const float gain[], uint32_t n_src, int n_bytes)
+{
+	int16_t *d = dst;
+	float acc[MIX_BLOCK_BYTES / sizeof(int16_t)];
+	int i, n, block, n_samples = n_bytes / sizeof(int16_t);
+	uint32_t j;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_bytes);
+		return;
+	}
+
+	for (n = 0; n < n_samples; n += block) {
+		block = SPA_MIN(n_samples - n, (int) SPA_N_ELEMENTS(acc));
+
+		for (i = 0; i < block; i++)
+			acc[i] = 0.0f;
+
+		for (j = 0; j < n_src; j++) {
+			const int16_t *s = (const int16_t *) src[j] + n;
+			float g = gain[j];
+
+			if (g == 1.0f) {
+				for (i = 0; i < block; i++)
+					acc[i] += s[i];
+			} else {
+				for (i = 0; i < block; i++)
+					acc[i] += s[i] * g;
+			}
+		}
+		for (i = 0; i < block; i++)
+			d[n + i] = SPA_CLAMP(acc[i], INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+mix_n_f32_f32(void *dst, const void *src[], const float gain[], uint32_t n_src, int n_bytes)
+{
+	float *d = dst;
+	float acc[MIX_BLOCK_BYTES / sizeof(float)];
+	int i, n, block, n_samples = n_bytes / sizeof(float);
+	uint32_t j;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_bytes);
+		return;
+	}
+
+	for (n = 0; n < n_samples; n += block) {
+		block = SPA_MIN(n_samples - n, (int) SPA_N_ELEMENTS(acc));
+
+		for (i = 0; i < block; i++)
+			acc[i] = 0.0f;
+
+		for (j = 0; j < n_src; j++) {
+			const float *s = (const float *) src[j] + n;
+			float g = gain[j];
+
+			if (g == 1.0f) {
+				for (i = 0; i < block; i++)
+					acc[i] += s[i];
+			} else {
+				for (i = 0; i < block; i++)
+					acc[i] += s[i] * g;
+			}
+		}
+		for (i = 0; i < block; i++)
+			d[n + i] = acc[i];
+	}
+}
+
+/* functions for the formats that are mixed in wider samples */
+#define CLAMP_S24_32(t)	SPA_CLAMP(t, -8388608, 8388607)
+#define CLAMP_S32(t)	SPA_CLAMP(t, INT32_MIN, INT32_MAX)
+#define CLAMP_F64(t)	(t)
+
+#define MAKE_OPS(fmt, type, acc_type, clamp)						\
+void											\
+copy_##fmt##_c(void *dst, const void *src, int n_bytes)				\
+{											\
+	memcpy(dst, src, n_bytes);							\
+}											\
+											\
+void											\
+add_##fmt##_c(void *dst, const void *src, int n_bytes)				\
+{											\
+	const type *s = src;								\
+	type *d = dst;									\
+	acc_type t;									\
+											\
+	n_bytes /= sizeof(type);							\
+	while (n_bytes--) {								\
+		t = (acc_type) *d + *s;							\
+		*d = clamp(t);								\
+		d++;									\
+		s++;									\
+	}										\
+}											\
+											\
+static void										\
+copy_##fmt##_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)	\
+{											\
+	const type *s = src;								\
+	type *d = dst;									\
+											\
+	n_bytes /= sizeof(type);							\
+	while (n_bytes--) {								\
+		*d = *s;								\
+		d += dst_stride;							\
+		s += src_stride;							\
+	}										\
+}											\
+											\
+static void										\
+add_##fmt##_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)	\
+{											\
+	const type *s = src;								\
+	type *d = dst;									\
+	acc_type t;									\
+											\
+	n_bytes /= sizeof(type);							\
+	while (n_bytes--) {								\
+		t = (acc_type) *d + *s;							\
+		*d = clamp(t);								\
+		d += dst_stride;							\
+		s += src_stride;							\
+	}										\
+}											\
+											\
+static void										\
+mix_n_##fmt(void *dst, const void *src[], const float gain[], uint32_t n_src, int n_bytes)\
+{											\
+	type *d = dst;									\
+	double acc[MIX_BLOCK_BYTES / sizeof(type)];					\
+	int i, n, block, n_samples = n_bytes / sizeof(type);				\
+	uint32_t j;									\
+											\
+	if (n_src == 0) {								\
+		memset(dst, 0, n_bytes);						\
+		return;									\
+	}										\
+	for (n = 0; n < n_samples; n += block) {					\
+		block = SPA_MIN(n_samples - n, (int) SPA_N_ELEMENTS(acc));		\
+											\
+		for (i = 0; i < block; i++)						\
+			acc[i] = 0.0;							\
+											\
+		for (j = 0; j < n_src; j++) {						\
+			const type *s = (const type *) src[j] + n;			\
+			double g = gain[j];						\
+											\
+			if (g == 1.0) {							\
+				for (i = 0; i < block; i++)				\
+					acc[i] += s[i];					\
+			} else {							\
+				for (i = 0; i < block; i++)				\
+					acc[i] += s[i] * g;				\
+			}								\
+		}									\
+		for (i = 0; i < block; i++)						\
+			d[n + i] = clamp(acc[i]);					\
+	}										\
+}
+
+MAKE_OPS(s24_32_s24_32, int32_t, int64_t, CLAMP_S24_32)
+MAKE_OPS(s32_s32, int32_t, int64_t, CLAMP_S32)
+MAKE_OPS(f64_f64, double, double, CLAMP_F64)
+
+#define INIT_OPS(ops, conv, fmt)			\
+	ops->copy[conv] = copy_##fmt##_c;		\
+	ops->add[conv] = add_##fmt##_c;			\
+	ops->copy_i[conv] = copy_##fmt##_i;		\
+	ops->add_i[conv] = add_##fmt##_i;		\
+	ops->mix_n[conv] = mix_n_##fmt;
+
+uint32_t spa_audiomixer_get_cpu_flags(void)
+{
+	uint32_t cpu_flags = spa_cpu_get_flags(), flags = 0;
+
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		flags |= SPA_AUDIOMIXER_CPU_SSE2;
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		flags |= SPA_AUDIOMIXER_CPU_AVX2;
+	return flags;
+}
+
+void spa_audiomixer_init_ops(struct spa_audiomixer_ops *ops, uint32_t cpu_flags)
+{
+	memset(ops, 0, sizeof(*ops));
+
+	ops->copy[CONV_S16_S16] = copy_s16_s16_c;
+	ops->copy[CONV_F32_F32] = copy_f32_f32_c;
+	ops->add[CONV_S16_S16] = add_s16_s16_c;
+	ops->add[CONV_F32_F32] = add_f32_f32_c;
+	ops->copy_scale[CONV_S16_S16] = copy_scale_s16_s16_c;
+	ops->copy_scale[CONV_F32_F32] = copy_scale_f32_f32_c;
+	ops->add_scale[CONV_S16_S16] = add_scale_s16_s16_c;
+	ops->add_scale[CONV_F32_F32] = add_scale_f32_f32_c;
+	ops->copy_i[CONV_S16_S16] = copy_s16_s16_i;
+	ops->copy_i[CONV_F32_F32] = copy_f32_f32_i;
+	ops->add_i[CONV_S16_S16] = add_s16_s16_i;
+	ops->add_i[CONV_F32_F32] = add_f32_f32_i;
+	ops->copy_scale_i[CONV_S16_S16] = copy_scale_s16_s16_i;
+	ops->copy_scale_i[CONV_F32_F32] = copy_scale_f32_f32_i;
+	ops->add_scale_i[CONV_S16_S16] = add_scale_s16_s16_i;
+	ops->add_scale_i[CONV_F32_F32] = add_scale_f32_f32_i;
+	ops->mix_n[CONV_S16_S16] = mix_n_s16_s16;
+	ops->mix_n[CONV_F32_F32] = mix_n_f32_f32;
+
+	INIT_OPS(ops, CONV_S24_32_S24_32, s24_32_s24_32);
+	INIT_OPS(ops, CONV_S32_S32, s32_s32);
+	INIT_OPS(ops, CONV_F64_F64, f64_f64);
+
+	/* the vector versions replace the plain C versions they implement */
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_AUDIOMIXER_CPU_SSE2)
+		spa_audiomixer_init_ops_sse2(ops);
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_AUDIOMIXER_CPU_AVX2)
+		spa_audiomixer_init_ops_avx2(ops);
+#endif
+}
+
 void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops)
 {
-	ops->copy[CONV_S16_S16] = copy_s16_s16;
-	ops->copy[CONV_F32_F32] = copy_f32_f32;
-        ops->add[CONV_S16_S16] = add_s16_s16;
-        ops->add[CONV_F32_F32] = add_f32_f32;
-        ops->copy_scale[CONV_S16_S16] = copy_scale_s16_s16;
-        ops->copy_scale[CONV_F32_F32] = copy_scale_f32_f32;
-        ops->add_scale[CONV_S16_S16] = add_scale_s16_s16;
-        ops->add_scale[CONV_F32_F32] = add_scale_f32_f32;
-        ops->copy_i[CONV_S16_S16] = copy_s16_s16_i;
-        ops->copy_i[CONV_F32_F32] = copy_f32_f32_i;
-        ops->add_i[CONV_S16_S16] = add_s16_s16_i;
-        ops->add_i[CONV_F32_F32] = add_f32_f32_i;
-        ops->copy_scale_i[CONV_S16_S16] = copy_scale_s16_s16_i;
-        ops->copy_scale_i[CONV_F32_F32] = copy_scale_f32_f32_i;
-        ops->add_scale_i[CONV_S16_S16] = add_scale_s16_s16_i;
-        ops->add_scale_i[CONV_F32_F32] = add_scale_f32_f32_i;
+	spa_audiomixer_init_ops(ops, spa_audiomixer_get_cpu_flags());
 }
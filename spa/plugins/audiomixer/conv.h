@@ -27,13 +27,21 @@ typedef void (*mix_i_func_t) (void *dst, int dst_stride,
 			      const void *src, int src_stride, int n_bytes);
 typedef void (*mix_scale_i_func_t) (void *dst, int dst_stride,
 				    const void *src, int src_stride, const void *scale, int n_bytes);
+/* dst = the sum of src[i] * gain[i] of @n_src sources, all @n_bytes long */
+typedef void (*mix_n_func_t) (void *dst, const void *src[], const float gain[],
+			      uint32_t n_src, int n_bytes);
 
 enum {
 	CONV_S16_S16,
 	CONV_F32_F32,
+	CONV_S24_32_S24_32,
+	CONV_S32_S32,
+	CONV_F64_F64,
 	CONV_MAX,
 };
 
+/* The scale functions only exist for S16 and F32, the other formats are
+ * scaled with the gain of mix_n */
 struct spa_audiomixer_ops {
 	mix_func_t copy[CONV_MAX];
 	mix_func_t add[CONV_MAX];
@@ -43,6 +51,40 @@ struct spa_audiomixer_ops {
 	mix_i_func_t add_i[CONV_MAX];
 	mix_scale_i_func_t copy_scale_i[CONV_MAX];
 	mix_scale_i_func_t add_scale_i[CONV_MAX];
+	mix_n_func_t mix_n[CONV_MAX];
 };
 
+#define SPA_AUDIOMIXER_CPU_SSE2	(1 << 0)
+#define SPA_AUDIOMIXER_CPU_AVX2	(1 << 1)
+
+uint32_t spa_audiomixer_get_cpu_flags(void);
+
+/* fill @ops with the fastest functions for @cpu_flags */
+void spa_audiomixer_init_ops(struct spa_audiomixer_ops *ops, uint32_t cpu_flags);
+
+/* fill @ops with the fastest functions for this cpu */
 void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops);
+
+/* plain C versions, also used for the unaligned head and the tail of the
+ * vector versions */
+void copy_s16_s16_c(void *dst, const void *src, int n_bytes);
+void copy_f32_f32_c(void *dst, const void *src, int n_bytes);
+void add_s16_s16_c(void *dst, const void *src, int n_bytes);
+void add_f32_f32_c(void *dst, const void *src, int n_bytes);
+void copy_scale_s16_s16_c(void *dst, const void *src, const void *scale, int n_bytes);
+void copy_scale_f32_f32_c(void *dst, const void *src, const void *scale, int n_bytes);
+void add_scale_s16_s16_c(void *dst, const void *src, const void *scale, int n_bytes);
+void add_scale_f32_f32_c(void *dst, const void *src, const void *scale, int n_bytes);
+void copy_s24_32_s24_32_c(void *dst, const void *src, int n_bytes);
+void copy_s32_s32_c(void *dst, const void *src, int n_bytes);
+void copy_f64_f64_c(void *dst, const void *src, int n_bytes);
+void add_s24_32_s24_32_c(void *dst, const void *src, int n_bytes);
+void add_s32_s32_c(void *dst, const void *src, int n_bytes);
+void add_f64_f64_c(void *dst, const void *src, int n_bytes);
+
+#if defined(HAVE_SSE2)
+void spa_audiomixer_init_ops_sse2(struct spa_audiomixer_ops *ops);
+#endif
+#if defined(HAVE_AVX2)
+void spa_audiomixer_init_ops_avx2(struct spa_audiomixer_ops *ops);
+#endif
@@ -53,6 +53,9 @@ struct type {
 	uint32_t prop_volume;
 	uint32_t wave_sine;
 	uint32_t wave_square;
+	uint32_t wave_silence;
+	uint32_t wave_noise;
+	uint32_t wave_impulse;
 	struct spa_type_meta meta;
 	struct spa_type_data data;
 	struct spa_type_media_type media_type;
@@ -77,6 +80,9 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
 	type->wave_sine = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":sine");
 	type->wave_square = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":square");
+	type->wave_silence = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":silence");
+	type->wave_noise = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":noise");
+	type->wave_impulse = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":impulse");
 	spa_type_meta_map(map, &type->meta);
 	spa_type_data_map(map, &type->data);
 	spa_type_media_type_map(map, &type->media_type);
@@ -140,7 +146,8 @@ struct impl {
 	uint8_t format_buffer[1024];
 	size_t bpf;
 	render_func_t render_func;
-	double accumulator;
+	uint32_t phase;		/**< position in the period as a fraction of 2^32 */
+	uint32_t noise_seed;
 
 	struct buffer buffers[MAX_BUFFERS];
 	uint32_t n_buffers;
@@ -197,10 +204,13 @@ static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
 	spa_pod_builder_props(&b, &f[0], this->type.props,
 		PROP(&f[1], this->type.prop_live, SPA_POD_TYPE_BOOL,
 			this->props.live),
-		PROP_EN(&f[1], this->type.prop_wave, SPA_POD_TYPE_ID, 3,
+		PROP_EN(&f[1], this->type.prop_wave, SPA_POD_TYPE_ID, 6,
 			this->props.wave,
 			this->type.wave_sine,
-			this->type.wave_square),
+			this->type.wave_square,
+			this->type.wave_silence,
+			this->type.wave_noise,
+			this->type.wave_impulse),
 		PROP_MM(&f[1], this->type.prop_freq, SPA_POD_TYPE_DOUBLE,
 			this->props.freq,
 			0.0, 50000000.0),
@@ -589,7 +599,7 @@ impl_node_port_set_format(struct spa_node *node,
 		this->bpf = sizes[idx] * info.info.raw.channels;
 		this->current_format = info;
 		this->have_format = true;
-		this->render_func = sine_funcs[idx];
+		this->render_func = render_funcs[idx];
 	}
 
 	if (this->have_format) {
@@ -1018,6 +1028,8 @@ impl_init(const struct spa_handle_factory *factory,
 	this->node = impl_node;
 	this->clock = impl_clock;
 	reset_props(this, &this->props);
+	init_sine_table();
+	this->noise_seed = 22222;
 
 	spa_list_init(&this->empty);
 
@@ -21,36 +21,130 @@
 
 #define M_PI_M2 ( M_PI + M_PI )
 
-#define DEFINE_SINE(type,scale)								\
-static void										\
-audio_test_src_create_sine_##type (struct impl *this, type *samples, size_t n_samples)	\
+/* one period of a sine, with an extra point for the interpolation. The
+ * phase is a 32 bits fraction of a period, the top bits are the index in
+ * the table and the other bits interpolate */
+#define SINE_TABLE_BITS		11
+#define SINE_TABLE_SIZE		(1 << SINE_TABLE_BITS)
+#define SINE_FRAC_BITS		(32 - SINE_TABLE_BITS)
+#define SINE_FRAC_SCALE		(1.0f / (1 << SINE_FRAC_BITS))
+
+/* frames that are made at a time as float before they are stored */
+#define RENDER_BLOCK	256
+
+static float sine_table[SINE_TABLE_SIZE + 1];
+
+static void init_sine_table(void)
+{
+	static bool initialized = false;
+	int i;
+
+	if (initialized)
+		return;
+
+	for (i = 0; i <= SINE_TABLE_SIZE; i++)
+		sine_table[i] = sin(M_PI_M2 * i / SINE_TABLE_SIZE);
+	initialized = true;
+}
+
+/* the phase advance of one frame */
+static inline uint32_t phase_step(struct impl *this)
+{
+	double f = this->props.freq / this->current_format.info.raw.rate;
+	return (uint32_t) ((f - floor(f)) * 4294967296.0);
+}
+
+/* make @n_samples frames of the wave with the volume applied */
+static void render_wave(struct impl *this, float *d, uint32_t n_samples)
+{
+	uint32_t i, phase = this->phase, step = phase_step(this);
+	float amp = this->props.volume;
+
+	if (this->props.wave == this->type.wave_square) {
+		for (i = 0; i < n_samples; i++, phase += step)
+			d[i] = phase < 0x80000000u ? amp : -amp;
+	} else if (this->props.wave == this->type.wave_noise) {
+		uint32_t s = this->noise_seed;
+		float scale = amp / 2147483648.0f;
+
+		for (i = 0; i < n_samples; i++) {
+			/* xorshift, uniform between -amp and amp */
+			s ^= s << 13;
+			s ^= s >> 17;
+			s ^= s << 5;
+			d[i] = (int32_t) s * scale;
+		}
+		this->noise_seed = s;
+	} else if (this->props.wave == this->type.wave_impulse) {
+		/* one sample at the start of each period */
+		for (i = 0; i < n_samples; i++, phase += step)
+			d[i] = phase < step ? amp : 0.0f;
+	} else {
+		for (i = 0; i < n_samples; i++, phase += step) {
+			uint32_t idx = phase >> SINE_FRAC_BITS;
+			float frac = (phase & ((1u << SINE_FRAC_BITS) - 1)) * SINE_FRAC_SCALE;
+			float s0 = sine_table[idx], s1 = sine_table[idx + 1];
+
+			d[i] = (s0 + (s1 - s0) * frac) * amp;
+		}
+	}
+	this->phase = phase;
+}
+
+/* the wave is made once for all channels, stereo and mono are stored
+ * with their own loops so that the stores are vectorized */
+#define DEFINE_RENDER(t,conv)								\
+static int										\
+audio_test_src_render_##t (struct impl *this, void *samples, size_t n_samples)		\
 {											\
-	int i, c, channels;								\
-	double step, amp;								\
+	t *d = samples;									\
+	uint32_t i, c, n, channels = this->current_format.info.raw.channels;		\
+	float block[RENDER_BLOCK];							\
+											\
+	if (this->props.wave == this->type.wave_silence) {				\
+		memset(samples, 0, n_samples * this->bpf);				\
+		return SPA_RESULT_OK;							\
+	}										\
 											\
-	channels = this->current_format.info.raw.channels;				\
-	step = M_PI_M2 * this->props.freq / this->current_format.info.raw.rate;		\
-	amp = this->props.volume * scale;						\
+	for (; n_samples > 0; n_samples -= n) {						\
+		n = SPA_MIN(n_samples, RENDER_BLOCK);					\
+		render_wave(this, block, n);						\
 											\
-	for (i = 0; i < n_samples; i++) {						\
-		type val;								\
-		this->accumulator += step;						\
-		if (this->accumulator >= M_PI_M2)					\
-			this->accumulator -= M_PI_M2;					\
-		val = (type) (sin (this->accumulator) * amp);				\
-		for (c = 0; c < channels; ++c)						\
-			*samples++ = val;						\
+		switch (channels) {							\
+		case 1:									\
+			for (i = 0; i < n; i++)						\
+				d[i] = conv(block[i]);					\
+			break;								\
+		case 2:									\
+			for (i = 0; i < n; i++)						\
+				d[2 * i] = d[2 * i + 1] = conv(block[i]);		\
+			break;								\
+		default:								\
+			for (i = 0; i < n; i++) {					\
+				t val = conv(block[i]);					\
+				for (c = 0; c < channels; c++)				\
+					d[i * channels + c] = val;			\
+			}								\
+			break;								\
+		}									\
+		d += n * channels;							\
 	}										\
+	return SPA_RESULT_OK;								\
 }
 
-DEFINE_SINE(int16_t, 32767.0);
-DEFINE_SINE(int32_t, 2147483647.0);
-DEFINE_SINE(float, 1.0);
-DEFINE_SINE(double, 1.0);
+#define CONV_S16(v)	((int16_t) (SPA_CLAMP(v, -1.0f, 1.0f) * 32767.0f))
+#define CONV_S32(v)	((int32_t) (SPA_CLAMP(v, -1.0f, 1.0f) * 2147483647.0))
+#define CONV_F32(v)	(v)
+#define CONV_F64(v)	((double) (v))
+
+DEFINE_RENDER(int16_t, CONV_S16);
+DEFINE_RENDER(int32_t, CONV_S32);
+DEFINE_RENDER(float, CONV_F32);
+DEFINE_RENDER(double, CONV_F64);
 
-static const render_func_t sine_funcs[] = {
-	(render_func_t) audio_test_src_create_sine_int16_t,
-	(render_func_t) audio_test_src_create_sine_int32_t,
-	(render_func_t) audio_test_src_create_sine_float,
-	(render_func_t) audio_test_src_create_sine_double
+static const render_func_t render_funcs[] = {
+	audio_test_src_render_int16_t,
+	audio_test_src_render_int32_t,
+	audio_test_src_render_float,
+	audio_test_src_render_double
 };
@@ -0,0 +1,211 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <emmintrin.h>
+
+#include "volume-ops.h"
+
+/* The gains of the interleaved channels repeat after n_channels samples.
+ * The vector loops use a gain pattern of n_channels vectors, which covers
+ * a whole number of frames, and leave the last frames to the C versions.
+ * The rounding is the same as lrintf() and llrint() of the C versions. */
+
+static inline __m128i mul_s16(__m128i in, __m128 g0, __m128 g1)
+{
+	__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+	__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+	__m128 fl = _mm_mul_ps(_mm_cvtepi32_ps(lo), g0);
+	__m128 fh = _mm_mul_ps(_mm_cvtepi32_ps(hi), g1);
+
+	return _mm_packs_epi32(_mm_cvtps_epi32(fl), _mm_cvtps_epi32(fh));
+}
+
+/* the 32 bit samples are scaled in double like the C version, the clamp
+ * before the rounding gives the same result as the clamp after it */
+static inline __m128i mul_s32(__m128i in, __m128 g)
+{
+	__m128d min = _mm_set1_pd(INT32_MIN), max = _mm_set1_pd(INT32_MAX);
+	__m128d lo = _mm_mul_pd(_mm_cvtepi32_pd(in), _mm_cvtps_pd(g));
+	__m128d hi = _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(in, 8)),
+				_mm_cvtps_pd(_mm_movehl_ps(g, g)));
+
+	lo = _mm_min_pd(_mm_max_pd(lo, min), max);
+	hi = _mm_min_pd(_mm_max_pd(hi, min), max);
+	return _mm_unpacklo_epi64(_mm_cvtpd_epi32(lo), _mm_cvtpd_epi32(hi));
+}
+
+static void
+volume_s16_sse2(void *dst, const void *src, const float *gains, uint32_t n_channels, uint32_t n_frames)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float g[VOLUME_MAX_CHANNELS * 8] SPA_ALIGNED(16);
+	uint32_t i, k, n_vecs = n_channels * 2, blocks;
+
+	if (n_channels > VOLUME_MAX_CHANNELS) {
+		volume_s16_c(dst, src, gains, n_channels, n_frames);
+		return;
+	}
+	for (i = 0; i < n_channels * 8; i++)
+		g[i] = gains[i % n_channels];
+
+	/* a block of 8 frames is n_channels vectors of 8 samples */
+	blocks = n_frames / 8;
+	for (i = 0; i < blocks; i++) {
+		for (k = 0; k < n_vecs; k += 2) {
+			_mm_storeu_si128((__m128i *) d,
+					 mul_s16(_mm_loadu_si128((const __m128i *) s),
+						 _mm_load_ps(&g[k * 4]), _mm_load_ps(&g[k * 4 + 4])));
+			s += 8;
+			d += 8;
+		}
+	}
+	volume_s16_c(d, s, gains, n_channels, n_frames - blocks * 8);
+}
+
+static void
+volume_s32_sse2(void *dst, const void *src, const float *gains, uint32_t n_channels, uint32_t n_frames)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	float g[VOLUME_MAX_CHANNELS * 4] SPA_ALIGNED(16);
+	uint32_t i, k, blocks;
+
+	if (n_channels > VOLUME_MAX_CHANNELS) {
+		volume_s32_c(dst, src, gains, n_channels, n_frames);
+		return;
+	}
+	for (i = 0; i < n_channels * 4; i++)
+		g[i] = gains[i % n_channels];
+
+	/* a block of 4 frames is n_channels vectors of 4 samples */
+	blocks = n_frames / 4;
+	for (i = 0; i < blocks; i++) {
+		for (k = 0; k < n_channels; k++) {
+			_mm_storeu_si128((__m128i *) d,
+					 mul_s32(_mm_loadu_si128((const __m128i *) s),
+						 _mm_load_ps(&g[k * 4])));
+			s += 4;
+			d += 4;
+		}
+	}
+	volume_s32_c(d, s, gains, n_channels, n_frames - blocks * 4);
+}
+
+static void
+volume_f32_sse2(void *dst, const void *src, const float *gains, uint32_t n_channels, uint32_t n_frames)
+{
+	const float *s = src;
+	float *d = dst;
+	float g[VOLUME_MAX_CHANNELS * 4] SPA_ALIGNED(16);
+	uint32_t i, k, blocks;
+
+	if (n_channels > VOLUME_MAX_CHANNELS) {
+		volume_f32_c(dst, src, gains, n_channels, n_frames);
+		return;
+	}
+	for (i = 0; i < n_channels * 4; i++)
+		g[i] = gains[i % n_channels];
+
+	/* a block of 4 frames is n_channels vectors of 4 samples */
+	blocks = n_frames / 4;
+	for (i = 0; i < blocks; i++) {
+		for (k = 0; k < n_channels; k++) {
+			_mm_storeu_ps(d, _mm_mul_ps(_mm_loadu_ps(s), _mm_load_ps(&g[k * 4])));
+			s += 4;
+			d += 4;
+		}
+	}
+	volume_f32_c(d, s, gains, n_channels, n_frames - blocks * 4);
+}
+
+/* the ramps have a gain for each sample, the tails are done by the C
+ * versions with all the samples as the channels of one frame */
+static void
+mul_s16_sse2(void *dst, const void *src, const float *g, uint32_t n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	uint32_t i;
+
+	for (i = 0; i + 8 <= n_samples; i += 8)
+		_mm_storeu_si128((__m128i *) &d[i],
+				 mul_s16(_mm_loadu_si128((const __m128i *) &s[i]),
+					 _mm_loadu_ps(&g[i]), _mm_loadu_ps(&g[i + 4])));
+	volume_s16_c(&d[i], &s[i], &g[i], n_samples - i, 1);
+}
+
+static void
+mul_s32_sse2(void *dst, const void *src, const float *g, uint32_t n_samples)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	uint32_t i;
+
+	for (i = 0; i + 4 <= n_samples; i += 4)
+		_mm_storeu_si128((__m128i *) &d[i],
+				 mul_s32(_mm_loadu_si128((const __m128i *) &s[i]), _mm_loadu_ps(&g[i])));
+	volume_s32_c(&d[i], &s[i], &g[i], n_samples - i, 1);
+}
+
+static void
+mul_f32_sse2(void *dst, const void *src, const float *g, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	uint32_t i;
+
+	for (i = 0; i + 4 <= n_samples; i += 4)
+		_mm_storeu_ps(&d[i], _mm_mul_ps(_mm_loadu_ps(&s[i]), _mm_loadu_ps(&g[i])));
+	volume_f32_c(&d[i], &s[i], &g[i], n_samples - i, 1);
+}
+
+static void
+ramp_s16_sse2(void *dst, const void *src, float *gains, const float *steps, bool exponential,
+	      uint32_t n_channels, uint32_t n_frames)
+{
+	volume_ramp(mul_s16_sse2, sizeof(int16_t), dst, src, gains, steps, exponential,
+		    n_channels, n_frames);
+}
+
+static void
+ramp_s32_sse2(void *dst, const void *src, float *gains, const float *steps, bool exponential,
+	      uint32_t n_channels, uint32_t n_frames)
+{
+	volume_ramp(mul_s32_sse2, sizeof(int32_t), dst, src, gains, steps, exponential,
+		    n_channels, n_frames);
+}
+
+static void
+ramp_f32_sse2(void *dst, const void *src, float *gains, const float *steps, bool exponential,
+	      uint32_t n_channels, uint32_t n_frames)
+{
+	volume_ramp(mul_f32_sse2, sizeof(float), dst, src, gains, steps, exponential,
+		    n_channels, n_frames);
+}
+
+void spa_volume_init_ops_sse2(struct spa_volume_ops *ops)
+{
+	ops->volume[VOLUME_S16] = volume_s16_sse2;
+	ops->volume[VOLUME_S32] = volume_s32_sse2;
+	ops->volume[VOLUME_F32] = volume_f32_sse2;
+	ops->ramp[VOLUME_S16] = ramp_s16_sse2;
+	ops->ramp[VOLUME_S32] = ramp_s32_sse2;
+	ops->ramp[VOLUME_F32] = ramp_f32_sse2;
+}
@@ -0,0 +1,220 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <math.h>
+
+#include <spa/cpu.h>
+
+#include "volume-ops.h"
+
+void
+volume_s16_c(void *dst, const void *src, const float *gains, uint32_t n_channels, uint32_t n_frames)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	uint32_t i, c;
+	int32_t t;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++) {
+			t = lrintf(*s++ * gains[c]);
+			*d++ = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		}
+	}
+}
+
+void
+volume_s32_c(void *dst, const void *src, const float *gains, uint32_t n_channels, uint32_t n_frames)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	uint32_t i, c;
+	int64_t t;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++) {
+			t = llrint(*s++ * (double) gains[c]);
+			*d++ = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		}
+	}
+}
+
+void
+volume_f32_c(void *dst, const void *src, const float *gains, uint32_t n_channels, uint32_t n_frames)
+{
+	const float *s = src;
+	float *d = dst;
+	uint32_t i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			*d++ = *s++ * gains[c];
+	}
+}
+
+/* the gains of a ramp are computed for this many samples at a time, that
+ * is at least 16 frames */
+#define RAMP_SAMPLES	(VOLUME_MAX_CHANNELS * 16)
+
+/* fill @g with the gains of @n_frames frames for @width channels from
+ * channel @c, @width is at most 4. The gain of a channel only depends on
+ * its gain in the previous frame, the channels are kept in registers so
+ * that their additions or multiplications overlap */
+static inline void
+ramp_gains(float *g, float *gains, const float *steps, bool exponential,
+	   uint32_t n_channels, uint32_t c, uint32_t width, uint32_t n_frames)
+{
+	float v0 = 0.0f, v1 = 0.0f, v2 = 0.0f, v3 = 0.0f;
+	float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+	uint32_t i;
+
+	v0 = gains[c], s0 = steps[c];
+	if (width > 1)
+		v1 = gains[c + 1], s1 = steps[c + 1];
+	if (width > 2)
+		v2 = gains[c + 2], s2 = steps[c + 2];
+	if (width > 3)
+		v3 = gains[c + 3], s3 = steps[c + 3];
+
+	for (i = 0; i < n_frames; i++) {
+		float *p = &g[i * n_channels + c];
+
+		p[0] = v0;
+		if (width > 1)
+			p[1] = v1;
+		if (width > 2)
+			p[2] = v2;
+		if (width > 3)
+			p[3] = v3;
+		if (exponential)
+			v0 *= s0, v1 *= s1, v2 *= s2, v3 *= s3;
+		else
+			v0 += s0, v1 += s1, v2 += s2, v3 += s3;
+	}
+
+	gains[c] = v0;
+	if (width > 1)
+		gains[c + 1] = v1;
+	if (width > 2)
+		gains[c + 2] = v2;
+	if (width > 3)
+		gains[c + 3] = v3;
+}
+
+void
+volume_ramp(volume_mul_func_t mul, uint32_t sample_size,
+	    void *dst, const void *src, float *gains, const float *steps,
+	    bool exponential, uint32_t n_channels, uint32_t n_frames)
+{
+	float g[RAMP_SAMPLES] SPA_ALIGNED(16);
+	uint32_t c, n, block = RAMP_SAMPLES / n_channels;
+
+	for (; n_frames > 0; n_frames -= n) {
+		n = SPA_MIN(n_frames, block);
+
+		/* a constant width for each call makes the unused channels go
+		 * away */
+		for (c = 0; c + 4 <= n_channels; c += 4)
+			ramp_gains(g, gains, steps, exponential, n_channels, c, 4, n);
+		switch (n_channels - c) {
+		case 3:
+			ramp_gains(g, gains, steps, exponential, n_channels, c, 3, n);
+			break;
+		case 2:
+			ramp_gains(g, gains, steps, exponential, n_channels, c, 2, n);
+			break;
+		case 1:
+			ramp_gains(g, gains, steps, exponential, n_channels, c, 1, n);
+			break;
+		}
+
+		mul(dst, src, g, n * n_channels);
+
+		dst = SPA_MEMBER(dst, n * n_channels * sample_size, void);
+		src = SPA_MEMBER(src, n * n_channels * sample_size, void);
+	}
+}
+
+/* the gains of the samples are the gains of one frame with all the
+ * samples as channels */
+static void
+mul_s16_c(void *dst, const void *src, const float *g, uint32_t n_samples)
+{
+	volume_s16_c(dst, src, g, n_samples, 1);
+}
+
+static void
+mul_s32_c(void *dst, const void *src, const float *g, uint32_t n_samples)
+{
+	volume_s32_c(dst, src, g, n_samples, 1);
+}
+
+static void
+mul_f32_c(void *dst, const void *src, const float *g, uint32_t n_samples)
+{
+	volume_f32_c(dst, src, g, n_samples, 1);
+}
+
+static void
+ramp_s16_c(void *dst, const void *src, float *gains, const float *steps, bool exponential,
+	   uint32_t n_channels, uint32_t n_frames)
+{
+	volume_ramp(mul_s16_c, sizeof(int16_t), dst, src, gains, steps, exponential,
+		    n_channels, n_frames);
+}
+
+static void
+ramp_s32_c(void *dst, const void *src, float *gains, const float *steps, bool exponential,
+	   uint32_t n_channels, uint32_t n_frames)
+{
+	volume_ramp(mul_s32_c, sizeof(int32_t), dst, src, gains, steps, exponential,
+		    n_channels, n_frames);
+}
+
+static void
+ramp_f32_c(void *dst, const void *src, float *gains, const float *steps, bool exponential,
+	   uint32_t n_channels, uint32_t n_frames)
+{
+	volume_ramp(mul_f32_c, sizeof(float), dst, src, gains, steps, exponential,
+		    n_channels, n_frames);
+}
+
+uint32_t spa_volume_get_cpu_flags(void)
+{
+	uint32_t cpu_flags = spa_cpu_get_flags(), flags = 0;
+
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		flags |= SPA_VOLUME_CPU_SSE2;
+	return flags;
+}
+
+void spa_volume_init_ops(struct spa_volume_ops *ops, uint32_t cpu_flags)
+{
+	ops->volume[VOLUME_S16] = volume_s16_c;
+	ops->volume[VOLUME_S32] = volume_s32_c;
+	ops->volume[VOLUME_F32] = volume_f32_c;
+	ops->ramp[VOLUME_S16] = ramp_s16_c;
+	ops->ramp[VOLUME_S32] = ramp_s32_c;
+	ops->ramp[VOLUME_F32] = ramp_f32_c;
+
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_VOLUME_CPU_SSE2)
+		spa_volume_init_ops_sse2(ops);
+#endif
+}
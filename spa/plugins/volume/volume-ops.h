@@ -0,0 +1,74 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <spa/defs.h>
+
+#define VOLUME_MAX_CHANNELS	64
+
+/* dst = src * gains[channel] for @n_frames interleaved frames */
+typedef void (*volume_func_t) (void *dst, const void *src, const float *gains,
+			       uint32_t n_channels, uint32_t n_frames);
+/* like volume_func_t but the gains are updated after each frame, by
+ * adding @steps for a linear ramp or by multiplying with @steps for an
+ * exponential ramp. @n_channels is at most VOLUME_MAX_CHANNELS */
+typedef void (*volume_ramp_func_t) (void *dst, const void *src, float *gains,
+				    const float *steps, bool exponential,
+				    uint32_t n_channels, uint32_t n_frames);
+/* dst = src * g[i] with a gain for each of the @n_samples samples */
+typedef void (*volume_mul_func_t) (void *dst, const void *src, const float *g,
+				   uint32_t n_samples);
+
+enum {
+	VOLUME_S16,
+	VOLUME_S32,
+	VOLUME_F32,
+	VOLUME_MAX,
+};
+
+struct spa_volume_ops {
+	volume_func_t volume[VOLUME_MAX];
+	volume_ramp_func_t ramp[VOLUME_MAX];
+};
+
+#define SPA_VOLUME_CPU_SSE2	(1 << 0)
+
+uint32_t spa_volume_get_cpu_flags(void);
+
+/* fill @ops with the fastest functions for @cpu_flags */
+void spa_volume_init_ops(struct spa_volume_ops *ops, uint32_t cpu_flags);
+
+/* plain C versions, also used for the tails of the vector versions */
+void volume_s16_c(void *dst, const void *src, const float *gains,
+		  uint32_t n_channels, uint32_t n_frames);
+void volume_s32_c(void *dst, const void *src, const float *gains,
+		  uint32_t n_channels, uint32_t n_frames);
+void volume_f32_c(void *dst, const void *src, const float *gains,
+		  uint32_t n_channels, uint32_t n_frames);
+
+/* ramp by computing the gains of a block of frames and applying them to
+ * the samples of @sample_size bytes with @mul */
+void volume_ramp(volume_mul_func_t mul, uint32_t sample_size,
+		 void *dst, const void *src, float *gains, const float *steps,
+		 bool exponential, uint32_t n_channels, uint32_t n_frames);
+
+#if defined(HAVE_SSE2)
+void spa_volume_init_ops_sse2(struct spa_volume_ops *ops);
+#endif
@@ -19,6 +19,7 @@
 
 #include <string.h>
 #include <stddef.h>
+#include <math.h>
 
 #include <spa/log.h>
 #include <spa/type-map.h>
@@ -30,6 +31,8 @@
 #include <lib/props.h>
 #include <lib/format.h>
 
+#include "volume-ops.h"
+
 #define NAME "volume"
 
 #define MAX_BUFFERS     16
@@ -37,6 +40,10 @@
 struct props {
 	double volume;
 	bool mute;
+	double channel_volumes[VOLUME_MAX_CHANNELS];
+	uint32_t n_channel_volumes;
+	int32_t ramp_samples;
+	uint32_t ramp_type;
 };
 
 struct buffer {
@@ -67,6 +74,11 @@ struct type {
 	uint32_t props;
 	uint32_t prop_volume;
 	uint32_t prop_mute;
+	uint32_t prop_channel_volumes;
+	uint32_t prop_ramp_samples;
+	uint32_t prop_ramp_type;
+	uint32_t ramp_linear;
+	uint32_t ramp_exponential;
 	struct spa_type_meta meta;
 	struct spa_type_data data;
 	struct spa_type_media_type media_type;
@@ -86,6 +98,11 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
 	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
 	type->prop_mute = spa_type_map_get_id(map, SPA_TYPE_PROPS__mute);
+	type->prop_channel_volumes = spa_type_map_get_id(map, SPA_TYPE_PROPS__channelVolumes);
+	type->prop_ramp_samples = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampSamples);
+	type->prop_ramp_type = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampType);
+	type->ramp_linear = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampType ":linear");
+	type->ramp_exponential = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampType ":exponential");
 	spa_type_meta_map(map, &type->meta);
 	spa_type_data_map(map, &type->data);
 	spa_type_media_type_map(map, &type->media_type);
@@ -106,9 +123,13 @@ struct impl {
 	struct spa_type_map *map;
 	struct spa_log *log;
 
-	uint8_t props_buffer[512];
+	uint8_t props_buffer[1024];
 	struct props props;
 
+	struct props staged;		/**< copy of the props for the data thread */
+	uint32_t staged_seq;		/**< odd while \a staged is written */
+	uint32_t applied_seq;		/**< \a staged_seq of the gains in use */
+
 	const struct spa_node_callbacks *callbacks;
 	void *callbacks_data;
 
@@ -116,6 +137,21 @@ struct impl {
 	struct spa_audio_info current_format;
 	int bpf;
 
+	struct spa_volume_ops ops;
+	volume_func_t volume;
+	volume_ramp_func_t ramp;
+	uint32_t n_channels;
+
+	float gains[VOLUME_MAX_CHANNELS];	/**< gains in use */
+	float target[VOLUME_MAX_CHANNELS];	/**< gains at the end of the ramp */
+	float steps[VOLUME_MAX_CHANNELS];	/**< change of the gains per frame */
+	uint32_t ramp_left;			/**< frames left in the ramp */
+	bool ramp_exponential;
+	bool unity;				/**< all target gains are 1.0 */
+	bool muted;				/**< silence after the ramp */
+
+	bool in_place;		/**< input and output use the same buffers */
+
 	struct port in_ports[1];
 	struct port out_ports[1];
 
@@ -128,17 +164,100 @@ struct impl {
 
 #define DEFAULT_VOLUME 1.0
 #define DEFAULT_MUTE false
+#define DEFAULT_RAMP_SAMPLES 0
+
+/* exponential ramps start or end here instead of at 0.0 */
+#define MIN_RAMP_GAIN 0.00001f
+/* a mute change ramps at least this many frames to avoid a click */
+#define MUTE_RAMP_SAMPLES 128
 
-static void reset_props(struct props *props)
+static void reset_props(struct impl *this, struct props *props)
 {
 	props->volume = DEFAULT_VOLUME;
 	props->mute = DEFAULT_MUTE;
+	props->n_channel_volumes = 0;
+	props->ramp_samples = DEFAULT_RAMP_SAMPLES;
+	props->ramp_type = this->type.ramp_linear;
+}
+
+/* calculate the new gains of the channels from @p, when @ramp is true the
+ * gains move to the new values over the ramp time */
+static void update_gains(struct impl *this, const struct props *p, bool ramp)
+{
+	uint32_t c, n_samples = SPA_MAX(p->ramp_samples, 0);
+	float start, end;
+
+	this->unity = !p->mute;
+	for (c = 0; c < this->n_channels; c++) {
+		double v = p->mute ? 0.0 : p->volume;
+
+		if (c < p->n_channel_volumes)
+			v *= p->channel_volumes[c];
+		this->target[c] = v;
+		this->unity &= this->target[c] == 1.0f;
+	}
+
+	if (p->mute != this->muted)
+		n_samples = SPA_MAX(n_samples, MUTE_RAMP_SAMPLES);
+	this->muted = p->mute;
+
+	if (!ramp || n_samples == 0) {
+		memcpy(this->gains, this->target, this->n_channels * sizeof(float));
+		this->ramp_left = 0;
+		return;
+	}
+
+	this->ramp_exponential = p->ramp_type == this->type.ramp_exponential;
+	for (c = 0; c < this->n_channels; c++) {
+		if (this->ramp_exponential) {
+			start = SPA_MAX(this->gains[c], MIN_RAMP_GAIN);
+			end = SPA_MAX(this->target[c], MIN_RAMP_GAIN);
+			this->gains[c] = start;
+			this->steps[c] = powf(end / start, 1.0f / n_samples);
+		} else {
+			this->steps[c] = (this->target[c] - this->gains[c]) / n_samples;
+		}
+	}
+	this->ramp_left = n_samples;
+}
+
+/* hand the props to the data thread, they are applied at the start of
+ * the next cycle */
+static void stage_props(struct impl *this)
+{
+	__atomic_store_n(&this->staged_seq, this->staged_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	this->staged = this->props;
+	__atomic_store_n(&this->staged_seq, this->staged_seq + 1, __ATOMIC_RELEASE);
+}
+
+/* called from the data thread, ramp to the staged props when they changed.
+ * When they are being written we try again in the next cycle */
+static void apply_staged_props(struct impl *this)
+{
+	struct props p;
+	uint32_t seq;
+
+	seq = __atomic_load_n(&this->staged_seq, __ATOMIC_ACQUIRE);
+	if (seq == this->applied_seq || (seq & 1))
+		return;
+
+	p = this->staged;
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&this->staged_seq, __ATOMIC_RELAXED) != seq)
+		return;
+
+	this->applied_seq = seq;
+	update_gains(this, &p, true);
 }
 
 #define PROP(f,key,type,...)							\
 	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
 #define PROP_MM(f,key,type,...)							\
 	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_EN(f,key,type,n,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
 #define PROP_U_MM(f,key,type,...)						\
 	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
 			SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
@@ -159,12 +278,30 @@ static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
 	this = SPA_CONTAINER_OF(node, struct impl, node);
 
 	spa_pod_builder_init(&b, this->props_buffer, sizeof(this->props_buffer));
-	spa_pod_builder_props(&b, &f[0], this->type.props,
+	spa_pod_builder_push_object(&b, &f[0], 0, this->type.props);
+	spa_pod_builder_add(&b,
 		PROP_MM(&f[1], this->type.prop_volume, SPA_POD_TYPE_DOUBLE,
 			this->props.volume,
 			0.0, 10.0),
 		PROP(&f[1], this->type.prop_mute, SPA_POD_TYPE_BOOL,
-			this->props.mute));
+			this->props.mute),
+		PROP_MM(&f[1], this->type.prop_ramp_samples, SPA_POD_TYPE_INT,
+			this->props.ramp_samples,
+			0, INT32_MAX),
+		PROP_EN(&f[1], this->type.prop_ramp_type, SPA_POD_TYPE_ID, 3,
+			this->props.ramp_type,
+			this->type.ramp_linear,
+			this->type.ramp_exponential), 0);
+
+	/* an array of doubles, like in set_props */
+	if (this->props.n_channel_volumes > 0) {
+		spa_pod_builder_push_prop(&b, &f[1], this->type.prop_channel_volumes, 0);
+		spa_pod_builder_array(&b, sizeof(double), SPA_POD_TYPE_DOUBLE,
+				      this->props.n_channel_volumes,
+				      this->props.channel_volumes);
+		spa_pod_builder_pop(&b, &f[1]);
+	}
+	spa_pod_builder_pop(&b, &f[0]);
 
 	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
 
@@ -180,12 +317,32 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 	this = SPA_CONTAINER_OF(node, struct impl, node);
 
 	if (props == NULL) {
-		reset_props(&this->props);
+		reset_props(this, &this->props);
 	} else {
+		struct spa_pod_array *volumes = NULL;
+
 		spa_props_query(props,
 				this->type.prop_volume, SPA_POD_TYPE_DOUBLE, &this->props.volume,
-				this->type.prop_mute, SPA_POD_TYPE_BOOL, &this->props.mute, 0);
+				this->type.prop_mute, SPA_POD_TYPE_BOOL, &this->props.mute,
+				this->type.prop_channel_volumes, -SPA_POD_TYPE_ARRAY, &volumes,
+				this->type.prop_ramp_samples, SPA_POD_TYPE_INT, &this->props.ramp_samples,
+				this->type.prop_ramp_type, SPA_POD_TYPE_ID, &this->props.ramp_type, 0);
+
+		/* an array of doubles, the volume of each channel */
+		if (volumes && volumes->body.child.type == SPA_POD_TYPE_DOUBLE &&
+		    volumes->body.child.size == sizeof(double)) {
+			uint32_t n = (SPA_POD_BODY_SIZE(volumes) - sizeof(struct spa_pod_array_body)) /
+				sizeof(double);
+
+			n = SPA_MIN(n, VOLUME_MAX_CHANNELS);
+			memcpy(this->props.channel_volumes, SPA_MEMBER(&volumes->body,
+					sizeof(struct spa_pod_array_body), void),
+			       n * sizeof(double));
+			this->props.n_channel_volumes = n;
+		}
 	}
+	stage_props(this);
+
 	return SPA_RESULT_OK;
 }
 
@@ -308,10 +465,11 @@ impl_node_port_enum_formats(struct spa_node *node,
 		spa_pod_builder_format(&b, &f[0], this->type.format,
 			this->type.media_type.audio,
 			this->type.media_subtype.raw,
-			PROP_U_EN(&f[1], this->type.format_audio.format, SPA_POD_TYPE_ID, 3,
+			PROP_U_EN(&f[1], this->type.format_audio.format, SPA_POD_TYPE_ID, 4,
 				this->type.audio_format.S16,
 				this->type.audio_format.S16,
-				this->type.audio_format.S32),
+				this->type.audio_format.S32,
+				this->type.audio_format.F32),
 			PROP_U_MM(&f[1], this->type.format_audio.rate, SPA_POD_TYPE_INT,
 				44100,
 				1, INT32_MAX),
@@ -334,12 +492,26 @@ impl_node_port_enum_formats(struct spa_node *node,
 	return SPA_RESULT_OK;
 }
 
+static void update_in_place(struct impl *this)
+{
+	struct port *in_port = &this->in_ports[0];
+	struct port *out_port = &this->out_ports[0];
+	uint32_t i;
+
+	this->in_place = in_port->n_buffers > 0 && in_port->n_buffers == out_port->n_buffers;
+	for (i = 0; i < in_port->n_buffers && this->in_place; i++)
+		this->in_place = in_port->buffers[i].outbuf == out_port->buffers[i].outbuf;
+
+	spa_log_info(this->log, NAME " %p: in place %d", this, this->in_place);
+}
+
 static int clear_buffers(struct impl *this, struct port *port)
 {
 	if (port->n_buffers > 0) {
 		spa_log_info(this->log, NAME " %p: clear buffers", this);
 		port->n_buffers = 0;
 		spa_list_init(&port->empty);
+		this->in_place = false;
 	}
 	return SPA_RESULT_OK;
 }
@@ -378,9 +550,33 @@ impl_node_port_set_format(struct spa_node *node,
 		if (!spa_format_audio_raw_parse(format, &info.info.raw, &this->type.format_audio))
 			return SPA_RESULT_INVALID_MEDIA_TYPE;
 
-		this->bpf = 2 * info.info.raw.channels;
+		if (info.info.raw.channels == 0 || info.info.raw.channels > VOLUME_MAX_CHANNELS ||
+		    info.info.raw.layout != SPA_AUDIO_LAYOUT_INTERLEAVED)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if (info.info.raw.format == this->type.audio_format.S16) {
+			this->volume = this->ops.volume[VOLUME_S16];
+			this->ramp = this->ops.ramp[VOLUME_S16];
+			this->bpf = sizeof(int16_t);
+		} else if (info.info.raw.format == this->type.audio_format.S32) {
+			this->volume = this->ops.volume[VOLUME_S32];
+			this->ramp = this->ops.ramp[VOLUME_S32];
+			this->bpf = sizeof(int32_t);
+		} else if (info.info.raw.format == this->type.audio_format.F32) {
+			this->volume = this->ops.volume[VOLUME_F32];
+			this->ramp = this->ops.ramp[VOLUME_F32];
+			this->bpf = sizeof(float);
+		} else
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		this->bpf *= info.info.raw.channels;
+		this->n_channels = info.info.raw.channels;
 		this->current_format = info;
 		port->have_format = true;
+
+		/* no ramp when the format changes, this also applies the staged props */
+		this->applied_seq = this->staged_seq;
+		update_gains(this, &this->props, false);
 	}
 
 	return SPA_RESULT_OK;
@@ -559,6 +755,8 @@ impl_node_port_use_buffers(struct spa_node *node,
 	}
 	port->n_buffers = n_buffers;
 
+	update_in_place(this);
+
 	return SPA_RESULT_OK;
 }
 
@@ -611,6 +809,12 @@ static void recycle_buffer(struct impl *this, uint32_t id)
 	spa_log_trace(this->log, NAME " %p: recycle buffer %d", this, id);
 }
 
+static inline void release_buffer(struct impl *this, struct spa_buffer *buffer)
+{
+	if (this->callbacks && this->callbacks->reuse_buffer)
+		this->callbacks->reuse_buffer(this->callbacks_data, 0, buffer->id);
+}
+
 static int impl_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
 {
 	struct impl *this;
@@ -631,7 +835,10 @@ static int impl_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id,
 	if (buffer_id >= port->n_buffers)
 		return SPA_RESULT_INVALID_BUFFER_ID;
 
-	recycle_buffer(this, buffer_id);
+	if (this->in_place)
+		release_buffer(this, port->buffers[buffer_id].outbuf);
+	else
+		recycle_buffer(this, buffer_id);
 
 	return SPA_RESULT_OK;
 }
@@ -659,51 +866,60 @@ static struct spa_buffer *find_free_buffer(struct impl *this, struct port *port)
 	return b->outbuf;
 }
 
-static inline void release_buffer(struct impl *this, struct spa_buffer *buffer)
-{
-	if (this->callbacks && this->callbacks->reuse_buffer)
-		this->callbacks->reuse_buffer(this->callbacks_data, 0, buffer->id);
-}
-
-static void do_volume(struct impl *this, struct spa_buffer *dbuf, struct spa_buffer *sbuf)
+static void apply_volume(struct impl *this, void *dst, const void *src, uint32_t n_frames)
 {
-	uint32_t si, di, i, n_samples, n_bytes, soff, doff;
-	struct spa_data *sd, *dd;
-	uint16_t *src, *dst;
-	double volume;
+	uint32_t n;
 
-	volume = this->props.volume;
+	if (this->ramp_left > 0) {
+		n = SPA_MIN(this->ramp_left, n_frames);
 
-	si = di = 0;
-	soff = doff = 0;
+		this->ramp(dst, src, this->gains, this->steps, this->ramp_exponential,
+			   this->n_channels, n);
 
-	while (true) {
-		if (si == sbuf->n_datas || di == dbuf->n_datas)
-			break;
+		if ((this->ramp_left -= n) == 0)
+			memcpy(this->gains, this->target, this->n_channels * sizeof(float));
 
-		sd = &sbuf->datas[si];
-		dd = &dbuf->datas[di];
+		dst = SPA_MEMBER(dst, n * this->bpf, void);
+		src = SPA_MEMBER(src, n * this->bpf, void);
+		n_frames -= n;
+	}
+	if (n_frames == 0)
+		return;
 
-		src = (uint16_t *) ((uint8_t *) sd->data + sd->chunk->offset + soff);
-		dst = (uint16_t *) ((uint8_t *) dd->data + dd->chunk->offset + doff);
+	if (this->muted) {
+		memset(dst, 0, n_frames * this->bpf);
+	} else if (this->unity) {
+		/* nothing to do when we work in place */
+		if (dst != src)
+			memcpy(dst, src, n_frames * this->bpf);
+	} else {
+		this->volume(dst, src, this->gains, this->n_channels, n_frames);
+	}
+}
 
-		n_bytes = SPA_MIN(sd->chunk->size - soff, dd->chunk->size - doff);
-		n_samples = n_bytes / sizeof(uint16_t);
+static void do_volume(struct impl *this, struct spa_buffer *dbuf, struct spa_buffer *sbuf)
+{
+	uint32_t i, n_bytes;
+	struct spa_data *sd, *dd;
+	void *src, *dst;
 
-		for (i = 0; i < n_samples; i++)
-			*src++ = *dst++ * volume;
+	for (i = 0; i < sbuf->n_datas && i < dbuf->n_datas; i++) {
+		sd = &sbuf->datas[i];
+		dd = &dbuf->datas[i];
 
-		soff += n_bytes;
-		doff += n_bytes;
+		src = SPA_MEMBER(sd->data, sd->chunk->offset, void);
+		n_bytes = sd->chunk->size;
 
-		if (soff >= sd->chunk->size) {
-			si++;
-			soff = 0;
-		}
-		if (doff >= dd->chunk->size) {
-			di++;
-			doff = 0;
+		if (dbuf == sbuf) {
+			dst = src;
+		} else {
+			dst = dd->data;
+			n_bytes = SPA_MIN(n_bytes, dd->maxsize);
+			dd->chunk->offset = 0;
+			dd->chunk->size = n_bytes;
+			dd->chunk->stride = sd->chunk->stride;
 		}
+		apply_volume(this, dst, src, n_bytes / this->bpf);
 	}
 }
 
@@ -719,6 +935,8 @@ static int impl_node_process_input(struct spa_node *node)
 
 	this = SPA_CONTAINER_OF(node, struct impl, node);
 
+	apply_staged_props(this);
+
 	out_port = &this->out_ports[0];
 	output = out_port->io;
 	spa_return_val_if_fail(output != NULL, SPA_RESULT_ERROR);
@@ -734,6 +952,21 @@ static int impl_node_process_input(struct spa_node *node)
 	if (input->buffer_id >= in_port->n_buffers)
 		return SPA_RESULT_NEED_BUFFER;
 
+	if (this->in_place) {
+		/* the output buffer is the input buffer, keep the input buffer
+		 * until the output buffer is recycled */
+		sbuf = in_port->buffers[input->buffer_id].outbuf;
+
+		do_volume(this, sbuf, sbuf);
+
+		output->buffer_id = input->buffer_id;
+		output->status = SPA_RESULT_HAVE_BUFFER;
+		input->buffer_id = SPA_ID_INVALID;
+		input->status = SPA_RESULT_NEED_BUFFER;
+
+		return SPA_RESULT_HAVE_BUFFER;
+	}
+
 	if ((dbuf = find_free_buffer(this, out_port)) == NULL)
 		return SPA_RESULT_OUT_OF_BUFFERS;
 
@@ -741,7 +974,7 @@ static int impl_node_process_input(struct spa_node *node)
 
 	input->status = SPA_RESULT_NEED_BUFFER;
 
-	do_volume(this, sbuf, dbuf);
+	do_volume(this, dbuf, sbuf);
 
 	output->buffer_id = dbuf->id;
 	output->status = SPA_RESULT_HAVE_BUFFER;
@@ -766,16 +999,19 @@ static int impl_node_process_output(struct spa_node *node)
 	if (output->status == SPA_RESULT_HAVE_BUFFER)
 		return SPA_RESULT_HAVE_BUFFER;
 
-	/* recycle */
-	if (output->buffer_id < out_port->n_buffers) {
-		recycle_buffer(this, output->buffer_id);
-		output->buffer_id = SPA_ID_INVALID;
-	}
-
 	in_port = &this->in_ports[0];
 	input = in_port->io;
 	spa_return_val_if_fail(input != NULL, SPA_RESULT_ERROR);
 
+	/* recycle, in place buffers go back to the input */
+	if (output->buffer_id < out_port->n_buffers) {
+		if (this->in_place)
+			input->buffer_id = output->buffer_id;
+		else
+			recycle_buffer(this, output->buffer_id);
+		output->buffer_id = SPA_ID_INVALID;
+	}
+
 	input->range = output->range;
 	input->status = SPA_RESULT_NEED_BUFFER;
 
@@ -861,10 +1097,12 @@ impl_init(const struct spa_handle_factory *factory,
 	init_type(&this->type, this->map);
 
 	this->node = impl_node;
-	reset_props(&this->props);
+	reset_props(this, &this->props);
+	spa_volume_init_ops(&this->ops, spa_volume_get_cpu_flags());
 
 	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
-	    SPA_PORT_INFO_FLAG_IN_PLACE;
+	    SPA_PORT_INFO_FLAG_IN_PLACE |
+	    SPA_PORT_INFO_FLAG_SHARE_BUFFERS;
 	spa_list_init(&this->in_ports[0].empty);
 
 	this->out_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
@@ -0,0 +1,826 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the throughput of the mixing and volume functions for each
+ * cpu level, format, channel count, period size and number of inputs,
+ * first on the bare functions and then for complete cycles of the
+ * audiomixer node, scheduled with spa_graph between dummy sources and
+ * a dummy sink.
+ *
+ * For each case the time of one period is printed together with the
+ * number of samples per second, counting the samples of all inputs. */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include <spa/node.h>
+#include <spa/log.h>
+#include <spa/log-impl.h>
+#include <spa/graph.h>
+#include <spa/graph-scheduler1.h>
+#include <spa/type-map.h>
+#include <spa/type-map-impl.h>
+#include <spa/audio/format-utils.h>
+#include <spa/format-utils.h>
+#include <spa/format-builder.h>
+
+#include <plugins/audiomixer/conv.h>
+#include <plugins/volume/volume-ops.h>
+
+#define MAX_INPUTS	16
+#define MAX_CHANNELS	8
+#define MAX_PERIOD	1024
+#define MAX_BYTES	(MAX_PERIOD * MAX_CHANNELS * 8)
+#define N_BUFFERS	2
+/* the node gets N_BUFFERS periods from each block */
+#define BLOCK_SIZE	(MAX_BYTES * N_BUFFERS)
+
+#define DEFAULT_MIXER	"build/spa/plugins/audiomixer/libspa-audiomixer.so"
+#define DEFAULT_TIME	10
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+static SPA_LOG_IMPL(default_log);
+
+static const char *conv_names[] = { "s16", "f32", "s24_32", "s32", "f64" };
+static const int conv_sizes[] = { 2, 4, 4, 4, 8 };
+
+static const char *volume_names[] = { "s16", "s32", "f32" };
+static const int volume_sizes[] = { 2, 4, 4 };
+
+static const uint32_t channel_counts[] = { 1, 2, 6, 8 };
+static const uint32_t period_sizes[] = { 64, 256, 1024 };
+static const uint32_t input_counts[] = { 1, 2, 4, 8, 16 };
+
+struct type {
+	uint32_t node;
+	uint32_t format;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+}
+
+struct buffer {
+	struct spa_buffer buffer;
+	struct spa_meta metas[1];
+	struct spa_meta_header header;
+	struct spa_data datas[1];
+	struct spa_chunk chunks[1];
+};
+
+/* a source that hands out its buffers in turn */
+struct source {
+	struct spa_node node;
+	struct spa_graph_node graph_node;
+	struct spa_graph_port graph_out;
+	struct spa_graph_port graph_mix_in;
+	struct spa_port_io io;
+	struct spa_buffer *buffers[N_BUFFERS];
+	struct buffer buffer[N_BUFFERS];
+	uint32_t next;
+};
+
+/* a sink that takes the mixed buffer and gives it back on the next cycle */
+struct sink {
+	struct spa_node node;
+	struct spa_graph_node graph_node;
+	struct spa_graph_port graph_in;
+	struct spa_port_io io;
+	uint64_t cycles;
+};
+
+struct run;
+typedef void (*run_func_t) (struct run *r);
+
+struct run {
+	run_func_t func;
+	union {
+		mix_func_t mix;
+		mix_scale_func_t mix_scale;
+		mix_n_func_t mix_n;
+		volume_func_t volume;
+		volume_ramp_func_t ramp;
+	} f;
+	void *dst;
+	const void *src[MAX_INPUTS];
+	float gain[MAX_INPUTS];
+	float gains[MAX_CHANNELS];
+	float steps[MAX_CHANNELS];
+	uint32_t n_src;
+	uint32_t n_channels;
+	uint32_t n_frames;
+	int n_bytes;
+	int16_t scale_s16;
+	float scale_f32;
+	const void *scale;
+	struct data *data;
+};
+
+struct data {
+	struct spa_type_map *map;
+	struct spa_log *log;
+	struct type type;
+
+	struct spa_support support[2];
+	uint32_t n_support;
+
+	uint64_t min_time;
+	int format;
+	uint32_t channels;
+	uint32_t period;
+	uint32_t inputs;
+	bool kernels;
+	bool graph;
+	const char *mixer_lib;
+	spa_handle_factory_enum_func_t enum_func;
+
+	uint8_t *dst;
+	uint8_t *src[MAX_INPUTS];
+
+	struct spa_graph graph_;
+	struct spa_graph_data graph_data;
+	struct spa_graph_node mix_node;
+	struct spa_graph_port mix_out;
+	struct spa_node *mix;
+	struct spa_buffer *mix_buffers[N_BUFFERS];
+	struct buffer mix_buffer[N_BUFFERS];
+	struct source sources[MAX_INPUTS];
+	struct sink sink;
+};
+
+static uint64_t get_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_TIME(&now);
+}
+
+/* run @r until it took at least the minimum time and return the time of
+ * one run in nanoseconds */
+static double measure(struct data *data, struct run *r)
+{
+	uint64_t start, elapsed;
+	uint32_t i, n = 1;
+
+	r->func(r);
+
+	while (true) {
+		start = get_time();
+		for (i = 0; i < n; i++)
+			r->func(r);
+		elapsed = get_time() - start;
+
+		if (elapsed >= data->min_time)
+			break;
+		if (elapsed < data->min_time / 16)
+			n *= 16;
+		else
+			n = n * (data->min_time / elapsed + 1);
+	}
+	return (double) elapsed / n;
+}
+
+static void report(const char *level, const char *func, const char *format,
+		   uint32_t channels, uint32_t period, uint32_t inputs, double ns)
+{
+	printf("%-5s %-10s %-7s %u ch %5u frames %2u in: %10.1f ns/period %9.1f Msamples/s\n",
+	       level, func, format, channels, period, inputs, ns,
+	       (double) channels * period * inputs * 1000.0 / ns);
+}
+
+static void run_mix(struct run *r)
+{
+	r->f.mix(r->dst, r->src[0], r->n_bytes);
+}
+
+static void run_mix_scale(struct run *r)
+{
+	r->f.mix_scale(r->dst, r->src[0], r->scale, r->n_bytes);
+}
+
+static void run_mix_n(struct run *r)
+{
+	r->f.mix_n(r->dst, r->src, r->gain, r->n_src, r->n_bytes);
+}
+
+static void run_volume(struct run *r)
+{
+	r->f.volume(r->dst, r->src[0], r->gains, r->n_channels, r->n_frames);
+}
+
+static void run_ramp(struct run *r)
+{
+	/* the steps are neutral so that the gains stay the same on each run */
+	r->f.ramp(r->dst, r->src[0], r->gains, r->steps, false, r->n_channels, r->n_frames);
+}
+
+static void fill_data(struct data *data, int size)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < MAX_INPUTS; i++) {
+		for (j = 0; j < BLOCK_SIZE / size; j++) {
+			switch (size) {
+			case 2:
+				((int16_t *) data->src[i])[j] = (rand() % 8192) - 4096;
+				break;
+			case 4:
+				((int32_t *) data->src[i])[j] = (rand() % 8192) - 4096;
+				break;
+			case 8:
+				((int64_t *) data->src[i])[j] = (rand() % 8192) - 4096;
+				break;
+			}
+		}
+	}
+	memset(data->dst, 0, BLOCK_SIZE);
+}
+
+/* float formats are filled with float values to avoid denormals */
+static void fill_float(struct data *data, int conv)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < MAX_INPUTS; i++) {
+		for (j = 0; j < BLOCK_SIZE / conv_sizes[conv]; j++) {
+			float v = (rand() % 8192 - 4096) / 8192.0f;
+			if (conv == CONV_F64_F64)
+				((double *) data->src[i])[j] = v;
+			else
+				((float *) data->src[i])[j] = v;
+		}
+	}
+	memset(data->dst, 0, BLOCK_SIZE);
+}
+
+static const char *mixer_level_name(uint32_t flags)
+{
+	if (flags & SPA_AUDIOMIXER_CPU_AVX2)
+		return "avx2";
+	if (flags & SPA_AUDIOMIXER_CPU_SSE2)
+		return "sse2";
+	return "c";
+}
+
+static void bench_mixer_ops(struct data *data, uint32_t flags)
+{
+	struct spa_audiomixer_ops ops;
+	struct run r = { NULL, };
+	const char *level = mixer_level_name(flags);
+	int conv;
+	uint32_t c, p, n, i;
+
+	spa_audiomixer_init_ops(&ops, flags);
+
+	r.dst = data->dst;
+	r.scale_s16 = 1 << 14;
+	r.scale_f32 = 0.5f;
+	for (i = 0; i < MAX_INPUTS; i++) {
+		r.src[i] = data->src[i];
+		r.gain[i] = 0.5f;
+	}
+
+	for (conv = 0; conv < CONV_MAX; conv++) {
+		if (data->format != -1 && data->format != conv)
+			continue;
+
+		if (conv == CONV_F32_F32 || conv == CONV_F64_F64)
+			fill_float(data, conv);
+		else
+			fill_data(data, conv_sizes[conv]);
+
+		r.scale = conv == CONV_S16_S16 ? (const void *) &r.scale_s16 : &r.scale_f32;
+
+		for (c = 0; c < SPA_N_ELEMENTS(channel_counts); c++) {
+			if (data->channels && data->channels != channel_counts[c])
+				continue;
+
+			for (p = 0; p < SPA_N_ELEMENTS(period_sizes); p++) {
+				uint32_t frames = period_sizes[p], channels = channel_counts[c];
+
+				if (data->period && data->period != frames)
+					continue;
+
+				r.n_bytes = frames * channels * conv_sizes[conv];
+
+				if (data->inputs == 0 || data->inputs == 1) {
+					r.func = run_mix;
+					r.f.mix = ops.copy[conv];
+					report(level, "copy", conv_names[conv], channels, frames, 1,
+					       measure(data, &r));
+					r.f.mix = ops.add[conv];
+					report(level, "add", conv_names[conv], channels, frames, 1,
+					       measure(data, &r));
+
+					r.func = run_mix_scale;
+					if ((r.f.mix_scale = ops.copy_scale[conv]))
+						report(level, "copy_scale", conv_names[conv], channels,
+						       frames, 1, measure(data, &r));
+					if ((r.f.mix_scale = ops.add_scale[conv]))
+						report(level, "add_scale", conv_names[conv], channels,
+						       frames, 1, measure(data, &r));
+				}
+
+				r.func = run_mix_n;
+				r.f.mix_n = ops.mix_n[conv];
+				for (n = 0; n < SPA_N_ELEMENTS(input_counts); n++) {
+					if (data->inputs && data->inputs != input_counts[n])
+						continue;
+
+					r.n_src = input_counts[n];
+					report(level, "mix_n", conv_names[conv], channels, frames,
+					       r.n_src, measure(data, &r));
+				}
+			}
+		}
+	}
+}
+
+static void bench_volume_ops(struct data *data, uint32_t flags)
+{
+	struct spa_volume_ops ops;
+	struct run r = { NULL, };
+	const char *level = flags & SPA_VOLUME_CPU_SSE2 ? "sse2" : "c";
+	int fmt;
+	uint32_t c, p, i;
+
+	spa_volume_init_ops(&ops, flags);
+
+	r.dst = data->dst;
+	r.src[0] = data->src[0];
+	for (i = 0; i < MAX_CHANNELS; i++) {
+		r.gains[i] = 0.5f + i * 0.05f;
+		r.steps[i] = 0.0f;
+	}
+
+	for (fmt = 0; fmt < VOLUME_MAX; fmt++) {
+		if (data->format != -1 &&
+		    strcmp(conv_names[data->format], volume_names[fmt]))
+			continue;
+
+		if (fmt == VOLUME_F32)
+			fill_float(data, CONV_F32_F32);
+		else
+			fill_data(data, volume_sizes[fmt]);
+
+		for (c = 0; c < SPA_N_ELEMENTS(channel_counts); c++) {
+			if (data->channels && data->channels != channel_counts[c])
+				continue;
+
+			for (p = 0; p < SPA_N_ELEMENTS(period_sizes); p++) {
+				if (data->period && data->period != period_sizes[p])
+					continue;
+
+				r.n_channels = channel_counts[c];
+				r.n_frames = period_sizes[p];
+
+				r.func = run_volume;
+				r.f.volume = ops.volume[fmt];
+				report(level, "volume", volume_names[fmt], r.n_channels, r.n_frames, 1,
+				       measure(data, &r));
+
+				r.func = run_ramp;
+				r.f.ramp = ops.ramp[fmt];
+				report(level, "ramp", volume_names[fmt], r.n_channels, r.n_frames, 1,
+				       measure(data, &r));
+			}
+		}
+	}
+}
+
+static int source_process_output(struct spa_node *node)
+{
+	struct source *s = SPA_CONTAINER_OF(node, struct source, node);
+
+	s->io.buffer_id = s->next;
+	s->io.status = SPA_RESULT_HAVE_BUFFER;
+	s->next = (s->next + 1) % N_BUFFERS;
+
+	return SPA_RESULT_HAVE_BUFFER;
+}
+
+static int sink_process_input(struct spa_node *node)
+{
+	struct sink *s = SPA_CONTAINER_OF(node, struct sink, node);
+
+	/* keep the buffer id, the mixer recycles it in process_output */
+	s->io.status = SPA_RESULT_NEED_BUFFER;
+	s->cycles++;
+
+	return SPA_RESULT_NEED_BUFFER;
+}
+
+static const struct spa_node source_node = {
+	SPA_VERSION_NODE,
+	.process_output = source_process_output,
+};
+
+static const struct spa_node sink_node = {
+	SPA_VERSION_NODE,
+	.process_input = sink_process_input,
+};
+
+static void
+init_buffer(struct data *data, struct spa_buffer **bufs, struct buffer *ba, int n_buffers,
+	    uint8_t *mem, size_t size)
+{
+	int i;
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = &ba[i];
+		bufs[i] = &b->buffer;
+
+		b->buffer.id = i;
+		b->buffer.n_metas = 1;
+		b->buffer.metas = b->metas;
+		b->buffer.n_datas = 1;
+		b->buffer.datas = b->datas;
+
+		b->header.flags = 0;
+		b->header.seq = 0;
+		b->header.pts = 0;
+		b->header.dts_offset = 0;
+		b->metas[0].type = data->type.meta.Header;
+		b->metas[0].data = &b->header;
+		b->metas[0].size = sizeof(b->header);
+
+		b->datas[0].type = data->type.data.MemPtr;
+		b->datas[0].flags = 0;
+		b->datas[0].fd = -1;
+		b->datas[0].mapoffset = 0;
+		b->datas[0].maxsize = size;
+		b->datas[0].data = mem + i * size;
+		b->datas[0].chunk = &b->chunks[0];
+		b->datas[0].chunk->offset = 0;
+		b->datas[0].chunk->size = size;
+		b->datas[0].chunk->stride = 0;
+	}
+}
+
+static int make_mixer(struct data *data, struct spa_handle **handle)
+{
+	int res;
+	void *hnd;
+	uint32_t i;
+
+	if (data->enum_func == NULL) {
+		if ((hnd = dlopen(data->mixer_lib, RTLD_NOW)) == NULL) {
+			printf("can't load %s: %s\n", data->mixer_lib, dlerror());
+			return SPA_RESULT_ERROR;
+		}
+		if ((data->enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+			printf("can't find enum function\n");
+			return SPA_RESULT_ERROR;
+		}
+	}
+
+	for (i = 0;; i++) {
+		const struct spa_handle_factory *factory;
+		void *iface;
+
+		if ((res = data->enum_func(&factory, i)) < 0) {
+			if (res != SPA_RESULT_ENUM_END)
+				printf("can't enumerate factories: %d\n", res);
+			break;
+		}
+		if (strcmp(factory->name, "audiomixer"))
+			continue;
+
+		*handle = calloc(1, factory->size);
+		if ((res = spa_handle_factory_init(factory, *handle, NULL, data->support,
+						   data->n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			free(*handle);
+			return res;
+		}
+		if ((res = spa_handle_get_interface(*handle, data->type.node, &iface)) < 0) {
+			printf("can't get interface %d\n", res);
+			spa_handle_clear(*handle);
+			free(*handle);
+			return res;
+		}
+		data->mix = iface;
+		return SPA_RESULT_OK;
+	}
+	return SPA_RESULT_ERROR;
+}
+
+static int setup_graph(struct data *data, int conv, uint32_t channels, uint32_t frames,
+		       uint32_t inputs)
+{
+	struct spa_format *format;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+	uint8_t buffer[256];
+	size_t size = frames * channels * conv_sizes[conv];
+	uint32_t i;
+	int res;
+	uint32_t formats[] = {
+		data->type.audio_format.S16,
+		data->type.audio_format.F32,
+		data->type.audio_format.S24_32,
+		data->type.audio_format.S32,
+		data->type.audio_format.F64,
+	};
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	spa_pod_builder_format(&b, &f[0], data->type.format,
+		data->type.media_type.audio,
+		data->type.media_subtype.raw,
+		SPA_POD_PROP(&f[1], data->type.format_audio.format, 0, SPA_POD_TYPE_ID, 1,
+			formats[conv]),
+		SPA_POD_PROP(&f[1], data->type.format_audio.layout, 0, SPA_POD_TYPE_INT, 1,
+			SPA_AUDIO_LAYOUT_INTERLEAVED),
+		SPA_POD_PROP(&f[1], data->type.format_audio.rate, 0, SPA_POD_TYPE_INT, 1,
+			48000),
+		SPA_POD_PROP(&f[1], data->type.format_audio.channels, 0, SPA_POD_TYPE_INT, 1,
+			channels));
+	format = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+
+	spa_graph_init(&data->graph_);
+	spa_graph_data_init(&data->graph_data, &data->graph_);
+	spa_graph_set_callbacks(&data->graph_, &spa_graph_impl_default, &data->graph_data);
+
+	data->sink.node = sink_node;
+	data->sink.io = SPA_PORT_IO_INIT;
+	data->sink.cycles = 0;
+
+	if ((res = spa_node_port_set_format(data->mix, SPA_DIRECTION_OUTPUT, 0, 0, format)) < 0)
+		return res;
+	init_buffer(data, data->mix_buffers, data->mix_buffer, N_BUFFERS, data->dst, size);
+	if ((res = spa_node_port_use_buffers(data->mix, SPA_DIRECTION_OUTPUT, 0,
+					     data->mix_buffers, N_BUFFERS)) < 0)
+		return res;
+	spa_node_port_set_io(data->mix, SPA_DIRECTION_OUTPUT, 0, &data->sink.io);
+
+	spa_graph_node_init(&data->mix_node);
+	spa_graph_node_set_implementation(&data->mix_node, data->mix);
+	spa_graph_node_add(&data->graph_, &data->mix_node);
+	spa_graph_port_init(&data->mix_out, SPA_DIRECTION_OUTPUT, 0, 0, &data->sink.io);
+	spa_graph_port_add(&data->mix_node, &data->mix_out);
+
+	spa_graph_node_init(&data->sink.graph_node);
+	spa_graph_node_set_implementation(&data->sink.graph_node, &data->sink.node);
+	spa_graph_node_add(&data->graph_, &data->sink.graph_node);
+	spa_graph_port_init(&data->sink.graph_in, SPA_DIRECTION_INPUT, 0, 0, &data->sink.io);
+	spa_graph_port_add(&data->sink.graph_node, &data->sink.graph_in);
+	spa_graph_port_link(&data->mix_out, &data->sink.graph_in);
+
+	for (i = 0; i < inputs; i++) {
+		struct source *s = &data->sources[i];
+
+		s->node = source_node;
+		s->io = SPA_PORT_IO_INIT;
+		s->next = 0;
+
+		if ((res = spa_node_add_port(data->mix, SPA_DIRECTION_INPUT, i)) < 0)
+			return res;
+		if ((res = spa_node_port_set_format(data->mix, SPA_DIRECTION_INPUT, i, 0,
+						    format)) < 0)
+			return res;
+		init_buffer(data, s->buffers, s->buffer, N_BUFFERS, data->src[i], size);
+		if ((res = spa_node_port_use_buffers(data->mix, SPA_DIRECTION_INPUT, i,
+						     s->buffers, N_BUFFERS)) < 0)
+			return res;
+		spa_node_port_set_io(data->mix, SPA_DIRECTION_INPUT, i, &s->io);
+
+		spa_graph_node_init(&s->graph_node);
+		spa_graph_node_set_implementation(&s->graph_node, &s->node);
+		spa_graph_node_add(&data->graph_, &s->graph_node);
+		spa_graph_port_init(&s->graph_out, SPA_DIRECTION_OUTPUT, 0, 0, &s->io);
+		spa_graph_port_add(&s->graph_node, &s->graph_out);
+
+		spa_graph_port_init(&s->graph_mix_in, SPA_DIRECTION_INPUT, i, 0, &s->io);
+		spa_graph_port_add(&data->mix_node, &s->graph_mix_in);
+		spa_graph_port_link(&s->graph_out, &s->graph_mix_in);
+	}
+	return SPA_RESULT_OK;
+}
+
+static void run_graph(struct run *r)
+{
+	struct data *data = r->data;
+	spa_graph_need_input(&data->graph_, &data->sink.graph_node);
+}
+
+static void bench_graph(struct data *data)
+{
+	struct run r = { NULL, };
+	struct spa_handle *handle;
+	int conv, res;
+	uint32_t c, p, n;
+
+	r.func = run_graph;
+	r.data = data;
+
+	for (conv = 0; conv < CONV_MAX; conv++) {
+		if (data->format != -1 && data->format != conv)
+			continue;
+
+		if (conv == CONV_F32_F32 || conv == CONV_F64_F64)
+			fill_float(data, conv);
+		else
+			fill_data(data, conv_sizes[conv]);
+
+		for (c = 0; c < SPA_N_ELEMENTS(channel_counts); c++) {
+			if (data->channels && data->channels != channel_counts[c])
+				continue;
+
+			for (p = 0; p < SPA_N_ELEMENTS(period_sizes); p++) {
+				if (data->period && data->period != period_sizes[p])
+					continue;
+
+				for (n = 0; n < SPA_N_ELEMENTS(input_counts); n++) {
+					uint32_t channels = channel_counts[c];
+					uint32_t frames = period_sizes[p];
+					uint32_t inputs = input_counts[n];
+
+					if (data->inputs && data->inputs != inputs)
+						continue;
+
+					if (make_mixer(data, &handle) < 0)
+						return;
+
+					if ((res = setup_graph(data, conv, channels, frames,
+							       inputs)) < 0) {
+						printf("can't setup graph: %d\n", res);
+					} else {
+						/* one cycle must reach the sink */
+						run_graph(&r);
+						if (data->sink.cycles != 1)
+							printf("graph %s %u ch %u frames %u in: "
+							       "no output\n", conv_names[conv],
+							       channels, frames, inputs);
+						else
+							report("node", "audiomixer",
+							       conv_names[conv], channels, frames,
+							       inputs, measure(data, &r));
+					}
+					spa_handle_clear(handle);
+					free(handle);
+				}
+			}
+		}
+	}
+}
+
+static int find_format(const char *name)
+{
+	int i;
+
+	for (i = 0; i < CONV_MAX; i++) {
+		if (strcmp(conv_names[i], name) == 0)
+			return i;
+	}
+	return -1;
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [options]\n"
+	       "  -t <msec>     minimum time of each measurement (default %d)\n"
+	       "  -f <format>   only this format (s16, f32, s24_32, s32, f64)\n"
+	       "  -c <count>    only this number of channels (1, 2, 6, 8)\n"
+	       "  -p <frames>   only this period size (64, 256, 1024)\n"
+	       "  -n <count>    only this number of inputs (1, 2, 4, 8, 16)\n"
+	       "  -k            only the functions, not the node\n"
+	       "  -g            only the node, not the functions\n"
+	       "  -m <path>     the audiomixer plugin (default %s)\n",
+	       name, DEFAULT_TIME, DEFAULT_MIXER);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { NULL, };
+	uint32_t flags, f;
+	const char *str;
+	int opt, i;
+
+	data.map = &default_map.map;
+	data.log = &default_log.log;
+	data.min_time = DEFAULT_TIME * SPA_NSEC_PER_MSEC;
+	data.format = -1;
+	data.kernels = data.graph = true;
+	data.mixer_lib = DEFAULT_MIXER;
+
+	while ((opt = getopt(argc, argv, "t:f:c:p:n:kgm:h")) != -1) {
+		switch (opt) {
+		case 't':
+			data.min_time = atoi(optarg) * SPA_NSEC_PER_MSEC;
+			break;
+		case 'f':
+			if ((data.format = find_format(optarg)) < 0) {
+				printf("unknown format %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'c':
+			data.channels = atoi(optarg);
+			break;
+		case 'p':
+			data.period = atoi(optarg);
+			break;
+		case 'n':
+			data.inputs = atoi(optarg);
+			break;
+		case 'k':
+			data.graph = false;
+			break;
+		case 'g':
+			data.kernels = false;
+			break;
+		case 'm':
+			data.mixer_lib = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	data.log->level = SPA_LOG_LEVEL_WARN;
+	if ((str = getenv("SPA_DEBUG")))
+		data.log->level = atoi(str);
+
+	data.support[0].type = SPA_TYPE__TypeMap;
+	data.support[0].data = data.map;
+	data.support[1].type = SPA_TYPE__Log;
+	data.support[1].data = data.log;
+	data.n_support = 2;
+
+	init_type(&data.type, data.map);
+
+	if (posix_memalign((void **) &data.dst, 32, BLOCK_SIZE) != 0)
+		return EXIT_FAILURE;
+	for (i = 0; i < MAX_INPUTS; i++) {
+		if (posix_memalign((void **) &data.src[i], 32, BLOCK_SIZE) != 0)
+			return EXIT_FAILURE;
+	}
+
+	if (data.kernels) {
+		/* each vector level that was compiled in and that the cpu has */
+		flags = spa_audiomixer_get_cpu_flags();
+#if !defined(HAVE_SSE2)
+		flags &= ~SPA_AUDIOMIXER_CPU_SSE2;
+#endif
+#if !defined(HAVE_AVX2)
+		flags &= ~SPA_AUDIOMIXER_CPU_AVX2;
+#endif
+		for (f = 0;; f = (f << 1) | 1) {
+			bench_mixer_ops(&data, flags & f);
+			if ((flags & f) == flags)
+				break;
+		}
+
+		flags = spa_volume_get_cpu_flags();
+#if !defined(HAVE_SSE2)
+		flags &= ~SPA_VOLUME_CPU_SSE2;
+#endif
+		bench_volume_ops(&data, 0);
+		if (flags & SPA_VOLUME_CPU_SSE2)
+			bench_volume_ops(&data, SPA_VOLUME_CPU_SSE2);
+	}
+	if (data.graph)
+		bench_graph(&data);
+
+	for (i = 0; i < MAX_INPUTS; i++)
+		free(data.src[i]);
+	free(data.dst);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <spa/defs.h>
+
+#include <plugins/audiomixer/conv.h>
+
+#define MAX_SAMPLES	1024
+#define MAX_OFFSET	16
+
+#define MAX_SIZE	((MAX_SAMPLES + MAX_OFFSET) * 8)
+
+static uint8_t src[MAX_SIZE] SPA_ALIGNED(32);
+static uint8_t ref[MAX_SIZE] SPA_ALIGNED(32);
+static uint8_t dst[MAX_SIZE] SPA_ALIGNED(32);
+static uint8_t init[MAX_SIZE] SPA_ALIGNED(32);
+
+static const char *conv_names[] = { "s16", "f32", "s24_32", "s32", "f64" };
+static const int conv_sizes[] = { 2, 4, 4, 4, 8 };
+
+static void fill(int conv)
+{
+	int i;
+
+	for (i = 0; i < MAX_SAMPLES + MAX_OFFSET; i++) {
+		switch (conv) {
+		case CONV_S16_S16:
+			/* make sure saturation happens */
+			((int16_t *) src)[i] = (i % 7) == 0 ? INT16_MAX : (i % 11) == 0 ? INT16_MIN : rand();
+			((int16_t *) init)[i] = (i % 5) == 0 ? INT16_MAX - 3 : rand();
+			break;
+		case CONV_S24_32_S24_32:
+			((int32_t *) src)[i] = (i % 7) == 0 ? 8388607 : (rand() % 16777216) - 8388608;
+			((int32_t *) init)[i] = (rand() % 16777216) - 8388608;
+			break;
+		case CONV_S32_S32:
+			((int32_t *) src)[i] = (i % 7) == 0 ? INT32_MAX : (i % 11) == 0 ? INT32_MIN :
+					       rand() - RAND_MAX / 2;
+			((int32_t *) init)[i] = rand() - RAND_MAX / 2;
+			break;
+		case CONV_F32_F32:
+			((float *) src)[i] = (rand() / (float) RAND_MAX) * 2.0f - 1.0f;
+			((float *) init)[i] = (rand() / (float) RAND_MAX) * 2.0f - 1.0f;
+			break;
+		case CONV_F64_F64:
+			((double *) src)[i] = (rand() / (double) RAND_MAX) * 2.0 - 1.0;
+			((double *) init)[i] = (rand() / (double) RAND_MAX) * 2.0 - 1.0;
+			break;
+		}
+	}
+}
+
+static int compare(const char *name, int conv, int doff, int soff, int n_bytes)
+{
+	if (memcmp(SPA_MEMBER(ref, doff, void), SPA_MEMBER(dst, doff, void), n_bytes) == 0)
+		return 0;
+
+	fprintf(stderr, "%s %s: mismatch at dst offset %d, src offset %d, %d bytes\n",
+		name, conv_names[conv], doff, soff, n_bytes);
+	return 1;
+}
+
+static int test_ops(const struct spa_audiomixer_ops *c, const struct spa_audiomixer_ops *ops)
+{
+	int conv, doff, soff, n, i, errors = 0, size;
+	int16_t scales_s16[] = { INT16_MIN, -1, 0, 1, 12345, INT16_MAX };
+	float scales_f32[] = { -1.0f, 0.0f, 0.5f, 1.0f, 1.7f };
+	float gains[] = { 1.0f, 0.5f, -1.7f, 3.0f };
+
+	for (conv = 0; conv < CONV_MAX; conv++) {
+		size = conv_sizes[conv];
+		fill(conv);
+
+		for (doff = 0; doff < MAX_OFFSET; doff++)
+		for (soff = 0; soff < MAX_OFFSET; soff++)
+		for (n = 0; n < MAX_SAMPLES; n = n < 80 ? n + 1 : n * 2 + 3) {
+			void *d = SPA_MEMBER(dst, doff * size, void);
+			void *r = SPA_MEMBER(ref, doff * size, void);
+			const void *s = SPA_MEMBER(src, soff * size, void);
+			int n_bytes = n * size;
+
+#define CHECK(func, ...)							\
+			if (c->func[conv] == NULL)				\
+				continue;					\
+			memcpy(ref, init, sizeof(ref));				\
+			memcpy(dst, init, sizeof(dst));				\
+			c->func[conv](r, s, ##__VA_ARGS__, n_bytes);		\
+			ops->func[conv](d, s, ##__VA_ARGS__, n_bytes);		\
+			errors += compare(#func, conv, doff * size, soff * size, n_bytes);
+
+			CHECK(copy);
+			CHECK(add);
+
+			for (i = 0; i < (conv == CONV_S16_S16 ? SPA_N_ELEMENTS(scales_s16) :
+							       SPA_N_ELEMENTS(scales_f32)); i++) {
+				const void *scale = conv == CONV_S16_S16 ?
+					(const void *) &scales_s16[i] : (const void *) &scales_f32[i];
+				CHECK(copy_scale, scale);
+				CHECK(add_scale, scale);
+			}
+#undef CHECK
+			if (c->mix_n[conv] == NULL)
+				continue;
+			/* sources at other alignments and with gains that
+			 * saturate */
+			for (i = 0; i <= SPA_N_ELEMENTS(gains); i++) {
+				const void *srcs[] = { s, SPA_MEMBER(init, soff * size, void),
+						       SPA_MEMBER(src, 3 * size, void),
+						       SPA_MEMBER(init, size, void) };
+
+				memcpy(ref, init, sizeof(ref));
+				memcpy(dst, init, sizeof(dst));
+				c->mix_n[conv](r, srcs, gains, i, n_bytes);
+				ops->mix_n[conv](d, srcs, gains, i, n_bytes);
+				errors += compare("mix_n", conv, doff * size, soff * size, n_bytes);
+			}
+		}
+	}
+	return errors;
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_audiomixer_ops c, ops;
+	uint32_t flags = spa_audiomixer_get_cpu_flags(), f;
+	int errors = 0;
+
+	spa_audiomixer_init_ops(&c, 0);
+
+	/* compare each vector level against the plain C functions */
+	for (f = 1;; f = (f << 1) | 1) {
+		spa_audiomixer_init_ops(&ops, flags & f);
+		errors += test_ops(&c, &ops);
+		printf("cpu flags 0x%08x: %s\n", flags & f, errors ? "FAILED" : "ok");
+		if ((flags & f) == flags)
+			break;
+	}
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <spa/defs.h>
+
+#include <plugins/audioconvert/resample.h>
+
+#define MAX_TAPS	256
+#define N_IN		8192
+#define N_OUT		(N_IN * 2)
+#define FREQ		5000.0
+
+static float samples[MAX_TAPS + 8] SPA_ALIGNED(32);
+static float taps0[MAX_TAPS] SPA_ALIGNED(32);
+static float taps1[MAX_TAPS] SPA_ALIGNED(32);
+
+static float in[N_IN];
+static float out[N_OUT];
+
+static inline float frand(void)
+{
+	return (rand() / (float) RAND_MAX) * 2.0f - 1.0f;
+}
+
+/* the vector inner products against the plain C ones, also with
+ * unaligned samples */
+static int test_kernels(uint32_t cpu_flags)
+{
+	inner_product_func_t func = inner_product_c;
+	inner_product_ip_func_t func_ip = inner_product_ip_c;
+	uint32_t i, n_taps, offset;
+	float r, v;
+	int errors = 0;
+
+#if defined(HAVE_SSE)
+	if (cpu_flags & RESAMPLE_CPU_SSE) {
+		func = inner_product_sse;
+		func_ip = inner_product_ip_sse;
+	}
+#endif
+#if defined(HAVE_AVX)
+	if (cpu_flags & RESAMPLE_CPU_AVX) {
+		func = inner_product_avx;
+		func_ip = inner_product_ip_avx;
+	}
+#endif
+	for (i = 0; i < SPA_N_ELEMENTS(samples); i++)
+		samples[i] = frand();
+	for (i = 0; i < MAX_TAPS; i++) {
+		taps0[i] = frand() / MAX_TAPS;
+		taps1[i] = frand() / MAX_TAPS;
+	}
+
+	for (n_taps = 8; n_taps <= MAX_TAPS; n_taps += 8) {
+		for (offset = 0; offset < 8; offset++) {
+			const float *s = &samples[offset];
+
+			inner_product_c(&r, s, taps0, n_taps);
+			func(&v, s, taps0, n_taps);
+			if (fabsf(r - v) > 1e-5f) {
+				fprintf(stderr, "inner_product %d taps, offset %d: %g != %g\n",
+					n_taps, offset, v, r);
+				errors++;
+			}
+			inner_product_ip_c(&r, s, taps0, taps1, 0.3f, n_taps);
+			func_ip(&v, s, taps0, taps1, 0.3f, n_taps);
+			if (fabsf(r - v) > 1e-5f) {
+				fprintf(stderr, "inner_product_ip %d taps, offset %d: %g != %g\n",
+					n_taps, offset, v, r);
+				errors++;
+			}
+		}
+	}
+	return errors;
+}
+
+/* resample a sine and compare with the sine at the positions of the
+ * output frames. The rate is changed so that the filter is interpolated
+ * between the phases */
+static int test_sine(uint32_t cpu_flags, uint32_t i_rate, uint32_t o_rate, double rate)
+{
+	struct resample r;
+	const void *src[1] = { in };
+	void *dst[1] = { out };
+	uint32_t i, in_len = N_IN, out_len = N_OUT, delay;
+	double step, max_err = 0.0;
+
+	spa_zero(r);
+	r.cpu_flags = cpu_flags;
+	r.quality = RESAMPLE_DEFAULT_QUALITY;
+	r.channels = 1;
+	r.i_rate = i_rate;
+	r.o_rate = o_rate;
+	if (resample_init(&r) < 0) {
+		fprintf(stderr, "resample_init %d -> %d failed\n", i_rate, o_rate);
+		return 1;
+	}
+	resample_update_rate(&r, rate);
+
+	for (i = 0; i < N_IN; i++)
+		in[i] = sin(2.0 * M_PI * FREQ * i / i_rate);
+
+	resample_process(&r, src, &in_len, dst, &out_len);
+
+	/* skip the frames that still see the silence before the start */
+	step = (double) i_rate / o_rate * rate;
+	delay = resample_delay(&r);
+	for (i = 0; i < out_len; i++) {
+		double pos = i * step, err;
+
+		if (pos < 2 * delay || pos + 2 * delay >= in_len)
+			continue;
+
+		err = fabs(out[i] - sin(2.0 * M_PI * FREQ * pos / i_rate));
+		max_err = SPA_MAX(max_err, err);
+	}
+	resample_free(&r);
+
+	if (max_err > 1e-4) {
+		fprintf(stderr, "resample %d -> %d rate %f: max error %g\n",
+			i_rate, o_rate, rate, max_err);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t rates[][2] = {
+		{ 48000, 48000 }, { 44100, 48000 }, { 48000, 44100 },
+		{ 32000, 48000 }, { 96000, 48000 },
+	};
+	static const double speeds[] = { 1.0, 1.0001, 0.9997, 1.01 };
+	uint32_t flags = resample_get_cpu_flags(), f, i, j;
+	int errors = 0;
+
+	/* each vector level and the plain C functions */
+	for (f = 0;; f = (f << 1) | 1) {
+		errors += test_kernels(flags & f);
+
+		for (i = 0; i < SPA_N_ELEMENTS(rates); i++)
+			for (j = 0; j < SPA_N_ELEMENTS(speeds); j++)
+				errors += test_sine(flags & f, rates[i][0], rates[i][1], speeds[j]);
+
+		printf("cpu flags 0x%08x: %s\n", flags & f, errors ? "FAILED" : "ok");
+		if ((flags & f) == flags)
+			break;
+	}
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
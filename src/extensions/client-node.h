@@ -40,12 +40,72 @@ struct pw_client_node_proxy;
 
 struct pw_client_node_message;
 
+/** Clock of the driver of the node, written by the server in every cycle.
+ * The fields are protected by \a seq, which is odd while the server is
+ * updating them, so that the client can read them without locking.
+ * \memberof pw_client_node */
+struct pw_client_node_clock {
+	uint32_t seq;			/**< update sequence, 0 when never written */
+	int32_t rate;			/**< rate of the ticks */
+	int64_t ticks;			/**< ticks of the clock at \a monotonic_time */
+	int64_t monotonic_time;		/**< monotonic time in nanoseconds */
+	double rate_diff;		/**< measured rate against the monotonic clock */
+};
+
+#define PW_CLIENT_NODE_CLOCK_MAX_RETRY	64
+
+/** Start an update of \a clock \memberof pw_client_node */
+static inline void pw_client_node_clock_write_begin(struct pw_client_node_clock *clock)
+{
+	__atomic_store_n(&clock->seq, clock->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/** Finish an update of \a clock \memberof pw_client_node */
+static inline void pw_client_node_clock_write_end(struct pw_client_node_clock *clock)
+{
+	__atomic_store_n(&clock->seq, clock->seq + 1, __ATOMIC_RELEASE);
+}
+
+/** Get a consistent copy of \a clock
+ * \return true when \a copy is valid, false when the clock was never written
+ *	or the writer did not finish in time
+ * \memberof pw_client_node */
+static inline bool pw_client_node_clock_read(const struct pw_client_node_clock *clock,
+					     struct pw_client_node_clock *copy)
+{
+	uint32_t seq1, seq2;
+	int retry;
+
+	for (retry = 0; retry < PW_CLIENT_NODE_CLOCK_MAX_RETRY; retry++) {
+		seq1 = __atomic_load_n(&clock->seq, __ATOMIC_ACQUIRE);
+		if (seq1 == 0)
+			return false;
+		if (seq1 & 1)
+			continue;
+
+		copy->rate = clock->rate;
+		copy->ticks = clock->ticks;
+		copy->monotonic_time = clock->monotonic_time;
+		copy->rate_diff = clock->rate_diff;
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		seq2 = __atomic_load_n(&clock->seq, __ATOMIC_RELAXED);
+		if (seq1 == seq2) {
+			copy->seq = seq1;
+			return true;
+		}
+	}
+	return false;
+}
+
 /** Shared structure between client and server \memberof pw_client_node */
 struct pw_client_node_area {
 	uint32_t max_input_ports;	/**< max input ports of the node */
 	uint32_t n_input_ports;		/**< number of input ports of the node */
 	uint32_t max_output_ports;	/**< max output ports of the node */
 	uint32_t n_output_ports;	/**< number of output ports of the node */
+	struct pw_client_node_clock clock;	/**< clock of the driver */
 };
 
 /** \class pw_client_node_transport
@@ -64,6 +64,10 @@ struct pw_protocol_native_ext {
 	void (*end_resource) (struct pw_resource *resource,
 			      struct spa_pod_builder *builder);
 
+	/** memory for a demarshalled event, valid until the next message */
+	void * (*alloc_proxy) (struct pw_proxy *proxy, size_t size);
+	/** memory for a demarshalled method, valid until the next message */
+	void * (*alloc_resource) (struct pw_resource *resource, size_t size);
 };
 
 #define pw_protocol_native_begin_proxy(p,...)		pw_protocol_ext(pw_proxy_get_protocol(p),struct pw_protocol_native_ext,begin_proxy,p,__VA_ARGS__)
@@ -76,6 +80,9 @@ struct pw_protocol_native_ext {
 #define pw_protocol_native_get_resource_fd(r,...)	pw_protocol_ext(pw_resource_get_protocol(r),struct pw_protocol_native_ext,get_resource_fd,r,__VA_ARGS__)
 #define pw_protocol_native_end_resource(r,...)		pw_protocol_ext(pw_resource_get_protocol(r),struct pw_protocol_native_ext,end_resource,r,__VA_ARGS__)
 
+#define pw_protocol_native_alloc_proxy(p,...)		pw_protocol_ext(pw_proxy_get_protocol(p),struct pw_protocol_native_ext,alloc_proxy,p,__VA_ARGS__)
+#define pw_protocol_native_alloc_resource(r,...)	pw_protocol_ext(pw_resource_get_protocol(r),struct pw_protocol_native_ext,alloc_resource,r,__VA_ARGS__)
+
 #ifdef __cplusplus
 }  /* extern "C" */
 #endif
@@ -286,6 +286,12 @@ do_update_port(struct proxy *this,
 		    realloc(port->formats, port->n_formats * sizeof(struct spa_format *));
 		for (i = 0; i < port->n_formats; i++)
 			port->formats[i] = spa_format_copy(possible_formats[i]);
+
+		/* the core enumerates the formats again */
+		if (this->callbacks && this->callbacks->event) {
+			struct spa_event event = SPA_EVENT_INIT(this->impl->t->event_node.PortInfoChanged);
+			this->callbacks->event(this->callbacks_data, &event);
+		}
 	}
 	if (change_mask & PW_CLIENT_NODE_PORT_UPDATE_FORMAT) {
 		spa_log_info(this->log, "proxy %p: update format %p", this, format);
@@ -741,6 +747,29 @@ spa_proxy_node_port_send_command(struct spa_node *node,
 	return SPA_RESULT_NOT_IMPLEMENTED;
 }
 
+/* publish the clock of the driver in the transport area so that the client
+ * can get the time without a message */
+static void update_clock(struct impl *impl)
+{
+	struct pw_client_node_clock *clock = &impl->transport->area->clock;
+	int32_t rate;
+	int64_t ticks, monotonic_time;
+	double rate_diff;
+
+	if (pw_node_get_time(impl->this.node, &rate, &ticks, &monotonic_time, &rate_diff) < 0)
+		return;
+
+	if (clock->seq != 0 && clock->ticks == ticks && clock->rate == rate)
+		return;
+
+	pw_client_node_clock_write_begin(clock);
+	clock->rate = rate;
+	clock->ticks = ticks;
+	clock->monotonic_time = monotonic_time;
+	clock->rate_diff = rate_diff;
+	pw_client_node_clock_write_end(clock);
+}
+
 static int spa_proxy_node_process_input(struct spa_node *node)
 {
 	struct impl *impl;
@@ -764,6 +793,7 @@ static int spa_proxy_node_process_input(struct spa_node *node)
 		impl->transport->inputs[i] = *io;
 		io->status = SPA_RESULT_NEED_BUFFER;
 	}
+	update_clock(impl);
 	pw_client_node_transport_add_message(impl->transport,
 			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT));
 	do_flush(this);
@@ -801,6 +831,7 @@ static int spa_proxy_node_process_output(struct spa_node *node)
 				impl->transport->outputs[i].status,
 				impl->transport->outputs[i].buffer_id);
 	}
+	update_clock(impl);
 
 	pw_client_node_transport_add_message(impl->transport,
 			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT));
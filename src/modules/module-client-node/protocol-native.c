@@ -287,9 +287,16 @@ static bool client_node_demarshal_use_buffers(void *object, void *data, size_t s
 			      SPA_POD_TYPE_INT, &port_id, SPA_POD_TYPE_INT, &n_buffers, 0))
 		return false;
 
-	buffers = alloca(sizeof(struct pw_client_node_buffer) * n_buffers);
+	if ((buffers = pw_protocol_native_alloc_proxy(proxy,
+			sizeof(struct pw_client_node_buffer) * n_buffers)) == NULL)
+		return false;
 	for (i = 0; i < n_buffers; i++) {
-		struct spa_buffer *buf = buffers[i].buffer = alloca(sizeof(struct spa_buffer));
+		struct spa_buffer *buf;
+
+		if ((buf = pw_protocol_native_alloc_proxy(proxy,
+				sizeof(struct spa_buffer))) == NULL)
+			return false;
+		buffers[i].buffer = buf;
 
 		if (!spa_pod_iter_get(&it,
 				      SPA_POD_TYPE_INT, &buffers[i].mem_id,
@@ -299,7 +306,9 @@ static bool client_node_demarshal_use_buffers(void *object, void *data, size_t s
 				      SPA_POD_TYPE_INT, &buf->n_metas, 0))
 			return false;
 
-		buf->metas = alloca(sizeof(struct spa_meta) * buf->n_metas);
+		if ((buf->metas = pw_protocol_native_alloc_proxy(proxy,
+				sizeof(struct spa_meta) * buf->n_metas)) == NULL)
+			return false;
 		for (j = 0; j < buf->n_metas; j++) {
 			struct spa_meta *m = &buf->metas[j];
 
@@ -311,7 +320,9 @@ static bool client_node_demarshal_use_buffers(void *object, void *data, size_t s
 		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &buf->n_datas, 0))
 			return false;
 
-		buf->datas = alloca(sizeof(struct spa_data) * buf->n_datas);
+		if ((buf->datas = pw_protocol_native_alloc_proxy(proxy,
+				sizeof(struct spa_data) * buf->n_datas)) == NULL)
+			return false;
 		for (j = 0; j < buf->n_datas; j++) {
 			struct spa_data *d = &buf->datas[j];
 
@@ -699,7 +710,9 @@ static bool client_node_demarshal_port_update(void *object, void *data, size_t s
 			      SPA_POD_TYPE_INT, &n_possible_formats, 0))
 		return false;
 
-	possible_formats = alloca(n_possible_formats * sizeof(struct spa_format *));
+	if ((possible_formats = pw_protocol_native_alloc_resource(resource,
+			n_possible_formats * sizeof(struct spa_format *))) == NULL)
+		return false;
 	for (i = 0; i < n_possible_formats; i++)
 		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_OBJECT, &possible_formats[i], 0))
 			return false;
@@ -707,7 +720,9 @@ static bool client_node_demarshal_port_update(void *object, void *data, size_t s
 	if (!spa_pod_iter_get(&it, -SPA_POD_TYPE_OBJECT, &format, SPA_POD_TYPE_INT, &n_params, 0))
 		return false;
 
-	params = alloca(n_params * sizeof(struct spa_param *));
+	if ((params = pw_protocol_native_alloc_resource(resource,
+			n_params * sizeof(struct spa_param *))) == NULL)
+		return false;
 	for (i = 0; i < n_params; i++)
 		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_OBJECT, &params[i], 0))
 			return false;
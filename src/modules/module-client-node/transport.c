@@ -96,6 +96,7 @@ static void transport_reset_area(struct pw_client_node_transport *trans)
 	}
 	spa_ringbuffer_init(trans->input_buffer, INPUT_BUFFER_SIZE);
 	spa_ringbuffer_init(trans->output_buffer, OUTPUT_BUFFER_SIZE);
+	memset(&a->clock, 0, sizeof(struct pw_client_node_clock));
 }
 
 static void destroy(struct pw_client_node_transport *trans)
@@ -188,6 +189,7 @@ pw_client_node_transport_new(uint32_t max_input_ports, uint32_t max_output_ports
 	area.n_input_ports = 0;
 	area.max_output_ports = max_output_ports;
 	area.n_output_ports = 0;
+	memset(&area.clock, 0, sizeof(struct pw_client_node_clock));
 
 	impl = calloc(1, sizeof(struct transport));
 	if (impl == NULL)
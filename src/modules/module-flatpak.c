@@ -24,6 +24,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <signal.h>
 
 #include "config.h"
 
@@ -36,6 +37,8 @@
 #include "pipewire/module.h"
 #include "pipewire/utils.h"
 
+#define MAX_SANDBOX_CACHE	64
+
 struct impl {
 	struct pw_core *core;
 	struct pw_type *type;
@@ -48,16 +51,37 @@ struct impl {
 
 	struct spa_list client_list;
 
+	struct spa_list sandbox_cache;	/**< most recently used first */
+	uint32_t n_sandbox_cache;
+
 	struct spa_source *dispatch_event;
 };
 
 struct resource;
 
+/** identifies a process, the start time and mount namespace make sure
+ * that a reused pid does not match */
+struct process_key {
+	pid_t pid;
+	uint64_t start_time;
+	ino_t mnt_ns;
+};
+
+struct sandbox_entry {
+	struct spa_list link;
+	struct process_key key;
+	bool is_sandboxed;
+	char *granted_factory;	/**< factory the portal granted access to */
+	uint32_t granted_type;	/**< type the portal granted access to */
+};
+
 struct client_info {
 	struct spa_list link;
 	struct impl *impl;
 	struct pw_client *client;
 	struct spa_hook client_listener;
+	bool have_key;
+	struct process_key key;
 	bool is_sandboxed;
         struct spa_list resources;
 	struct resource *core_resource;
@@ -160,8 +184,101 @@ static void client_info_free(struct client_info *cinfo)
 	free(cinfo);
 }
 
+static bool get_process_key(pid_t pid, struct process_key *key)
+{
+	char path[64], buf[1024], *p;
+	struct stat stat_buf;
+	ssize_t len;
+	int fd, i;
+
+	sprintf(path, "/proc/%u/stat", pid);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return false;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return false;
+	buf[len] = '\0';
+
+	/* the name can contain spaces, start after it. The start time is
+	 * the 20th field after the name */
+	if ((p = strrchr(buf, ')')) == NULL)
+		return false;
+	for (i = 0; i < 20 && p; i++)
+		p = strchr(p + 1, ' ');
+	if (p == NULL)
+		return false;
+
+	sprintf(path, "/proc/%u/ns/mnt", pid);
+	if (stat(path, &stat_buf) < 0)
+		return false;
+
+	key->pid = pid;
+	key->start_time = strtoull(p + 1, NULL, 10);
+	key->mnt_ns = stat_buf.st_ino;
+
+	return true;
+}
+
+static void free_sandbox_entry(struct impl *impl, struct sandbox_entry *e)
+{
+	spa_list_remove(&e->link);
+	impl->n_sandbox_cache--;
+	free(e->granted_factory);
+	free(e);
+}
+
+static struct sandbox_entry *find_sandbox_entry(struct impl *impl, const struct process_key *key)
+{
+	struct sandbox_entry *e;
+
+	spa_list_for_each(e, &impl->sandbox_cache, link) {
+		if (e->key.pid == key->pid &&
+		    e->key.start_time == key->start_time &&
+		    e->key.mnt_ns == key->mnt_ns) {
+			spa_list_remove(&e->link);
+			spa_list_insert(&impl->sandbox_cache, &e->link);
+			return e;
+		}
+	}
+	return NULL;
+}
+
+static inline bool process_exited(pid_t pid)
+{
+	return kill(pid, 0) < 0 && errno == ESRCH;
+}
+
+static struct sandbox_entry *
+add_sandbox_entry(struct impl *impl, const struct process_key *key, bool is_sandboxed)
+{
+	struct sandbox_entry *e, *t;
+
+	if (impl->n_sandbox_cache >= MAX_SANDBOX_CACHE) {
+		spa_list_for_each_safe(e, t, &impl->sandbox_cache, link) {
+			if (process_exited(e->key.pid))
+				free_sandbox_entry(impl, e);
+		}
+	}
+	if (impl->n_sandbox_cache >= MAX_SANDBOX_CACHE)
+		free_sandbox_entry(impl, spa_list_last(&impl->sandbox_cache,
+						       struct sandbox_entry, link));
+
+	if ((e = calloc(1, sizeof(struct sandbox_entry))) == NULL)
+		return NULL;
+
+	e->key = *key;
+	e->is_sandboxed = is_sandboxed;
+	spa_list_insert(&impl->sandbox_cache, &e->link);
+	impl->n_sandbox_cache++;
+
+	return e;
+}
+
 static bool check_sandboxed(struct client_info *cinfo, char **error)
 {
+	struct impl *impl = cinfo->impl;
+	struct sandbox_entry *e;
 	char root_path[2048];
 	int root_fd, info_fd;
 	const struct ucred *ucred;
@@ -179,6 +296,15 @@ static bool check_sandboxed(struct client_info *cinfo, char **error)
 		return true;
 	}
 
+	if ((cinfo->have_key = get_process_key(ucred->pid, &cinfo->key))) {
+		if ((e = find_sandbox_entry(impl, &cinfo->key)) != NULL) {
+			pw_log_debug("using cached sandbox state %d for pid %d",
+				     e->is_sandboxed, ucred->pid);
+			cinfo->is_sandboxed = e->is_sandboxed;
+			return true;
+		}
+	}
+
 	sprintf(root_path, "/proc/%u/root", ucred->pid);
 	root_fd = openat (AT_FDCWD, root_path, O_RDONLY | O_NONBLOCK | O_DIRECTORY | O_CLOEXEC | O_NOCTTY);
 	if (root_fd == -1) {
@@ -195,7 +321,7 @@ static bool check_sandboxed(struct client_info *cinfo, char **error)
 			pw_log_debug("no .flatpak-info, client on the host");
 			cinfo->is_sandboxed = false;
 			/* No file => on the host */
-			return true;
+			goto done;
 		}
 		asprintf(error, "error opening .flatpak-info: %m");
 		return false;
@@ -206,6 +332,11 @@ static bool check_sandboxed(struct client_info *cinfo, char **error)
 		asprintf(error, "error fstat .flatpak-info: %m");
 		return false;
 	}
+	close(info_fd);
+
+      done:
+	if (cinfo->have_key)
+		add_sandbox_entry(impl, &cinfo->key, cinfo->is_sandboxed);
 	return true;
 }
 
@@ -287,6 +418,16 @@ portal_response(DBusConnection *connection, DBusMessage *msg, void *user_data)
 		pw_log_debug("portal check result: %d", response);
 
 		if (response == 0) {
+			struct sandbox_entry *e;
+
+			/* remember the grant, a reconnect of the same process
+			 * does not need to ask again for the same object */
+			if (cinfo->have_key && (e = find_sandbox_entry(cinfo->impl, &cinfo->key))) {
+				free(e->granted_factory);
+				e->granted_factory = strdup(p->factory_name);
+				e->granted_type = p->type;
+			}
+
 			pw_resource_do_parent(p->resource->resource,
 					      &p->resource->override,
 					      struct pw_core_proxy_methods,
@@ -328,6 +469,7 @@ static void do_create_object(void *data,
 	const char *handle;
 	const char *device;
 	struct async_pending *p;
+	struct sandbox_entry *e;
 
 	if (!cinfo->is_sandboxed) {
 		pw_resource_do_parent(resource->resource,
@@ -346,6 +488,23 @@ static void do_create_object(void *data,
 		goto not_allowed;
 	}
 
+	if (cinfo->have_key &&
+	    (e = find_sandbox_entry(impl, &cinfo->key)) != NULL &&
+	    e->granted_factory && strcmp(e->granted_factory, factory_name) == 0 &&
+	    e->granted_type == type) {
+		pw_log_info("portal access was granted before for client %p", cinfo->client);
+		pw_resource_do_parent(resource->resource,
+				      &resource->override,
+				      struct pw_core_proxy_methods,
+				      create_object,
+				      factory_name,
+				      type,
+				      version,
+				      props,
+				      new_id);
+		return;
+	}
+
 	pw_log_info("ask portal for client %p", cinfo->client);
 	pw_client_set_busy(client, true);
 
@@ -530,8 +689,17 @@ core_global_removed(void *data, struct pw_global *global)
 		struct pw_client *client = pw_global_get_object(global);
 		struct client_info *cinfo;
 
-		if ((cinfo = find_client_info(impl, client)))
+		if ((cinfo = find_client_info(impl, client))) {
+			struct sandbox_entry *e;
+
+			/* forget about the process when it exited, a reconnect
+			 * of a live process keeps using the cached state */
+			if (cinfo->have_key && process_exited(cinfo->key.pid) &&
+			    (e = find_sandbox_entry(impl, &cinfo->key)))
+				free_sandbox_entry(impl, e);
+
 			client_info_free(cinfo);
+		}
 
 		pw_log_debug("module %p: client %p removed", impl, client);
 	}
@@ -729,6 +897,7 @@ static void module_destroy(void *data)
 {
 	struct impl *impl = data;
 	struct client_info *info, *t;
+	struct sandbox_entry *e, *te;
 
 	spa_hook_remove(&impl->core_listener);
 	spa_hook_remove(&impl->module_listener);
@@ -738,6 +907,8 @@ static void module_destroy(void *data)
 
 	spa_list_for_each_safe(info, t, &impl->client_list, link)
 		client_info_free(info);
+	spa_list_for_each_safe(e, te, &impl->sandbox_cache, link)
+		free_sandbox_entry(impl, e);
 
 	pw_loop_destroy_source(pw_core_get_main_loop(impl->core), impl->dispatch_event);
 
@@ -782,6 +953,7 @@ static bool module_init(struct pw_module *module, struct pw_properties *properti
 	dbus_connection_set_wakeup_main_function(impl->bus, wakeup_main, impl, NULL);
 
 	spa_list_init(&impl->client_list);
+	spa_list_init(&impl->sandbox_cache);
 
 	pw_core_add_listener(core, &impl->core_listener, &core_events, impl);
 	pw_module_add_listener(module, &impl->module_listener, &module_events, impl);
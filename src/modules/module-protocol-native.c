@@ -795,6 +795,18 @@ static void impl_ext_end_resource(struct pw_resource *resource,
 	pw_protocol_native_connection_end(data->connection, builder);
 }
 
+static void *impl_ext_alloc_proxy(struct pw_proxy *proxy, size_t size)
+{
+	struct client *impl = SPA_CONTAINER_OF(proxy->remote->conn, struct client, this);
+	return pw_protocol_native_connection_alloc(impl->connection, size);
+}
+
+static void *impl_ext_alloc_resource(struct pw_resource *resource, size_t size)
+{
+	struct client_data *data = resource->client->user_data;
+	return pw_protocol_native_connection_alloc(data->connection, size);
+}
+
 const static struct pw_protocol_native_ext protocol_ext_impl = {
 	PW_VERSION_PROTOCOL_NATIVE_EXT,
 	impl_ext_begin_proxy,
@@ -805,6 +817,8 @@ const static struct pw_protocol_native_ext protocol_ext_impl = {
 	impl_ext_add_resource_fd,
 	impl_ext_get_resource_fd,
 	impl_ext_end_resource,
+	impl_ext_alloc_proxy,
+	impl_ext_alloc_resource,
 };
 
 static void module_destroy(void *data)
@@ -34,6 +34,7 @@
 
 #define MAX_BUFFER_SIZE (1024 * 32)
 #define MAX_FDS 28
+#define ARENA_EXTEND 4096
 
 static bool debug_messages = 0;
 
@@ -59,6 +60,8 @@ struct impl {
 	uint32_t dest_id;
 	uint8_t opcode;
 	struct spa_pod_builder builder;
+
+	struct pw_arena arena;	/**< memory for the message being demarshalled */
 };
 
 /** \endcond */
@@ -81,6 +84,26 @@ int pw_protocol_native_connection_get_fd(struct pw_protocol_native_connection *c
 	return impl->in.fds[index];
 }
 
+/** Allocate memory for the message that is being demarshalled
+ *
+ * \param conn the connection
+ * \param size the number of bytes to allocate
+ * \return memory that stays valid until the next message is read or NULL
+ * when there is no memory
+ *
+ * The memory comes from an arena of the connection that is released in
+ * bulk for each message, so a burst of messages does no malloc/free and
+ * sizes from a message can not overflow the stack.
+ *
+ * \memberof pw_protocol_native_connection
+ */
+void *pw_protocol_native_connection_alloc(struct pw_protocol_native_connection *conn, size_t size)
+{
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+
+	return pw_arena_alloc(&impl->arena, size);
+}
+
 /** Add an fd to a connection
  *
  * \param conn the connection
@@ -210,6 +233,7 @@ struct pw_protocol_native_connection *pw_protocol_native_connection_new(int fd)
 	impl->in.buffer_data = malloc(MAX_BUFFER_SIZE);
 	impl->in.buffer_maxsize = MAX_BUFFER_SIZE;
 	impl->in.update = true;
+	pw_arena_init(&impl->arena, ARENA_EXTEND);
 
 	if (impl->out.buffer_data == NULL || impl->in.buffer_data == NULL)
 		goto no_mem;
@@ -239,6 +263,7 @@ void pw_protocol_native_connection_destroy(struct pw_protocol_native_connection
 
 	free(impl->out.buffer_data);
 	free(impl->in.buffer_data);
+	pw_arena_clear(&impl->arena);
 	free(impl);
 }
 
@@ -271,8 +296,9 @@ pw_protocol_native_connection_get_next(struct pw_protocol_native_connection *con
 
 	buf = &impl->in;
 
-	/* move to next packet */
+	/* move to next packet, the memory of the previous one is released */
 	buf->offset += buf->size;
+	pw_arena_reset(&impl->arena);
 
       again:
 	if (buf->update) {
@@ -68,6 +68,8 @@ pw_protocol_native_connection_get_next(struct pw_protocol_native_connection *con
 				       uint32_t *dest_id,
 				       void **data, uint32_t *size);
 
+void *pw_protocol_native_connection_alloc(struct pw_protocol_native_connection *conn, size_t size);
+
 uint32_t pw_protocol_native_connection_add_fd(struct pw_protocol_native_connection *conn, int fd);
 
 int pw_protocol_native_connection_get_fd(struct pw_protocol_native_connection *conn, uint32_t index);
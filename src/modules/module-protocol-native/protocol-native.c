@@ -197,7 +197,9 @@ static bool core_demarshal_info(void *object, void *data, size_t size)
 		return false;
 
 	info.props = &props;
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+	if ((props.items = pw_protocol_native_alloc_proxy(proxy,
+			props.n_items * sizeof(struct spa_dict_item))) == NULL)
+		return false;
 	for (i = 0; i < props.n_items; i++) {
 		if (!spa_pod_iter_get(&it,
 				      SPA_POD_TYPE_STRING, &props.items[i].key,
@@ -265,7 +267,9 @@ static bool core_demarshal_update_types_client(void *object, void *data, size_t
 	    !spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &first_id, SPA_POD_TYPE_INT, &n_types, 0))
 		return false;
 
-	types = alloca(n_types * sizeof(char *));
+	if ((types = pw_protocol_native_alloc_proxy(proxy,
+			n_types * sizeof(char *))) == NULL)
+		return false;
 	for (i = 0; i < n_types; i++) {
 		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_STRING, &types[i], 0))
 			return false;
@@ -387,7 +391,9 @@ static bool core_demarshal_client_update(void *object, void *data, size_t size)
 	    !spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &props.n_items, 0))
 		return false;
 
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+	if ((props.items = pw_protocol_native_alloc_resource(resource,
+			props.n_items * sizeof(struct spa_dict_item))) == NULL)
+		return false;
 	for (i = 0; i < props.n_items; i++) {
 		if (!spa_pod_iter_get(&it,
 				      SPA_POD_TYPE_STRING, &props.items[i].key,
@@ -445,7 +451,9 @@ static bool core_demarshal_create_object(void *object, void *data, size_t size)
 			      SPA_POD_TYPE_INT, &props.n_items, 0))
 		return false;
 
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+	if ((props.items = pw_protocol_native_alloc_resource(resource,
+			props.n_items * sizeof(struct spa_dict_item))) == NULL)
+		return false;
 	for (i = 0; i < props.n_items; i++) {
 		if (!spa_pod_iter_get(&it,
 				      SPA_POD_TYPE_STRING, &props.items[i].key,
@@ -481,7 +489,9 @@ static bool core_demarshal_create_link(void *object, void *data, size_t size)
 			      SPA_POD_TYPE_INT, &props.n_items, 0))
 		return false;
 
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+	if ((props.items = pw_protocol_native_alloc_resource(resource,
+			props.n_items * sizeof(struct spa_dict_item))) == NULL)
+		return false;
 	for (i = 0; i < props.n_items; i++) {
 		if (!spa_pod_iter_get(&it,
 				      SPA_POD_TYPE_STRING, &props.items[i].key,
@@ -513,7 +523,9 @@ static bool core_demarshal_update_types_server(void *object, void *data, size_t
 	    !spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &first_id, SPA_POD_TYPE_INT, &n_types, 0))
 		return false;
 
-	types = alloca(n_types * sizeof(char *));
+	if ((types = pw_protocol_native_alloc_resource(resource,
+			n_types * sizeof(char *))) == NULL)
+		return false;
 	for (i = 0; i < n_types; i++) {
 		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_STRING, &types[i], 0))
 			return false;
@@ -619,7 +631,9 @@ static bool module_demarshal_info(void *object, void *data, size_t size)
 		return false;
 
 	info.props = &props;
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+	if ((props.items = pw_protocol_native_alloc_proxy(proxy,
+			props.n_items * sizeof(struct spa_dict_item))) == NULL)
+		return false;
 	for (i = 0; i < props.n_items; i++) {
 		if (!spa_pod_iter_get(&it,
 				      SPA_POD_TYPE_STRING, &props.items[i].key,
@@ -679,7 +693,9 @@ static bool factory_demarshal_info(void *object, void *data, size_t size)
 		return false;
 
 	info.props = &props;
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+	if ((props.items = pw_protocol_native_alloc_proxy(proxy,
+			props.n_items * sizeof(struct spa_dict_item))) == NULL)
+		return false;
 	for (i = 0; i < props.n_items; i++) {
 		if (!spa_pod_iter_get(&it,
 				      SPA_POD_TYPE_STRING, &props.items[i].key,
@@ -753,7 +769,9 @@ static bool node_demarshal_info(void *object, void *data, size_t size)
 			      SPA_POD_TYPE_INT, &info.n_input_formats, 0))
 		return false;
 
-	info.input_formats = alloca(info.n_input_formats * sizeof(struct spa_format *));
+	if ((info.input_formats = pw_protocol_native_alloc_proxy(proxy,
+			info.n_input_formats * sizeof(struct spa_format *))) == NULL)
+		return false;
 	for (i = 0; i < info.n_input_formats; i++)
 		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_OBJECT, &info.input_formats[i], 0))
 			return false;
@@ -764,7 +782,9 @@ static bool node_demarshal_info(void *object, void *data, size_t size)
 			      SPA_POD_TYPE_INT, &info.n_output_formats, 0))
 		return false;
 
-	info.output_formats = alloca(info.n_output_formats * sizeof(struct spa_format *));
+	if ((info.output_formats = pw_protocol_native_alloc_proxy(proxy,
+			info.n_output_formats * sizeof(struct spa_format *))) == NULL)
+		return false;
 	for (i = 0; i < info.n_output_formats; i++)
 		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_OBJECT, &info.output_formats[i], 0))
 			return false;
@@ -776,7 +796,9 @@ static bool node_demarshal_info(void *object, void *data, size_t size)
 		return false;
 
 	info.props = &props;
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+	if ((props.items = pw_protocol_native_alloc_proxy(proxy,
+			props.n_items * sizeof(struct spa_dict_item))) == NULL)
+		return false;
 	for (i = 0; i < props.n_items; i++) {
 		if (!spa_pod_iter_get(&it,
 				      SPA_POD_TYPE_STRING, &props.items[i].key,
@@ -830,7 +852,9 @@ static bool client_demarshal_info(void *object, void *data, size_t size)
 		return false;
 
 	info.props = &props;
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+	if ((props.items = pw_protocol_native_alloc_proxy(proxy,
+			props.n_items * sizeof(struct spa_dict_item))) == NULL)
+		return false;
 	for (i = 0; i < props.n_items; i++) {
 		if (!spa_pod_iter_get(&it,
 				      SPA_POD_TYPE_STRING, &props.items[i].key,
@@ -894,7 +918,9 @@ static bool link_demarshal_info(void *object, void *data, size_t size)
 		return false;
 
 	info.props = &props;
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+	if ((props.items = pw_protocol_native_alloc_proxy(proxy,
+			props.n_items * sizeof(struct spa_dict_item))) == NULL)
+		return false;
 	for (i = 0; i < props.n_items; i++) {
 		if (!spa_pod_iter_get(&it,
 				      SPA_POD_TYPE_STRING, &props.items[i].key,
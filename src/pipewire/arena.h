@@ -0,0 +1,174 @@
+/* PipeWire
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __PIPEWIRE_ARENA_H__
+#define __PIPEWIRE_ARENA_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <spa/defs.h>
+#include <spa/pod-builder.h>
+
+/** \class pw_arena
+ *
+ * \brief A memory arena for transient allocations
+ *
+ * Memory is taken from large blocks by moving an offset and is only
+ * released in bulk with \ref pw_arena_reset. When more than one block
+ * was needed, the reset replaces them with one block that can hold
+ * everything, so that a repeating workload does no malloc/free.
+ *
+ * An arena is not thread safe, use one arena per thread or connection.
+ */
+struct pw_arena_block {
+	struct pw_arena_block *next;	/**< the previous block */
+	size_t size;			/**< size of the block data */
+	size_t offset;			/**< first free byte in the block */
+	/* data follows */
+};
+
+struct pw_arena {
+	struct pw_arena_block *blocks;	/**< blocks, the current block first */
+	size_t extend;			/**< minimum size of a new block */
+	size_t used;			/**< bytes allocated since the last reset */
+};
+
+#define PW_ARENA_INIT(extend) (struct pw_arena) { NULL, extend, 0 }
+
+/** Initialize the arena with given extend \memberof pw_arena */
+static inline void pw_arena_init(struct pw_arena *arena, size_t extend)
+{
+	arena->blocks = NULL;
+	arena->extend = extend;
+	arena->used = 0;
+}
+
+/** Free all memory of the arena \memberof pw_arena */
+static inline void pw_arena_clear(struct pw_arena *arena)
+{
+	struct pw_arena_block *b, *next;
+
+	for (b = arena->blocks; b; b = next) {
+		next = b->next;
+		free(b);
+	}
+	arena->blocks = NULL;
+	arena->used = 0;
+}
+
+/** Allocate \a size bytes, aligned to 8 bytes, from the arena. The memory
+ * stays valid until the next reset \memberof pw_arena */
+static inline void *pw_arena_alloc(struct pw_arena *arena, size_t size)
+{
+	struct pw_arena_block *b = arena->blocks;
+	void *p;
+
+	size = SPA_ROUND_UP_N(size, 8);
+
+	if (SPA_UNLIKELY(b == NULL || b->offset + size > b->size)) {
+		size_t bsize = SPA_MAX(arena->extend, size);
+
+		if (b)
+			bsize = SPA_MAX(bsize, b->size * 2);
+		if (SPA_UNLIKELY((b = malloc(sizeof(struct pw_arena_block) + bsize)) == NULL))
+			return NULL;
+
+		b->next = arena->blocks;
+		b->size = bsize;
+		b->offset = 0;
+		arena->blocks = b;
+	}
+	p = SPA_MEMBER(b, sizeof(struct pw_arena_block) + b->offset, void);
+	b->offset += size;
+	arena->used += size;
+
+	return p;
+}
+
+/** Release all allocations of the arena at once \memberof pw_arena */
+static inline void pw_arena_reset(struct pw_arena *arena)
+{
+	struct pw_arena_block *b = arena->blocks;
+
+	if (b == NULL)
+		return;
+
+	if (b->next) {
+		/* the round did not fit in one block, make the next block
+		 * big enough to hold everything */
+		arena->extend = SPA_MAX(arena->extend, arena->used);
+		pw_arena_clear(arena);
+	} else {
+		b->offset = 0;
+		arena->used = 0;
+	}
+}
+
+/** A pod builder that writes into an arena \memberof pw_arena */
+struct pw_arena_builder {
+	struct spa_pod_builder b;	/**< the builder */
+	struct pw_arena *arena;		/**< the arena to allocate from */
+};
+
+static inline uint32_t
+pw_arena_builder_write(struct spa_pod_builder *b, uint32_t ref, const void *data, uint32_t size)
+{
+	struct pw_arena_builder *ab = SPA_CONTAINER_OF(b, struct pw_arena_builder, b);
+
+	if (ref == -1)
+		ref = b->offset;
+
+	if (ref + size > b->size) {
+		/* move the pod to a bigger area, the old area is released
+		 * with the next arena reset */
+		uint32_t alloc = SPA_MAX(b->size * 2, SPA_ROUND_UP_N(ref + size, 1024));
+		void *p;
+
+		if ((p = pw_arena_alloc(ab->arena, alloc)) == NULL)
+			return -1;
+		if (b->offset)
+			memcpy(p, b->data, b->offset);
+		b->data = p;
+		b->size = alloc;
+	}
+	memcpy(SPA_MEMBER(b->data, ref, void), data, size);
+
+	return ref;
+}
+
+/** Initialize a pod builder that takes its memory from \a arena.
+ * The pod can be found at \a builder->b.data when building is done
+ * \memberof pw_arena */
+static inline void
+pw_arena_builder_init(struct pw_arena_builder *builder, struct pw_arena *arena)
+{
+	builder->b = (struct spa_pod_builder) { NULL, 0, 0, NULL, pw_arena_builder_write };
+	builder->arena = arena;
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __PIPEWIRE_ARENA_H__ */
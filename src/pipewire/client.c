@@ -129,6 +129,8 @@ struct pw_client *pw_client_new(struct pw_core *core,
 
 	pw_map_init(&this->objects, 0, 32);
 	pw_map_init(&this->types, 0, 32);
+	pw_array_init(&this->permissions, 64);
+	this->permission_serial = core->permission_serial;
 
 	this->info.props = this->properties ? &this->properties->dict : NULL;
 
@@ -221,6 +223,8 @@ void pw_client_destroy(struct pw_client *client)
 
 	pw_map_clear(&client->objects);
 	pw_map_clear(&client->types);
+	pw_array_clear(&client->permissions);
+	pw_mempool_release_tag(client->core->mempool, client);
 
 	if (client->properties)
 		pw_properties_free(client->properties);
@@ -23,6 +23,7 @@
 #define spa_debug pw_log_trace
 
 #include <spa/lib/debug.h>
+#include <spa/lib/format.h>
 #include <spa/format-utils.h>
 
 #include <pipewire/pipewire.h>
@@ -34,11 +35,25 @@
 
 #include <spa/graph-scheduler3.h>
 
+#define MEMPOOL_MAX_RESIDENT	(8 * 1024 * 1024)
+#define MAX_FORMAT_CACHE	64
+
 /** \cond */
 struct resource_data {
 	struct spa_hook resource_listener;
 };
 
+struct format_cache_entry {
+	struct spa_list link;
+	uint64_t hash;			/**< hash of the formats and filters */
+	void *key;			/**< output formats, input formats and
+					  *  filters, compared on a hash match */
+	uint32_t output_size;		/**< size of the output formats in key */
+	uint32_t input_size;		/**< size of the input formats in key */
+	uint32_t filter_size;		/**< size of the filters in key */
+	struct spa_format *format;	/**< fixated common format */
+};
+
 /** \endcond */
 
 static void registry_bind(void *object, uint32_t id,
@@ -415,6 +430,10 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	this->data_loop = pw_data_loop_get_loop(this->data_loop_impl);
 	this->main_loop = main_loop;
 
+	this->mempool = pw_mempool_new(MEMPOOL_MAX_RESIDENT);
+	if (this->mempool == NULL)
+		goto no_mempool;
+
 	pw_type_init(&this->type);
 	pw_map_init(&this->globals, 128, 32);
 
@@ -441,6 +460,8 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	spa_list_init(&this->node_list);
 	spa_list_init(&this->factory_list);
 	spa_list_init(&this->link_list);
+	spa_list_init(&this->format_cache);
+	pw_arena_init(&this->arena, 4096);
 	spa_hook_list_init(&this->listener_list);
 
 	if ((name = pw_properties_get(properties, PW_CORE_PROP_NAME)) == NULL) {
@@ -470,6 +491,8 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 
 	return this;
 
+      no_mempool:
+	pw_data_loop_destroy(this->data_loop_impl);
       no_mem:
       no_data_loop:
 	free(this);
@@ -486,6 +509,7 @@ void pw_core_destroy(struct pw_core *core)
 {
 	struct pw_global *global, *t;
 	struct pw_module *module, *tm;
+	struct format_cache_entry *e, *te;
 
 	pw_log_debug("core %p: destroy", core);
 	spa_hook_list_call(&core->listener_list, struct pw_core_events, destroy);
@@ -504,6 +528,14 @@ void pw_core_destroy(struct pw_core *core)
 
 	pw_map_clear(&core->globals);
 
+	spa_list_for_each_safe(e, te, &core->format_cache, link) {
+		free(e->key);
+		free(e->format);
+		free(e);
+	}
+	pw_arena_clear(&core->arena);
+	pw_mempool_destroy(core->mempool);
+
 	pw_log_debug("core %p: free", core);
 	free(core);
 }
@@ -532,6 +564,26 @@ void pw_core_set_permission_callback(struct pw_core *core,
 {
 	core->permission_func = callback;
 	core->permission_data = data;
+	pw_core_invalidate_permissions(core, NULL);
+}
+
+/** Invalidate cached permissions
+ *
+ * \param core a core
+ * \param client a client or NULL for all clients
+ *
+ * Make sure that the permission callback is called again for the
+ * globals of \a client. This should be called when the policy of the
+ * permission callback changed.
+ *
+ * \memberof pw_core
+ */
+void pw_core_invalidate_permissions(struct pw_core *core, struct pw_client *client)
+{
+	if (client)
+		client->permissions.size = 0;
+	else
+		core->permission_serial++;
 }
 
 struct pw_type *pw_core_get_type(struct pw_core *core)
@@ -682,6 +734,277 @@ struct pw_port *pw_core_find_port(struct pw_core *core,
 	return best;
 }
 
+static inline uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+	size_t i;
+
+	/* FNV-1a */
+	for (i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+#define FNV_INIT	0xcbf29ce484222325ULL
+
+#define FORMAT_FOREACH(data, size, iter)						\
+	for ((iter) = (data);								\
+	     (iter) && (void *) (iter) < SPA_MEMBER((data), (size), void);		\
+	     (iter) = SPA_MEMBER((iter), SPA_ROUND_UP_N(SPA_POD_SIZE(iter), 8), struct spa_format))
+
+/* get the number of formats of a port. They are enumerated once and kept
+ * in the port until its info changes, a next negotiation only uses the
+ * copy */
+static int port_formats(struct pw_core *core, struct pw_port *port)
+{
+	struct pw_arena_builder b;
+	struct spa_format *format;
+	uint32_t idx;
+	int res;
+
+	if (port->formats.valid)
+		return port->formats.n_formats;
+
+	pw_arena_builder_init(&b, &core->arena);
+
+	for (idx = 0;; idx++) {
+		if ((res = spa_node_port_enum_formats(port->node->node, port->direction, port->port_id,
+						      &format, NULL, idx)) < 0) {
+			if (res == SPA_RESULT_ENUM_END)
+				break;
+			return res;
+		}
+		if (spa_pod_builder_raw_padded(&b.b, format, SPA_POD_SIZE(format)) == -1)
+			return SPA_RESULT_NO_MEMORY;
+	}
+	if (b.b.offset > 0) {
+		if ((port->formats.data = malloc(b.b.offset)) == NULL)
+			return SPA_RESULT_NO_MEMORY;
+		memcpy(port->formats.data, b.b.data, b.b.offset);
+	}
+	port->formats.size = b.b.offset;
+	port->formats.n_formats = idx;
+	port->formats.hash = hash_bytes(FNV_INIT, port->formats.data, port->formats.size);
+	port->formats.valid = true;
+
+	return idx;
+}
+
+/* write the extra properties and format filters of a negotiation into
+ * one blob that is hashed and compared for the cache */
+static int filter_key(struct spa_pod_builder *b, struct pw_properties *props,
+		      uint32_t n_format_filters, struct spa_format **format_filters)
+{
+	uint32_t i;
+
+	if (props) {
+		for (i = 0; i < props->dict.n_items; i++) {
+			const struct spa_dict_item *it = &props->dict.items[i];
+			const char *value = it->value ? it->value : "";
+
+			if (spa_pod_builder_raw(b, it->key, strlen(it->key) + 1) == -1 ||
+			    spa_pod_builder_raw(b, value, strlen(value) + 1) == -1)
+				return SPA_RESULT_NO_MEMORY;
+		}
+	}
+	for (i = 0; i < n_format_filters; i++) {
+		if (spa_pod_builder_raw(b, format_filters[i], SPA_POD_SIZE(format_filters[i])) == -1)
+			return SPA_RESULT_NO_MEMORY;
+	}
+	return SPA_RESULT_OK;
+}
+
+static inline bool key_equal(const void *key, const void *data, uint32_t size)
+{
+	return size == 0 || memcmp(key, data, size) == 0;
+}
+
+static struct format_cache_entry *
+find_cached_format(struct pw_core *core, uint64_t hash,
+		   struct pw_port *output, struct pw_port *input,
+		   const void *filters, uint32_t filter_size)
+{
+	struct format_cache_entry *e;
+
+	spa_list_for_each(e, &core->format_cache, link) {
+		if (e->hash != hash ||
+		    e->output_size != output->formats.size ||
+		    e->input_size != input->formats.size ||
+		    e->filter_size != filter_size)
+			continue;
+
+		/* the hash can collide, check the formats and filters */
+		if (!key_equal(e->key, output->formats.data, e->output_size) ||
+		    !key_equal(SPA_MEMBER(e->key, e->output_size, void),
+			       input->formats.data, e->input_size) ||
+		    !key_equal(SPA_MEMBER(e->key, e->output_size + e->input_size, void),
+			       filters, e->filter_size))
+			continue;
+
+		/* move to the front, the tail is evicted first */
+		spa_list_remove(&e->link);
+		spa_list_insert(&core->format_cache, &e->link);
+		return e;
+	}
+	return NULL;
+}
+
+static struct format_cache_entry *
+add_cached_format(struct pw_core *core, uint64_t hash,
+		  struct pw_port *output, struct pw_port *input,
+		  const void *filters, uint32_t filter_size,
+		  const struct spa_format *format)
+{
+	struct format_cache_entry *e;
+	uint32_t output_size = output->formats.size, input_size = input->formats.size;
+
+	if (core->n_format_cache >= MAX_FORMAT_CACHE) {
+		e = spa_list_last(&core->format_cache, struct format_cache_entry, link);
+		spa_list_remove(&e->link);
+		free(e->key);
+		free(e->format);
+		core->n_format_cache--;
+	} else if ((e = calloc(1, sizeof(struct format_cache_entry))) == NULL)
+		return NULL;
+
+	e->key = malloc(SPA_MAX(output_size + input_size + filter_size, 1));
+	e->format = e->key ? spa_format_copy(format) : NULL;
+	if (e->format == NULL) {
+		free(e->key);
+		free(e);
+		return NULL;
+	}
+	if (output_size)
+		memcpy(e->key, output->formats.data, output_size);
+	if (input_size)
+		memcpy(SPA_MEMBER(e->key, output_size, void), input->formats.data, input_size);
+	if (filter_size)
+		memcpy(SPA_MEMBER(e->key, output_size + input_size, void), filters, filter_size);
+
+	e->hash = hash;
+	e->output_size = output_size;
+	e->input_size = input_size;
+	e->filter_size = filter_size;
+	spa_list_insert(&core->format_cache, &e->link);
+	core->n_format_cache++;
+
+	return e;
+}
+
+/* intersect @out with @in and, when there are format filters, with the
+ * first filter that matches. A NULL @in accepts all formats. The result
+ * lives in the arena of the core. */
+static struct spa_format *
+filter_format(struct pw_core *core, struct spa_format *out, const struct spa_format *in,
+	      uint32_t n_format_filters, struct spa_format **format_filters)
+{
+	struct pw_arena_builder b;
+	struct spa_format *format = out;
+	uint32_t i;
+
+	if (in) {
+		pw_arena_builder_init(&b, &core->arena);
+		if (spa_format_filter(out, in, &b.b) < 0 || b.b.data == NULL)
+			return NULL;
+		format = SPA_POD_BUILDER_DEREF(&b.b, 0, struct spa_format);
+	}
+	if (n_format_filters == 0)
+		return format;
+
+	for (i = 0; i < n_format_filters; i++) {
+		pw_arena_builder_init(&b, &core->arena);
+		if (spa_format_filter(format, format_filters[i], &b.b) < 0 || b.b.data == NULL)
+			continue;
+		return SPA_POD_BUILDER_DEREF(&b.b, 0, struct spa_format);
+	}
+	return NULL;
+}
+
+/* find a common format between all formats of output and input. The
+ * formats of a port are only enumerated again after its info changed.
+ * The intersection is cached on the format sets of both ports and the
+ * filters, so that linking the same kinds of nodes again needs no
+ * enumeration and no filtering at all. An input that has no formats
+ * does not restrict the output formats. */
+static struct spa_format *
+negotiate_format(struct pw_core *core,
+		 struct pw_port *output,
+		 struct pw_port *input,
+		 struct pw_properties *props,
+		 uint32_t n_format_filters,
+		 struct spa_format **format_filters,
+		 char **error)
+{
+	struct pw_arena_builder filters;
+	struct format_cache_entry *e;
+	struct spa_format *in, *out, *format = NULL;
+	uint64_t hash;
+	int res, n_input;
+
+	if ((n_input = port_formats(core, input)) < 0) {
+		asprintf(error, "error input enum formats: %d", n_input);
+		goto done;
+	}
+	if ((res = port_formats(core, output)) < 0) {
+		asprintf(error, "error output enum formats: %d", res);
+		goto done;
+	}
+	pw_arena_builder_init(&filters, &core->arena);
+	if (filter_key(&filters.b, props, n_format_filters, format_filters) < 0) {
+		asprintf(error, "no memory");
+		goto done;
+	}
+	hash = hash_bytes(output->formats.hash, &input->formats.hash, sizeof(uint64_t));
+	hash = hash_bytes(hash, filters.b.data, filters.b.offset);
+
+	if ((e = find_cached_format(core, hash, output, input,
+				    filters.b.data, filters.b.offset)) != NULL) {
+		pw_log_debug("core %p: using cached format %p", core, e->format);
+		format = e->format;
+		goto done;
+	}
+
+	if (n_input == 0) {
+		FORMAT_FOREACH(output->formats.data, output->formats.size, out) {
+			if ((format = filter_format(core, out, NULL,
+						    n_format_filters, format_filters)) != NULL)
+				goto found;
+		}
+	}
+	FORMAT_FOREACH(input->formats.data, input->formats.size, in) {
+		pw_log_debug("enum output with filter: %p", in);
+		if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
+			spa_debug_format(in);
+
+		FORMAT_FOREACH(output->formats.data, output->formats.size, out) {
+			if ((format = filter_format(core, out, in,
+						    n_format_filters, format_filters)) != NULL)
+				goto found;
+		}
+	}
+	asprintf(error, "no common format");
+	goto done;
+
+      found:
+	pw_log_debug("Got filtered:");
+	if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
+		spa_debug_format(format);
+
+	spa_format_fixate(format);
+	if ((e = add_cached_format(core, hash, output, input,
+				   filters.b.data, filters.b.offset, format)) == NULL) {
+		asprintf(error, "no memory");
+		format = NULL;
+	} else
+		format = e->format;
+
+      done:
+	pw_arena_reset(&core->arena);
+	return format;
+}
+
 /** Find a common format between two ports
  *
  * \param core a core object
@@ -696,6 +1019,12 @@ struct pw_port *pw_core_find_port(struct pw_core *core,
  * Find a common format between the given ports. The format will
  * be restricted to a subset given with the format filters.
  *
+ * When both ports need a format, the result is taken from a cache
+ * of earlier negotiations between ports with the same formats and
+ * filters. The formats of a port are enumerated once and reused until
+ * its node emits a PortInfoChanged event.
+ * The returned format remains valid until the next call.
+ *
  * \memberof pw_core
  */
 struct spa_format *pw_core_find_format(struct pw_core *core,
@@ -708,8 +1037,7 @@ struct spa_format *pw_core_find_format(struct pw_core *core,
 {
 	uint32_t out_state, in_state;
 	int res;
-	struct spa_format *filter = NULL, *format;
-	uint32_t iidx = 0, oidx = 0;
+	struct spa_format *format;
 
 	out_state = output->state;
 	in_state = input->state;
@@ -737,35 +1065,10 @@ struct spa_format *pw_core_find_format(struct pw_core *core,
 			goto error;
 		}
 	} else if (in_state == PW_PORT_STATE_CONFIGURE && out_state == PW_PORT_STATE_CONFIGURE) {
-	      again:
 		/* both ports need a format */
-		pw_log_debug("core %p: do enum input %d", core, iidx);
-		if ((res = spa_node_port_enum_formats(input->node->node, input->direction, input->port_id,
-						      &filter, NULL, iidx)) < 0) {
-			if (res == SPA_RESULT_ENUM_END && iidx != 0) {
-				asprintf(error, "error input enum formats: %d", res);
-				goto error;
-			}
-		}
-		pw_log_debug("enum output %d with filter: %p", oidx, filter);
-		if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
-			spa_debug_format(filter);
-
-		if ((res = spa_node_port_enum_formats(output->node->node, output->direction, output->port_id,
-						      &format, filter, oidx)) < 0) {
-			if (res == SPA_RESULT_ENUM_END) {
-				oidx = 0;
-				iidx++;
-				goto again;
-			}
-			asprintf(error, "error output enum formats: %d", res);
+		if ((format = negotiate_format(core, output, input, props,
+					       n_format_filters, format_filters, error)) == NULL)
 			goto error;
-		}
-		pw_log_debug("Got filtered:");
-		if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
-			spa_debug_format(format);
-
-		spa_format_fixate(format);
 	} else {
 		asprintf(error, "error node state");
 		goto error;
@@ -130,6 +130,10 @@ void pw_core_set_permission_callback(struct pw_core *core,
 				     pw_permission_func_t callback,
 				     void *data);
 
+/** Make the core call the permission callback again for \a client, or
+  * for all clients when \a client is NULL */
+void pw_core_invalidate_permissions(struct pw_core *core, struct pw_client *client);
+
 /** Get the type object of a core */
 struct pw_type *pw_core_get_type(struct pw_core *core);
 
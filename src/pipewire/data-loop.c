@@ -19,7 +19,9 @@
 
 #include <pthread.h>
 #include <errno.h>
+#include <unistd.h>
 #include <sys/resource.h>
+#include <sys/syscall.h>
 
 #include "pipewire/log.h"
 #include "pipewire/rtkit.h"
@@ -76,6 +78,17 @@ static void *do_loop(void *user_data)
 
 	make_realtime(this);
 
+#ifdef SYS_getcpu
+	{
+		unsigned int cpu, node;
+
+		if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+			__atomic_store_n(&this->numa_node, (int) node, __ATOMIC_RELAXED);
+	}
+#endif
+	pw_log_debug("data-loop %p: running on NUMA node %d", this,
+		     pw_data_loop_get_numa_node(this));
+
 	pw_log_debug("data-loop %p: enter thread", this);
 	pw_loop_enter(this->loop);
 
@@ -117,6 +130,7 @@ struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
 
 	spa_hook_list_init(&this->listener_list);
 
+	this->numa_node = -1;
 	this->event = pw_loop_add_event(this->loop, do_stop, this);
 
 	return this;
@@ -208,3 +222,18 @@ bool pw_data_loop_in_thread(struct pw_data_loop * loop)
 {
 	return pthread_equal(loop->thread, pthread_self());
 }
+
+/** Get the NUMA node of the data loop
+ * \param loop the data loop
+ * \return the NUMA node the data loop thread runs on or -1 when unknown
+ *
+ * The node is read once when the thread starts. The thread is not pinned
+ * so this is a snapshot and the scheduler can move the thread to another
+ * node later. It can be called from any thread.
+ *
+ * \memberof pw_data_loop
+ */
+int pw_data_loop_get_numa_node(struct pw_data_loop *loop)
+{
+	return __atomic_load_n(&loop->numa_node, __ATOMIC_RELAXED);
+}
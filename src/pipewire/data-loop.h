@@ -70,6 +70,10 @@ int pw_data_loop_stop(struct pw_data_loop *loop);
 /** Check if the current thread is the processing thread */
 bool pw_data_loop_in_thread(struct pw_data_loop *loop);
 
+/** Get the NUMA node of the processing thread when it started, -1 when
+ * unknown. The thread is not pinned so it can have moved since */
+int pw_data_loop_get_numa_node(struct pw_data_loop *loop);
+
 #ifdef __cplusplus
 }
 #endif
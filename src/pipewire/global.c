@@ -31,16 +31,57 @@ struct global_impl {
 	struct pw_global this;
 };
 
+/* a cached permission is stored in one byte as the RWX bits and a valid flag */
+#define PERM_CACHED		(1 << 7)
+#define PERM_TO_CACHE(p)	(PERM_CACHED | (((p) & PW_PERM_RWX) >> 6))
+#define PERM_FROM_CACHE(c)	(((c) & 07) << 6)
+
 /** \endcond */
 
+/** Get the permissions of a global for a client
+ *
+ * \param global a global
+ * \param client a client
+ * \return the permissions of \a client on \a global
+ *
+ * The result of the core permission callback is cached per client until
+ * the global is destroyed or the permissions are invalidated with
+ * \ref pw_core_invalidate_permissions.
+ *
+ * \memberof pw_global
+ */
 uint32_t pw_global_get_permissions(struct pw_global *global, struct pw_client *client)
 {
 	struct pw_core *core = client->core;
+	struct pw_array *cache = &client->permissions;
+	uint32_t permissions;
+	uint8_t *p;
 
 	if (core->permission_func == NULL)
 		return PW_PERM_RWX;
 
-	return core->permission_func(global, client, core->permission_data);
+	if (client->permission_serial != core->permission_serial) {
+		cache->size = 0;
+		client->permission_serial = core->permission_serial;
+	}
+
+	if (global->id < cache->size) {
+		p = SPA_MEMBER(cache->data, global->id, uint8_t);
+		if (*p & PERM_CACHED)
+			return PERM_FROM_CACHE(*p);
+	} else {
+		size_t old = cache->size;
+
+		if ((p = pw_array_add(cache, global->id + 1 - old)) != NULL)
+			memset(p, 0, global->id + 1 - old);
+	}
+
+	permissions = core->permission_func(global, client, core->permission_data);
+
+	if (global->id < cache->size)
+		*SPA_MEMBER(cache->data, global->id, uint8_t) = PERM_TO_CACHE(permissions);
+
+	return permissions;
 }
 
 /** Create and add a new global to the core
@@ -203,6 +244,7 @@ void pw_global_destroy(struct pw_global *global)
 {
 	struct pw_core *core = global->core;
 	struct pw_resource *registry;
+	struct pw_client *client;
 
 	pw_log_debug("global %p: destroy %u", global, global->id);
 
@@ -212,6 +254,12 @@ void pw_global_destroy(struct pw_global *global)
 			pw_registry_resource_global_remove(registry, global->id);
 	}
 
+	/* the id can be reused for a new global */
+	spa_list_for_each(client, &core->client_list, link) {
+		if (global->id < client->permissions.size)
+			*SPA_MEMBER(client->permissions.data, global->id, uint8_t) = 0;
+	}
+
 	pw_map_remove(&core->globals, global->id);
 
 	spa_list_remove(&global->link);
@@ -19,6 +19,7 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 
 #include <spa/lib/debug.h>
 #include <spa/video/format.h>
@@ -32,8 +33,14 @@
 #include "interfaces.h"
 #include "link.h"
 #include "work-queue.h"
+#include "data-loop.h"
 
 #define MAX_BUFFERS     16
+#define HUGEPAGE_THRESHOLD	(4 * 1024 * 1024)
+
+#define CONVERT_LIB		"audioconvert/libspa-audioconvert"
+#define CONVERT_FACTORY		"audioconvert"
+#define RESAMPLE_FACTORY	"resample"
 
 /** \cond */
 struct impl {
@@ -50,6 +57,29 @@ struct impl {
 	struct spa_hook input_node_listener;
 	struct spa_hook output_port_listener;
 	struct spa_hook output_node_listener;
+
+	struct pw_node *convert;		/**< converter inserted before the input */
+	struct pw_link *convert_link;		/**< link from the converter to the input */
+	struct spa_hook convert_link_listener;
+	struct pw_port *target;			/**< the input port when converting */
+
+	bool inserted;				/**< link made for an inserted node */
+	struct pw_node *resample;		/**< resampler between two clocks */
+	struct pw_link *resample_link;		/**< link from the resampler to the input */
+	struct spa_hook resample_link_listener;
+	struct spa_source *unlinked;		/**< destroys the link when an inserted
+						  *  link went away */
+
+	struct {
+		uint32_t props;
+		uint32_t prop_rate;
+		struct spa_dll dll;		/**< loop that keeps the fill level */
+		bool locked;			/**< if the loop is running */
+		int64_t ticks;			/**< last ticks of the output clock */
+		double start;			/**< input position when locking */
+		double produced;		/**< samples for the input since locking */
+		double rate;			/**< current rate of the resampler */
+	} drift;				/**< only accessed from the data thread */
 };
 
 struct resource_data {
@@ -111,6 +141,10 @@ static void complete_streaming(void *obj, void *data, int res, uint32_t id)
 	}
 }
 
+static int insert_convert(struct pw_link *this);
+static bool link_crosses_clocks(struct pw_link *this);
+static int insert_resample(struct pw_link *this);
+
 static int do_negotiate(struct pw_link *this, uint32_t in_state, uint32_t out_state)
 {
 	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
@@ -126,12 +160,33 @@ static int do_negotiate(struct pw_link *this, uint32_t in_state, uint32_t out_st
 
 	pw_link_update_state(this, PW_LINK_STATE_NEGOTIATING, NULL);
 
+	/* samples from another clock go through a resampler that follows the
+	 * drift, it is placed before a converter */
+	if (!impl->inserted && impl->resample == NULL && link_crosses_clocks(this)) {
+		if (insert_resample(this) == SPA_RESULT_OK)
+			in_state = this->input->state;
+		else
+			pw_log_warn("link %p: no resampler, clock drift is not compensated", this);
+	}
+
 	input = this->input;
 	output = this->output;
 
 	format = pw_core_find_format(this->core, output, input, NULL, 0, NULL, &error);
-	if (format == NULL)
-		goto error;
+	if (format == NULL) {
+		/* no common format, try again through a converter */
+		if (insert_convert(this) != SPA_RESULT_OK)
+			goto error;
+
+		free(error);
+		error = NULL;
+		input = this->input;
+		in_state = input->state;
+
+		format = pw_core_find_format(this->core, output, input, NULL, 0, NULL, &error);
+		if (format == NULL)
+			goto error;
+	}
 
 	format = spa_format_copy(format);
 
@@ -248,6 +303,88 @@ static struct spa_param *find_meta_enable(struct pw_core *core, struct spa_param
 	return NULL;
 }
 
+static inline struct pw_client *port_owner(struct pw_port *port)
+{
+	return port->node->global ? port->node->global->owner : NULL;
+}
+
+/* the buffer memory is shared with the clients of both ends of the link,
+ * only take it from the pool when that is at most one client */
+static const void *buffer_mem_tag(struct pw_link *this)
+{
+	struct pw_client *out = port_owner(this->output);
+	struct pw_client *in = port_owner(this->input);
+
+	if (out == NULL)
+		return in ? (const void *) in : (const void *) this->core;
+	if (in == NULL || in == out)
+		return out;
+	return NULL;
+}
+
+static bool use_hugepages(struct pw_link *this, size_t size)
+{
+	const char *str;
+
+	if (this->properties &&
+	    (str = pw_properties_get(this->properties, PW_LINK_PROP_HUGEPAGES)))
+		return pw_properties_parse_bool(str);
+
+	return size >= HUGEPAGE_THRESHOLD;
+}
+
+/* the NUMA node for the buffers, the node of the data loop that
+ * processes the link unless the link properties ask for one. The data
+ * loop node is a snapshot, it is only a hint for the placement */
+static int get_numa_node(struct pw_link *this)
+{
+	const char *str;
+
+	if (this->properties &&
+	    (str = pw_properties_get(this->properties, PW_LINK_PROP_NUMA_NODE)))
+		return pw_properties_parse_int(str);
+
+	return pw_data_loop_get_numa_node(this->core->data_loop_impl);
+}
+
+static bool update_prop(struct pw_link *this, const char *key, const char *value)
+{
+	const char *str;
+
+	if (this->properties == NULL) {
+		if ((this->properties = pw_properties_new(NULL, NULL)) == NULL)
+			return false;
+		this->info.props = &this->properties->dict;
+	}
+	str = pw_properties_get(this->properties, key);
+	if (str == value || (str && value && strcmp(str, value) == 0))
+		return false;
+
+	pw_properties_set(this->properties, key, value);
+	return true;
+}
+
+static void update_buffer_info(struct pw_link *this, size_t page_size, int numa_node)
+{
+	struct pw_resource *resource;
+	char page_str[32], node_str[16];
+	bool changed;
+
+	snprintf(page_str, sizeof(page_str), "%zu", page_size);
+	snprintf(node_str, sizeof(node_str), "%d", numa_node);
+
+	changed = update_prop(this, PW_LINK_PROP_PAGE_SIZE, page_str);
+	changed |= update_prop(this, PW_LINK_PROP_BUFFER_NUMA_NODE,
+			       numa_node >= 0 ? node_str : NULL);
+	if (!changed)
+		return;
+
+	this->info.change_mask |= PW_LINK_CHANGE_MASK_PROPS;
+	spa_list_for_each(resource, &this->resource_list, link)
+		pw_link_resource_info(resource, &this->info);
+	this->info.change_mask = 0;
+}
+
 static struct spa_buffer **alloc_buffers(struct pw_link *this,
 					 uint32_t n_buffers,
 					 uint32_t n_params,
@@ -255,6 +392,7 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 					 uint32_t n_datas,
 					 size_t *data_sizes,
 					 ssize_t *data_strides,
+					 const void *tag,
 					 struct pw_memblock *mem)
 {
 	struct spa_buffer **buffers, *bp;
@@ -264,6 +402,8 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 	void *ddp;
 	uint32_t n_metas;
 	struct spa_meta *metas;
+	enum pw_memblock_flags flags;
+	int numa_node;
 
 	n_metas = data_size = meta_size = 0;
 
@@ -314,9 +454,29 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 	/* pointer to buffer structures */
 	bp = SPA_MEMBER(buffers, n_buffers * sizeof(struct spa_buffer *), struct spa_buffer);
 
-	pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
-			  PW_MEMBLOCK_FLAG_MAP_READWRITE |
-			  PW_MEMBLOCK_FLAG_SEAL, n_buffers * data_size, mem);
+	flags = PW_MEMBLOCK_FLAG_WITH_FD |
+		PW_MEMBLOCK_FLAG_MAP_READWRITE |
+		PW_MEMBLOCK_FLAG_SEAL;
+	if (use_hugepages(this, n_buffers * data_size))
+		flags |= PW_MEMBLOCK_FLAG_HUGEPAGE;
+
+	pw_mempool_alloc(this->core->mempool, flags, n_buffers * data_size, tag, mem);
+
+	/* bind the memory before the buffers are initialized so that the
+	 * pages are first touched on the right node */
+	if ((numa_node = get_numa_node(this)) >= 0 &&
+	    pw_memblock_set_numa_node(mem, numa_node) != SPA_RESULT_OK)
+		numa_node = -1;
+
+	update_buffer_info(this, mem->page_size, numa_node);
+
+	if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG)) {
+		struct pw_mempool_stats stats;
+
+		pw_mempool_get_stats(this->core->mempool, &stats);
+		pw_log_debug("link %p: mempool hits %u/%u resident %zd used %zd", this,
+			     stats.n_hits, stats.n_allocs, stats.resident, stats.used);
+	}
 
 	for (i = 0; i < n_buffers; i++) {
 		int j;
@@ -342,7 +502,7 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 
 				msh->flags = 0;
 				msh->fd = mem->fd;
-				msh->offset = data_size * i;
+				msh->offset = mem->offset + data_size * i;
 				msh->size = data_size;
 			} else if (m->type == this->core->type.meta.Ringbuffer) {
 				struct spa_meta_ringbuffer *rb = p;
@@ -365,9 +525,9 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 				d->type = this->core->type.data.MemFd;
 				d->flags = 0;
 				d->fd = mem->fd;
-				d->mapoffset = SPA_PTRDIFF(ddp, mem->ptr);
+				d->mapoffset = mem->offset + SPA_PTRDIFF(ddp, mem->ptr);
 				d->maxsize = data_sizes[j];
-				d->data = SPA_MEMBER(mem->ptr, d->mapoffset, void);
+				d->data = ddp;
 				d->chunk->offset = 0;
 				d->chunk->size = data_sizes[j];
 				d->chunk->stride = data_strides[j];
@@ -431,6 +591,83 @@ param_filter(struct pw_link *this,
 	return num;
 }
 
+static inline bool has_one_link(struct spa_list *links)
+{
+	return !spa_list_is_empty(links) && links->next->next == links;
+}
+
+/* When @port is on a node that can share the buffers of its ports, find
+ * the port on the other side of the node that has the buffers. IN_PLACE
+ * alone is not enough, the audiomixer sets it on its inputs but still
+ * reads them while it writes the output. */
+static struct pw_port *find_in_place_port(struct pw_port *port)
+{
+	struct pw_node *node = port->node;
+	struct pw_port *in, *out, *other;
+	struct pw_link *l;
+	const struct spa_port_info *info;
+
+	if (node->info.n_input_ports != 1 || node->info.n_output_ports != 1)
+		return NULL;
+
+	in = spa_list_first(&node->input_ports, struct pw_port, link);
+	out = spa_list_first(&node->output_ports, struct pw_port, link);
+
+	if (spa_node_port_get_info(node->node, in->direction, in->port_id, &info) < 0 ||
+	    !(info->flags & SPA_PORT_INFO_FLAG_SHARE_BUFFERS))
+		return NULL;
+
+	/* the node writes into its input buffers, they can't be shared with
+	 * other consumers */
+	if (!has_one_link(&in->links))
+		return NULL;
+	l = spa_list_first(&in->links, struct pw_link, input_link);
+	if (!has_one_link(&l->output->links))
+		return NULL;
+
+	other = port == in ? out : in;
+	if (other->n_buffers == 0)
+		return NULL;
+
+	return other;
+}
+
+/* Give @input buffers of its own, with the layout of the buffers it has
+ * now, to mix the links into. The memory is only shared with the client
+ * of the input port. */
+static int alloc_mix_buffers(struct pw_link *this, struct pw_port *input,
+			     uint32_t n_params, struct spa_param **params)
+{
+	struct pw_client *owner = port_owner(input);
+	struct spa_buffer **buffers, *b = input->buffers[0];
+	struct pw_memblock mem;
+	size_t *data_sizes;
+	ssize_t *data_strides;
+	uint32_t i;
+	int res;
+
+	data_sizes = alloca(b->n_datas * sizeof(size_t));
+	data_strides = alloca(b->n_datas * sizeof(ssize_t));
+	for (i = 0; i < b->n_datas; i++) {
+		data_sizes[i] = b->datas[i].data ? b->datas[i].maxsize : 0;
+		data_strides[i] = b->datas[i].chunk->stride;
+	}
+
+	buffers = alloc_buffers(this, input->n_buffers, n_params, params,
+				b->n_datas, data_sizes, data_strides,
+				owner ? (const void *) owner : (const void *) this->core,
+				&mem);
+
+	pw_log_debug("link %p: allocated %d mix buffers %p for input port %p", this,
+		     input->n_buffers, buffers, input);
+
+	if ((res = pw_port_use_mix_buffers(input, buffers, input->n_buffers, &mem)) < 0) {
+		free(buffers);
+		pw_mempool_free(this->core->mempool, &mem);
+	}
+	return res;
+}
+
 static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_state)
 {
 	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
@@ -438,7 +675,8 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 	const struct spa_port_info *iinfo, *oinfo;
 	uint32_t in_flags, out_flags;
 	char *error = NULL;
-	struct pw_port *input, *output;
+	struct pw_port *input, *output, *shared;
+	bool mix = false;
 
 	if (in_state != PW_PORT_STATE_READY && out_state != PW_PORT_STATE_READY)
 		return SPA_RESULT_OK;
@@ -503,6 +741,22 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 		return SPA_RESULT_OK;
 	}
 
+	if (input->n_buffers && input->mix == NULL && !has_one_link(&input->links)) {
+		/* the input port already has the buffers of another link, this
+		 * link gets its own buffers and the port gets buffers of its own
+		 * to mix the links into */
+		if (input->allocated && !input->mix_buffers) {
+			/* the buffers belong to the node, replacing them would
+			 * break the other link */
+			asprintf(&error, "can't mix into buffers allocated by the input node");
+			pw_link_update_state(this, PW_LINK_STATE_ERROR, error);
+			return SPA_RESULT_ERROR;
+		}
+		pw_log_debug("link %p: mixing into input port %p", this, input);
+		in_flags = 0;
+		mix = !input->mix_buffers;
+	}
+
 	if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG)) {
 		spa_debug_port_info(oinfo);
 		spa_debug_port_info(iinfo);
@@ -510,17 +764,23 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 
 	if (this->buffers == NULL) {
 		struct spa_param **params, *param;
-		uint8_t buffer[4096];
-		struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+		struct pw_arena_builder b;
 		int i, offset, n_params;
 		uint32_t max_buffers;
 		size_t minsize = 1024, stride = 0;
 
-		n_params = param_filter(this, input, output, &b);
+		/* the params only live for this allocation round */
+		pw_arena_builder_init(&b, &this->core->arena);
+		n_params = param_filter(this, input, output, &b.b);
 
-		params = alloca(n_params * sizeof(struct spa_param *));
+		params = pw_arena_alloc(&this->core->arena, n_params * sizeof(struct spa_param *));
+		if (params == NULL) {
+			asprintf(&error, "no memory for params");
+			res = SPA_RESULT_NO_MEMORY;
+			goto error;
+		}
 		for (i = 0, offset = 0; i < n_params; i++) {
-			params[i] = SPA_MEMBER(buffer, offset, struct spa_param);
+			params[i] = SPA_MEMBER(b.b.data, offset, struct spa_param);
 			spa_param_fixate(params[i]);
 			pw_log_debug("fixated param %d:", i);
 			if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
@@ -585,7 +845,7 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 			this->buffer_owner = output;
 			pw_log_debug("link %p: reusing %d output buffers %p", this, this->n_buffers,
 				     this->buffers);
-		} else if (input->n_buffers && input->mix == NULL) {
+		} else if (input->n_buffers && input->mix == NULL && has_one_link(&input->links)) {
 			out_flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
 			in_flags = 0;
 			this->n_buffers = input->n_buffers;
@@ -593,6 +853,18 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 			this->buffer_owner = input;
 			pw_log_debug("link %p: reusing %d input buffers %p", this, this->n_buffers,
 				     this->buffers);
+		} else if ((out_flags & SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS) &&
+			   (in_flags & SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS) &&
+			   ((shared = find_in_place_port(output)) != NULL ||
+			    (shared = find_in_place_port(input)) != NULL)) {
+			/* pass the buffers through the in place node */
+			out_flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+			in_flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+			this->n_buffers = shared->n_buffers;
+			this->buffers = shared->buffers;
+			this->buffer_owner = shared;
+			pw_log_debug("link %p: sharing %d buffers %p of in place port %p", this,
+				     this->n_buffers, this->buffers, shared);
 		} else {
 			size_t data_sizes[1];
 			ssize_t data_strides[1];
@@ -608,6 +880,7 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 						      params,
 						      1,
 						      data_sizes, data_strides,
+						      buffer_mem_tag(this),
 						      &this->buffer_mem);
 
 			pw_log_debug("link %p: allocating %d buffers %p %zd %zd", this,
@@ -641,6 +914,11 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 			pw_log_debug("link %p: allocated %d buffers %p from input port", this,
 				     this->n_buffers, this->buffers);
 		}
+
+		if (mix && (res = alloc_mix_buffers(this, input, n_params, params)) < 0) {
+			asprintf(&error, "error use input mix buffers: %d", res);
+			goto error;
+		}
 	}
 
 	if (in_flags & SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS) {
@@ -665,10 +943,12 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 		asprintf(&error, "no common buffer alloc found");
 		goto error;
 	}
+	pw_arena_reset(&this->core->arena);
 
 	return SPA_RESULT_OK;
 
       error:
+	pw_arena_reset(&this->core->arena);
 	output->buffers = NULL;
 	output->n_buffers = 0;
 	output->allocated = false;
@@ -810,6 +1090,10 @@ output_node_async_complete(void *data, uint32_t seq, int res)
 
 static void clear_port_buffers(struct pw_link *link, struct pw_port *port)
 {
+	/* the other links still mix into the buffers of the port */
+	if (port->mix_buffers && !has_one_link(&port->links))
+		return;
+
 	if (link->buffer_owner != port)
 		pw_port_use_buffers(port, NULL, 0);
 }
@@ -819,7 +1103,7 @@ do_remove_input(struct spa_loop *loop,
 	        bool async, uint32_t seq, size_t size, const void *data, void *user_data)
 {
 	struct pw_link *this = user_data;
-	spa_graph_port_remove(&this->rt.in_port);
+	pw_port_remove_mix_port(this->input, &this->rt.in_port);
 	return SPA_RESULT_OK;
 }
 
@@ -842,7 +1126,7 @@ do_remove_output(struct spa_loop *loop,
 	         bool async, uint32_t seq, size_t size, const void *data, void *user_data)
 {
 	struct pw_link *this = user_data;
-	spa_graph_port_remove(&this->rt.out_port);
+	pw_port_remove_mix_port(this->output, &this->rt.out_port);
 	return SPA_RESULT_OK;
 }
 
@@ -1026,14 +1310,89 @@ do_add_link(struct spa_loop *loop,
         struct pw_port *port = ((struct pw_port **) data)[0];
 
         if (port->direction == PW_DIRECTION_OUTPUT) {
-                spa_graph_port_add(&port->rt.mix_node, &this->rt.out_port);
+                pw_port_add_mix_port(port, &this->rt.out_port);
         } else {
-                spa_graph_port_add(&port->rt.mix_node, &this->rt.in_port);
+                pw_port_add_mix_port(port, &this->rt.in_port);
         }
 
         return SPA_RESULT_OK;
 }
 
+static void set_resample_rate(struct impl *impl, double rate)
+{
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+	uint8_t buffer[128];
+	struct spa_props *props;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	spa_pod_builder_props(&b, &f[0], impl->drift.props,
+		SPA_POD_PROP(&f[1], impl->drift.prop_rate, 0, SPA_POD_TYPE_DOUBLE, 1, rate));
+	props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	spa_node_set_props(impl->resample->node, props);
+	impl->drift.rate = rate;
+}
+
+/* Keep the number of samples between the two clocks constant. The output
+ * clock counts the samples that go into the resampler, the estimate of the
+ * input clock gives the samples that were consumed at the same time. The
+ * loop changes the rate of the resampler until both stay the same. */
+static void update_drift(struct impl *impl)
+{
+	struct pw_clock_estimate *out = &impl->this.output->node->rt.clock;
+	struct pw_clock_estimate *in = &impl->target->node->rt.clock;
+	double consumed, err;
+
+	if (out->rate == 0 || in->rate == 0 || in->dll.bw == 0.0) {
+		impl->drift.locked = false;
+		return;
+	}
+
+	consumed = in->position + (double) (out->monotonic_time - in->monotonic_time) *
+			in->rate * in->rate_diff / SPA_NSEC_PER_SEC;
+
+	if (!impl->drift.locked) {
+		spa_dll_init(&impl->drift.dll);
+		impl->drift.locked = true;
+		impl->drift.ticks = out->ticks;
+		impl->drift.start = consumed;
+		impl->drift.produced = 0.0;
+		set_resample_rate(impl, 1.0);
+		return;
+	}
+	if (out->ticks <= impl->drift.ticks)
+		return;
+
+	if (impl->drift.dll.bw == 0.0)
+		spa_dll_set_bw(&impl->drift.dll, SPA_DLL_BW_MIN,
+			       out->ticks - impl->drift.ticks, out->rate);
+
+	impl->drift.produced += (double) (out->ticks - impl->drift.ticks) *
+			in->rate / out->rate / impl->drift.rate;
+	impl->drift.ticks = out->ticks;
+
+	err = consumed - impl->drift.start - impl->drift.produced;
+
+	/* after an xrun the fill level starts again */
+	if (fabs(err) > in->rate / 10) {
+		pw_log_debug("link %p: fill error %f, resync", impl, err);
+		impl->drift.locked = false;
+		return;
+	}
+	set_resample_rate(impl, spa_dll_update(&impl->drift.dll, err));
+
+	pw_node_report_clock(impl->resample, impl->drift.rate, err);
+}
+
+static void output_node_have_output(void *data)
+{
+	struct impl *impl = data;
+
+	if (impl->resample && impl->target)
+		update_drift(impl);
+}
+
 static const struct pw_port_events input_port_events = {
 	PW_VERSION_PORT_EVENTS,
 	.destroy = input_port_destroy,
@@ -1052,8 +1411,243 @@ static const struct pw_node_events input_node_events = {
 static const struct pw_node_events output_node_events = {
 	PW_VERSION_NODE_EVENTS,
 	.async_complete = output_node_async_complete,
+	.have_output = output_node_have_output,
 };
 
+static bool port_is_raw_audio(struct pw_port *port)
+{
+	struct spa_type_map *map = port->node->core->type.map;
+	struct spa_format *format;
+
+	if (spa_node_port_enum_formats(port->node->node, port->direction, port->port_id,
+				       &format, NULL, 0) < 0)
+		return false;
+
+	return SPA_FORMAT_MEDIA_TYPE(format) ==
+			spa_type_map_get_id(map, SPA_TYPE_MEDIA_TYPE__audio) &&
+	       SPA_FORMAT_MEDIA_SUBTYPE(format) ==
+			spa_type_map_get_id(map, SPA_TYPE_MEDIA_SUBTYPE__raw);
+}
+
+/* move the input side of the link to another port */
+static void relink_input(struct pw_link *this, struct pw_port *port)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct pw_port *old = this->input;
+
+	input_remove(this, old);
+	spa_list_remove(&this->input_link);
+	spa_hook_list_call(&old->listener_list, struct pw_port_events, link_removed, this);
+
+	if (impl->active) {
+		old->node->n_used_input_links--;
+		port->node->n_used_input_links++;
+	}
+
+	this->input = port;
+	spa_list_insert(port->links.prev, &this->input_link);
+
+	pw_port_add_listener(port, &impl->input_port_listener, &input_port_events, impl);
+	pw_node_add_listener(port->node, &impl->input_node_listener, &input_node_events, impl);
+
+	pw_loop_invoke(port->node->data_loop, do_add_link,
+		       SPA_ID_INVALID, sizeof(struct pw_port *), &port, false, this);
+
+	spa_hook_list_call(&port->listener_list, struct pw_port_events, link_added, this);
+}
+
+static int
+do_clear_target(struct spa_loop *loop,
+		bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct impl *impl = user_data;
+	impl->target = NULL;
+	return SPA_RESULT_OK;
+}
+
+static void do_unlinked(void *data, uint64_t count)
+{
+	struct impl *impl = data;
+	pw_link_destroy(&impl->this);
+}
+
+/* The link from an inserted node went away, usually with the input port,
+ * and this link has nothing left to link. It is destroyed from the main
+ * loop because the other link is still being destroyed. */
+static void inserted_link_destroyed(struct impl *impl)
+{
+	struct pw_link *this = &impl->this;
+
+	/* the data thread stops following the clock of the target */
+	pw_loop_invoke(this->output->node->data_loop,
+		       do_clear_target, SPA_ID_INVALID, 0, NULL, true, impl);
+
+	pw_link_update_state(this, PW_LINK_STATE_UNLINKED, NULL);
+
+	if (impl->unlinked == NULL)
+		impl->unlinked = pw_loop_add_event(this->core->main_loop, do_unlinked, impl);
+	pw_loop_signal_event(this->core->main_loop, impl->unlinked);
+}
+
+static void convert_link_destroy(void *data)
+{
+	struct impl *impl = data;
+
+	pw_log_debug("link %p: converter link destroyed", impl);
+	impl->convert_link = NULL;
+	inserted_link_destroyed(impl);
+}
+
+static const struct pw_link_events convert_link_events = {
+	PW_VERSION_LINK_EVENTS,
+	.destroy = convert_link_destroy,
+};
+
+static void resample_link_destroy(void *data)
+{
+	struct impl *impl = data;
+
+	pw_log_debug("link %p: resampler link destroyed", impl);
+	impl->resample_link = NULL;
+	inserted_link_destroyed(impl);
+}
+
+static const struct pw_link_events resample_link_events = {
+	PW_VERSION_LINK_EVENTS,
+	.destroy = resample_link_destroy,
+};
+
+/* Make a node from the audioconvert plugin and place it between the ports
+ * of the link. The link continues from the output to the new node and a
+ * second link goes from the new node to the input. The link info keeps the
+ * original ports. */
+static int insert_node(struct pw_link *this, const char *factory_name,
+		       struct pw_node **node_p, struct pw_link **link_p)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct pw_core *core = this->core;
+	struct pw_factory *factory;
+	struct pw_node *node;
+	struct pw_link *link;
+	struct impl *li;
+	struct pw_port *in, *out, *input = this->input;
+	struct pw_properties *props;
+	char *error = NULL;
+
+	if (!port_is_raw_audio(this->output) || !port_is_raw_audio(input))
+		return SPA_RESULT_NOT_IMPLEMENTED;
+
+	if ((factory = pw_core_find_factory(core, "spa-node-factory")) == NULL) {
+		pw_log_debug("link %p: no node factory for %s", this, factory_name);
+		return SPA_RESULT_NOT_IMPLEMENTED;
+	}
+
+	props = pw_properties_new("spa.library.name", CONVERT_LIB,
+				  "spa.factory.name", factory_name,
+				  "name", factory_name, NULL);
+	node = pw_factory_create_object(factory, NULL, core->type.node, PW_VERSION_NODE, props, 0);
+	if (node == NULL)
+		return SPA_RESULT_ERROR;
+
+	in = pw_node_get_free_port(node, PW_DIRECTION_INPUT);
+	out = pw_node_get_free_port(node, PW_DIRECTION_OUTPUT);
+	if (in == NULL || out == NULL)
+		goto no_ports;
+
+	/* the node runs in the domain of the output */
+	node->live = this->output->node->live;
+	node->clock = this->output->node->clock;
+
+	link = pw_link_new(core, out, input, NULL, NULL, &error, 0);
+	if (link == NULL)
+		goto no_link;
+
+	li = SPA_CONTAINER_OF(link, struct impl, this);
+	li->inserted = true;
+
+	pw_log_debug("link %p: inserted %s node %p", this, factory_name, node);
+
+	if (impl->target == NULL)
+		impl->target = input;
+	relink_input(this, in);
+
+	*node_p = node;
+	*link_p = link;
+
+	return SPA_RESULT_OK;
+
+      no_ports:
+	pw_log_error("link %p: %s has no free ports", this, factory_name);
+	pw_node_destroy(node);
+	return SPA_RESULT_ERROR;
+      no_link:
+	pw_log_error("link %p: can't link %s: %s", this, factory_name, error);
+	free(error);
+	pw_node_destroy(node);
+	return SPA_RESULT_ERROR;
+}
+
+/* convert between formats when the ports have none in common */
+static int insert_convert(struct pw_link *this)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	int res;
+
+	if (impl->convert != NULL)
+		return SPA_RESULT_NOT_IMPLEMENTED;
+
+	if ((res = insert_node(this, CONVERT_FACTORY, &impl->convert, &impl->convert_link)) < 0)
+		return res;
+
+	pw_link_add_listener(impl->convert_link, &impl->convert_link_listener,
+			     &convert_link_events, impl);
+	pw_link_register(impl->convert_link, NULL, this->global);
+
+	return SPA_RESULT_OK;
+}
+
+/* the output is timed by a clock that is not the one that consumes the
+ * samples on the input */
+static bool link_crosses_clocks(struct pw_link *this)
+{
+	struct pw_node *out = this->output->node, *in = this->input->node;
+	const struct spa_port_info *info;
+
+	if (out->clock == NULL || in->clock == NULL || out->clock == in->clock)
+		return false;
+
+	if (spa_node_port_get_info(out->node, this->output->direction, this->output->port_id,
+				   &info) < 0 || !(info->flags & SPA_PORT_INFO_FLAG_LIVE))
+		return false;
+
+	return port_is_raw_audio(this->output) && port_is_raw_audio(this->input);
+}
+
+/* resample with a rate that follows the drift between the clocks */
+static int insert_resample(struct pw_link *this)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct pw_core *core = this->core;
+	int res;
+
+	if ((res = insert_node(this, RESAMPLE_FACTORY, &impl->resample, &impl->resample_link)) < 0)
+		return res;
+
+	impl->drift.props = core->type.spa_props;
+	impl->drift.prop_rate = spa_type_map_get_id(core->type.map, SPA_TYPE_PROPS__rate);
+	impl->drift.locked = false;
+	impl->drift.rate = 1.0;
+
+	pw_log_debug("link %p: compensating drift from clock %p to %p", this,
+		     this->output->node->clock, impl->target->node->clock);
+
+	pw_link_add_listener(impl->resample_link, &impl->resample_link_listener,
+			     &resample_link_events, impl);
+	pw_link_register(impl->resample_link, NULL, this->global);
+
+	return SPA_RESULT_OK;
+}
+
 struct pw_link *pw_link_new(struct pw_core *core,
 			    struct pw_port *output,
 			    struct pw_port *input,
@@ -1115,8 +1709,10 @@ struct pw_link *pw_link_new(struct pw_core *core,
 	pw_log_debug("link %p: constructed %p:%d -> %p:%d", impl,
 		     output_node, output->port_id, input_node, input->port_id);
 
+	/* an input with its own clock stays in its domain, the drift is
+	 * compensated when the link is negotiated */
 	input_node->live = output_node->live;
-	if (output_node->clock)
+	if (input_node->clock == NULL)
 		input_node->clock = output_node->clock;
 
 	pw_log_debug("link %p: output node %p clock %p, live %d", this, output_node, output_node->clock,
@@ -1208,6 +1804,9 @@ void pw_link_destroy(struct pw_link *link)
 	pw_log_debug("link %p: destroy", impl);
 	spa_hook_list_call(&link->listener_list, struct pw_link_events, destroy);
 
+	if (impl->unlinked)
+		pw_loop_destroy_source(link->core->main_loop, impl->unlinked);
+
 	pw_link_deactivate(link);
 
 	if (link->global) {
@@ -1228,6 +1827,19 @@ void pw_link_destroy(struct pw_link *link)
 	spa_hook_list_call(&link->output->listener_list, struct pw_port_events, link_removed, link);
 	link->output = NULL;
 
+	if (impl->convert_link) {
+		spa_hook_remove(&impl->convert_link_listener);
+		pw_link_destroy(impl->convert_link);
+	}
+	if (impl->convert)
+		pw_node_destroy(impl->convert);
+	if (impl->resample_link) {
+		spa_hook_remove(&impl->resample_link_listener);
+		pw_link_destroy(impl->resample_link);
+	}
+	if (impl->resample)
+		pw_node_destroy(impl->resample);
+
 	spa_hook_list_call(&link->listener_list, struct pw_link_events, free);
 
 	pw_work_queue_destroy(impl->work);
@@ -1240,7 +1852,7 @@ void pw_link_destroy(struct pw_link *link)
 
 	if (link->buffer_owner == link) {
 		free(link->buffers);
-		pw_memblock_free(&link->buffer_mem);
+		pw_mempool_free(link->core->mempool, &link->buffer_mem);
 	}
 	free(impl);
 }
@@ -1259,7 +1871,9 @@ struct pw_link *pw_link_find(struct pw_port *output_port, struct pw_port *input_
 	struct pw_link *pl;
 
 	spa_list_for_each(pl, &output_port->links, output_link) {
-		if (pl->input == input_port)
+		struct impl *impl = SPA_CONTAINER_OF(pl, struct impl, this);
+
+		if (pl->input == input_port || impl->target == input_port)
 			return pl;
 	}
 	return NULL;
@@ -75,6 +75,20 @@ struct pw_link_events {
   * set to "1" or "0" */
 #define PW_LINK_PROP_PASSIVE	"pipewire.link.passive"
 
+/** Back the buffer memory of the link with huge pages, set to "1" or "0".
+  * When not set, huge pages are used for large buffers */
+#define PW_LINK_PROP_HUGEPAGES	"pipewire.link.hugepages"
+
+/** The page size of the buffer memory of the link, set by the link */
+#define PW_LINK_PROP_PAGE_SIZE	"pipewire.link.page-size"
+
+/** The NUMA node to place the buffer memory of the link on. When not set,
+  * the node of the data loop is used */
+#define PW_LINK_PROP_NUMA_NODE	"pipewire.link.numa-node"
+
+/** The NUMA node of the buffer memory of the link, set by the link */
+#define PW_LINK_PROP_BUFFER_NUMA_NODE	"pipewire.link.buffer-numa-node"
+
 /** Make a new link between two ports \memberof pw_link
  * \return a newly allocated link */
 struct pw_link *
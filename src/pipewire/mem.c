@@ -31,6 +31,8 @@
 #include <stdlib.h>
 #include <sys/syscall.h>
 
+#include <spa/list.h>
+
 #include <pipewire/log.h>
 #include <pipewire/mem.h>
 
@@ -76,6 +78,80 @@ static inline int memfd_create(const char *name, unsigned int flags)
 
 #undef USE_MEMFD
 
+#define THP_SYSFS	"/sys/kernel/mm/transparent_hugepage/"
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED	1
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE	(1 << 1)
+#endif
+#define MAX_NUMA_NODES	256
+
+static int read_sysfs(const char *path, char *buf, size_t size)
+{
+	int fd;
+	ssize_t len;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return -errno;
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len < 0)
+		return -errno;
+	buf[len] = '\0';
+	return len;
+}
+
+/* The size of the huge pages that back madvised shared memory or 0 when
+ * the kernel does not use them for shmem. shmem_enabled has the active
+ * mode in brackets, "never" and "deny" never give huge pages. */
+static size_t shmem_hugepage_size(void)
+{
+	static bool checked = false;
+	static size_t hugepage_size = 0;
+	char buf[128], *mode;
+
+	if (checked)
+		return hugepage_size;
+	checked = true;
+
+	if (read_sysfs(THP_SYSFS "shmem_enabled", buf, sizeof(buf)) < 0 ||
+	    (mode = strchr(buf, '[')) == NULL)
+		return 0;
+
+	if (strncmp(mode, "[never]", 7) == 0 || strncmp(mode, "[deny]", 6) == 0)
+		return 0;
+
+	if (read_sysfs(THP_SYSFS "hpage_pmd_size", buf, sizeof(buf)) < 0)
+		return 0;
+
+	hugepage_size = strtoul(buf, NULL, 10);
+	return hugepage_size;
+}
+
+/* Ask for transparent huge pages on the shared memory. The huge page size
+ * is only reported when the kernel has shmem huge pages enabled, otherwise
+ * the memory keeps using normal pages */
+static void set_page_size(struct pw_memblock *mem)
+{
+	mem->page_size = getpagesize();
+
+#ifdef MADV_HUGEPAGE
+	if ((mem->flags & PW_MEMBLOCK_FLAG_HUGEPAGE) && mem->ptr != NULL) {
+		size_t hugepage_size = shmem_hugepage_size();
+
+		if (hugepage_size == 0 || mem->size < hugepage_size)
+			return;
+
+		if (madvise(mem->ptr, mem->size, MADV_HUGEPAGE) == 0)
+			mem->page_size = hugepage_size;
+		else
+			pw_log_debug("memblock %p: no huge pages: %s", mem, strerror(errno));
+	}
+#endif
+}
+
 /** Map a memblock
  * \param mem a memblock
  * \return 0 on success, < 0 on error
@@ -147,6 +223,7 @@ int pw_memblock_alloc(enum pw_memblock_flags flags, size_t size, struct pw_membl
 	mem->flags = flags;
 	mem->size = size;
 	mem->ptr = NULL;
+	mem->page_size = getpagesize();
 
 	use_fd = ! !(flags & (PW_MEMBLOCK_FLAG_MAP_TWICE | PW_MEMBLOCK_FLAG_WITH_FD));
 
@@ -182,6 +259,8 @@ int pw_memblock_alloc(enum pw_memblock_flags flags, size_t size, struct pw_membl
 #endif
 		if (pw_memblock_map(mem) != SPA_RESULT_OK)
 			goto mmap_failed;
+
+		set_page_size(mem);
 	} else {
 		mem->ptr = malloc(size);
 		if (mem->ptr == NULL)
@@ -199,6 +278,41 @@ int pw_memblock_alloc(enum pw_memblock_flags flags, size_t size, struct pw_membl
 	return SPA_RESULT_NO_MEMORY;
 }
 
+/** Place the memory of a memblock on a NUMA node
+ * \param mem a mapped memblock
+ * \param node the NUMA node
+ * \return 0 on success, < 0 on error
+ *
+ * New pages of the memory are preferably allocated on \a node, pages
+ * that are already present are moved there.
+ * \memberof pw_memblock
+ */
+int pw_memblock_set_numa_node(struct pw_memblock *mem, int node)
+{
+#ifdef SYS_mbind
+	unsigned long mask[MAX_NUMA_NODES / (8 * sizeof(unsigned long))] = { 0, };
+	uintptr_t page_size = getpagesize(), start, end;
+
+	if (mem->ptr == NULL || node < 0 || node >= MAX_NUMA_NODES)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+
+	start = (uintptr_t) mem->ptr & ~(page_size - 1);
+	end = SPA_ROUND_UP_N((uintptr_t) mem->ptr + mem->size, page_size);
+
+	/* the kernel uses one bit less than maxnode */
+	if (syscall(SYS_mbind, start, end - start, MPOL_PREFERRED,
+		    mask, MAX_NUMA_NODES + 1, MPOL_MF_MOVE) < 0) {
+		pw_log_debug("memblock %p: can't bind to node %d: %s", mem, node, strerror(errno));
+		return SPA_RESULT_ERRNO;
+	}
+	return SPA_RESULT_OK;
+#else
+	return SPA_RESULT_NOT_IMPLEMENTED;
+#endif
+}
+
 /** Free a memblock
  * \param mem a memblock
  * \memberof pw_memblock
@@ -219,3 +333,278 @@ void pw_memblock_free(struct pw_memblock *mem)
 	mem->ptr = NULL;
 	mem->fd = -1;
 }
+
+#define POOL_MIN_SLOT		4096
+#define POOL_MAX_POW2_SLOT	(256 * 1024)	/* larger slots are page granular */
+#define POOL_REGION_SIZE	(256 * 1024)
+#define POOL_MAX_SLOTS		32	/* at most 64, the bits of the bitmap */
+
+/** \cond */
+struct region {
+	struct spa_list link;
+	const void *tag;		/**< tag of the allocations */
+	enum pw_memblock_flags flags;	/**< flags of the memfd */
+	struct pw_memblock mem;		/**< the memfd of the region */
+	size_t slot_size;		/**< size class of the slots */
+	uint32_t n_slots;		/**< number of slots in the region */
+	uint64_t used;			/**< bitmap of used slots */
+	uint64_t dirty;			/**< bitmap of slots that were used before */
+	bool dead;			/**< the tag was released, don't give out
+					  *  more slots */
+};
+
+struct pw_mempool {
+	struct spa_list regions;	/**< regions, most recently used first */
+	size_t max_resident;
+	struct pw_mempool_stats stats;
+};
+/** \endcond */
+
+/** Make a new memory pool
+ * \param max_resident max bytes of unused memfds to keep around
+ * \return a new memory pool or NULL on error
+ * \memberof pw_mempool
+ */
+struct pw_mempool *pw_mempool_new(size_t max_resident)
+{
+	struct pw_mempool *pool;
+
+	pool = calloc(1, sizeof(struct pw_mempool));
+	if (pool == NULL)
+		return NULL;
+
+	spa_list_init(&pool->regions);
+	pool->max_resident = max_resident;
+
+	return pool;
+}
+
+static void region_free(struct pw_mempool *pool, struct region *r)
+{
+	pw_log_debug("mempool %p: free region %p size %zd", pool, r, r->mem.size);
+	spa_list_remove(&r->link);
+	pool->stats.resident -= r->mem.size;
+	pw_memblock_free(&r->mem);
+	free(r);
+}
+
+/** Destroy a memory pool. All blocks should be freed
+ * \param pool the pool to destroy
+ * \memberof pw_mempool
+ */
+void pw_mempool_destroy(struct pw_mempool *pool)
+{
+	struct region *r, *t;
+
+	spa_list_for_each_safe(r, t, &pool->regions, link)
+		region_free(pool, r);
+	free(pool);
+}
+
+/* small blocks use power of two slots so that blocks of similar sizes
+ * share regions. Larger blocks get a region of their own and are only
+ * rounded up to whole pages, a power of two would almost double the
+ * memory of big video buffers */
+static inline size_t slot_size_for(size_t size)
+{
+	size_t s = POOL_MIN_SLOT;
+
+	if (size > POOL_MAX_POW2_SLOT)
+		return SPA_ROUND_UP_N(size, POOL_MIN_SLOT);
+
+	while (s < size)
+		s <<= 1;
+	return s;
+}
+
+static struct region *find_region(struct pw_mempool *pool, enum pw_memblock_flags flags,
+				  size_t slot_size, const void *tag)
+{
+	struct region *r;
+
+	/* memory is never handed to another tag, the fd of the region
+	 * might still be kept by the old receiver */
+	spa_list_for_each(r, &pool->regions, link) {
+		if (r->tag == tag && r->slot_size == slot_size && r->flags == flags &&
+		    !r->dead && r->used != (1ull << r->n_slots) - 1)
+			return r;
+	}
+	return NULL;
+}
+
+static struct region *region_new(struct pw_mempool *pool, enum pw_memblock_flags flags,
+				 size_t slot_size, const void *tag)
+{
+	struct region *r;
+	uint32_t n_slots;
+
+	n_slots = SPA_CLAMP(POOL_REGION_SIZE / slot_size, 1, POOL_MAX_SLOTS);
+
+	if ((r = calloc(1, sizeof(struct region))) == NULL)
+		return NULL;
+
+	if (pw_memblock_alloc(flags, slot_size * n_slots, &r->mem) != SPA_RESULT_OK) {
+		free(r);
+		return NULL;
+	}
+	r->tag = tag;
+	r->flags = flags;
+	r->slot_size = slot_size;
+	r->n_slots = n_slots;
+	spa_list_insert(&pool->regions, &r->link);
+	pool->stats.resident += r->mem.size;
+
+	pw_log_debug("mempool %p: new region %p size %zd slots %d", pool, r,
+		     r->mem.size, n_slots);
+
+	return r;
+}
+
+/** Allocate a block from the pool
+ * \param pool a memory pool
+ * \param flags memblock flags
+ * \param size size to allocate
+ * \param tag only share memory with allocations of the same tag
+ * \param[out] mem memblock structure to fill
+ * \return 0 on success, < 0 on error
+ *
+ * The memory of the block is cleared. The block should be freed with
+ * \ref pw_mempool_free.
+ * \memberof pw_mempool
+ */
+int pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_flags flags,
+		     size_t size, const void *tag, struct pw_memblock *mem)
+{
+	struct region *r;
+	size_t slot_size;
+	uint32_t slot;
+	bool dirty;
+
+	if (mem == NULL || size == 0)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	if (tag == NULL ||
+	    (flags & PW_MEMBLOCK_FLAG_MAP_TWICE) ||
+	    (flags & (PW_MEMBLOCK_FLAG_WITH_FD | PW_MEMBLOCK_FLAG_MAP_READWRITE)) !=
+	    (PW_MEMBLOCK_FLAG_WITH_FD | PW_MEMBLOCK_FLAG_MAP_READWRITE))
+		return pw_memblock_alloc(flags, size, mem);
+
+	pool->stats.n_allocs++;
+	slot_size = slot_size_for(size);
+
+	if ((r = find_region(pool, flags, slot_size, tag)) != NULL) {
+		pool->stats.n_hits++;
+		spa_list_remove(&r->link);
+		spa_list_insert(&pool->regions, &r->link);
+	} else if ((r = region_new(pool, flags, slot_size, tag)) == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	for (slot = 0; slot < r->n_slots && (r->used & (1ull << slot)); slot++);
+	if (slot == r->n_slots)
+		return SPA_RESULT_ERROR;
+
+	dirty = r->dirty & (1ull << slot);
+	r->used |= (1ull << slot);
+	r->dirty |= (1ull << slot);
+	pool->stats.used += slot_size;
+
+	mem->flags = flags;
+	mem->fd = r->mem.fd;
+	mem->offset = slot * slot_size;
+	mem->ptr = SPA_MEMBER(r->mem.ptr, mem->offset, void);
+	mem->size = size;
+	mem->page_size = r->mem.page_size;
+	/* new memory is zero and not touched yet, keep it that way so that
+	 * it can still be placed before the first use */
+	if (dirty)
+		memset(mem->ptr, 0, size);
+
+	pw_log_trace("mempool %p: alloc %zd from region %p slot %d", pool, size, r, slot);
+
+	return SPA_RESULT_OK;
+}
+
+static void trim(struct pw_mempool *pool)
+{
+	struct region *r, *t;
+
+	/* free the least recently used regions that are not used */
+	for (r = SPA_CONTAINER_OF(pool->regions.prev, struct region, link);
+	     &r->link != &pool->regions; r = t) {
+		t = SPA_CONTAINER_OF(r->link.prev, struct region, link);
+
+		if (pool->stats.resident - pool->stats.used <= pool->max_resident)
+			break;
+		if (r->used == 0)
+			region_free(pool, r);
+	}
+}
+
+/** Free a block
+ * \param pool a memory pool
+ * \param mem a memblock allocated with \ref pw_mempool_alloc
+ * \memberof pw_mempool
+ */
+void pw_mempool_free(struct pw_mempool *pool, struct pw_memblock *mem)
+{
+	struct region *r;
+
+	if (mem == NULL)
+		return;
+
+	if ((mem->flags & PW_MEMBLOCK_FLAG_WITH_FD) && mem->fd != -1) {
+		spa_list_for_each(r, &pool->regions, link) {
+			uint32_t slot;
+
+			if (r->mem.fd != mem->fd)
+				continue;
+
+			slot = mem->offset / r->slot_size;
+			r->used &= ~(1ull << slot);
+			pool->stats.used -= r->slot_size;
+
+			if (r->used == 0 && r->dead)
+				region_free(pool, r);
+			else
+				trim(pool);
+
+			mem->ptr = NULL;
+			mem->fd = -1;
+			return;
+		}
+	}
+	pw_memblock_free(mem);
+}
+
+/** Stop sharing memory with \a tag
+ * \param pool a memory pool
+ * \param tag the tag to release
+ *
+ * Regions of \a tag are not used for new allocations anymore and are
+ * freed when their last block is freed. This should be called before the
+ * memory of the tag object is reused.
+ * \memberof pw_mempool
+ */
+void pw_mempool_release_tag(struct pw_mempool *pool, const void *tag)
+{
+	struct region *r, *t;
+
+	spa_list_for_each_safe(r, t, &pool->regions, link) {
+		if (r->tag != tag)
+			continue;
+		if (r->used == 0)
+			region_free(pool, r);
+		else
+			r->dead = true;
+	}
+}
+
+/** Get statistics of the pool
+ * \param pool a memory pool
+ * \param[out] stats the statistics
+ * \memberof pw_mempool
+ */
+void pw_mempool_get_stats(struct pw_mempool *pool, struct pw_mempool_stats *stats)
+{
+	*stats = pool->stats;
+}
@@ -20,6 +20,8 @@
 #ifndef __PIPEWIRE_MEM_H__
 #define __PIPEWIRE_MEM_H__
 
+#include <sys/types.h>
+
 #include <spa/defs.h>
 
 #ifdef __cplusplus
@@ -34,6 +36,8 @@ enum pw_memblock_flags {
 	PW_MEMBLOCK_FLAG_MAP_READ = (1 << 2),
 	PW_MEMBLOCK_FLAG_MAP_WRITE = (1 << 3),
 	PW_MEMBLOCK_FLAG_MAP_TWICE = (1 << 4),
+	PW_MEMBLOCK_FLAG_HUGEPAGE = (1 << 5),	/**< try to back the memory with huge
+						  *  pages, falls back to normal pages */
 };
 
 #define PW_MEMBLOCK_FLAG_MAP_READWRITE (PW_MEMBLOCK_FLAG_MAP_READ | PW_MEMBLOCK_FLAG_MAP_WRITE)
@@ -46,6 +50,7 @@ struct pw_memblock {
 	off_t offset;			/**< offset of mappable memory */
 	void *ptr;			/**< ptr to mapped memory */
 	size_t size;			/**< size of mapped memory */
+	size_t page_size;		/**< page size of the memory */
 };
 
 int
@@ -54,9 +59,54 @@ pw_memblock_alloc(enum pw_memblock_flags flags, size_t size, struct pw_memblock
 int
 pw_memblock_map(struct pw_memblock *mem);
 
+int
+pw_memblock_set_numa_node(struct pw_memblock *mem, int node);
+
 void
 pw_memblock_free(struct pw_memblock *mem);
 
+/** \class pw_mempool
+ *
+ * \brief A pool of shared memory blocks
+ *
+ * The pool recycles sealed and mapped memfds so that repeated
+ * allocations avoid the memfd_create, ftruncate, seal and mmap calls.
+ * Blocks are rounded up to a power of two size class. Small classes are
+ * handed out as offset ranges of a larger shared region.
+ *
+ * Memory is only shared between allocations with the same tag, usually
+ * the client that receives the fd. Allocations with a NULL tag, or with
+ * flags the pool does not handle, are passed to \ref pw_memblock_alloc.
+ */
+struct pw_mempool;
+
+/** Statistics of a memory pool \memberof pw_mempool */
+struct pw_mempool_stats {
+	uint32_t n_allocs;	/**< number of allocations */
+	uint32_t n_hits;	/**< allocations that did not need a new memfd */
+	size_t resident;	/**< bytes of memfds owned by the pool */
+	size_t used;		/**< bytes currently allocated from the pool */
+};
+
+struct pw_mempool *
+pw_mempool_new(size_t max_resident);
+
+void
+pw_mempool_destroy(struct pw_mempool *pool);
+
+int
+pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_flags flags,
+		 size_t size, const void *tag, struct pw_memblock *mem);
+
+void
+pw_mempool_free(struct pw_mempool *pool, struct pw_memblock *mem);
+
+void
+pw_mempool_release_tag(struct pw_mempool *pool, const void *tag);
+
+void
+pw_mempool_get_stats(struct pw_mempool *pool, struct pw_mempool_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
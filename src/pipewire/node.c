@@ -21,6 +21,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <math.h>
+#include <time.h>
 
 #include <spa/clock.h>
 
@@ -33,11 +35,22 @@
 #include "pipewire/main-loop.h"
 #include "pipewire/work-queue.h"
 
+#define CLOCK_REPORT_INTERVAL	SPA_NSEC_PER_SEC
+
 /** \cond */
+struct clock_report {
+	double rate_diff;
+	double error;
+};
+
 struct impl {
 	struct pw_node this;
 
 	struct pw_work_queue *work;
+
+	struct spa_source *clock_event;		/**< wakes up the main loop for a report */
+	struct clock_report clock_report;	/**< written by the data thread */
+	uint32_t clock_report_seq;		/**< odd while \a clock_report is written */
 };
 
 struct resource_data {
@@ -354,6 +367,38 @@ void pw_node_register(struct pw_node *this,
 	pw_node_update_state(this, PW_NODE_STATE_SUSPENDED, NULL);
 }
 
+/* The report goes through an event source of the node instead of a
+ * pw_loop_invoke with the node pointer. The source is destroyed with the
+ * node, so a pending report can not touch a freed node. */
+static void do_report_clock(void *data, uint64_t count)
+{
+	struct impl *impl = data;
+	struct pw_node *node = &impl->this;
+	struct clock_report report;
+	char rate_diff[32], error[32];
+	struct spa_dict_item items[2];
+	struct spa_dict dict = SPA_DICT_INIT(2, items);
+	uint32_t seq;
+
+	seq = __atomic_load_n(&impl->clock_report_seq, __ATOMIC_ACQUIRE);
+	if (seq & 1)
+		return;
+	report = impl->clock_report;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	/* a new report is being written and signals again */
+	if (__atomic_load_n(&impl->clock_report_seq, __ATOMIC_RELAXED) != seq)
+		return;
+
+	snprintf(rate_diff, sizeof(rate_diff), "%.9f", report.rate_diff);
+	snprintf(error, sizeof(error), "%.3f", report.error);
+	items[0].key = PW_NODE_PROP_CLOCK_RATE_DIFF;
+	items[0].value = rate_diff;
+	items[1].key = PW_NODE_PROP_CLOCK_ERROR;
+	items[1].value = error;
+
+	pw_node_update_properties(node, &dict);
+}
+
 struct pw_node *pw_node_new(struct pw_core *core,
 			    const char *name,
 			    struct pw_properties *properties,
@@ -381,6 +426,7 @@ struct pw_node *pw_node_new(struct pw_core *core,
 	this->properties = properties;
 
 	impl->work = pw_work_queue_new(this->core->main_loop);
+	impl->clock_event = pw_loop_add_event(this->core->main_loop, do_report_clock, impl);
 	this->info.name = strdup(name);
 
 	this->data_loop = core->data_loop;
@@ -462,6 +508,24 @@ static void node_done(void *data, int seq, int res)
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, async_complete, seq, res);
 }
 
+/* the formats of the ports are enumerated again on the next negotiation.
+ * The props of the port info are published in the node properties so
+ * that clients see them and get an info event when they change */
+static void ports_info_changed(struct pw_node *node, struct spa_list *ports)
+{
+	struct pw_port *port;
+	const struct spa_port_info *info;
+
+	spa_list_for_each(port, ports, link) {
+		pw_port_reset_formats(port);
+
+		if (spa_node_port_get_info(node->node, port->direction, port->port_id, &info) < 0)
+			continue;
+		if (info->props && info->props->n_items > 0)
+			pw_node_update_properties(node, info->props);
+	}
+}
+
 static void node_event(void *data, struct spa_event *event)
 {
 	struct pw_node *node = data;
@@ -470,12 +534,88 @@ static void node_event(void *data, struct spa_event *event)
         if (SPA_EVENT_TYPE(event) == node->core->type.event_node.RequestClockUpdate) {
                 send_clock_update(node);
         }
+	else if (SPA_EVENT_TYPE(event) == node->core->type.event_node.PortInfoChanged) {
+		ports_info_changed(node, &node->input_ports);
+		ports_info_changed(node, &node->output_ports);
+	}
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, event, event);
 }
 
+void pw_node_report_clock(struct pw_node *node, double rate_diff, double error)
+{
+	struct impl *impl = SPA_CONTAINER_OF(node, struct impl, this);
+	struct pw_clock_estimate *c = &node->rt.clock;
+	struct timespec ts;
+	int64_t now;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = SPA_TIMESPEC_TO_TIME(&ts);
+	if (now < c->next_report)
+		return;
+
+	c->next_report = now + CLOCK_REPORT_INTERVAL;
+
+	__atomic_store_n(&impl->clock_report_seq, impl->clock_report_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	impl->clock_report.rate_diff = rate_diff;
+	impl->clock_report.error = error;
+	__atomic_store_n(&impl->clock_report_seq, impl->clock_report_seq + 1, __ATOMIC_RELEASE);
+
+	pw_loop_signal_event(node->core->main_loop, impl->clock_event);
+}
+
+/* Lock the estimate of the clock to the last clock reading. The predicted
+ * position advances with the system clock at the estimated rate and the
+ * error against the real position corrects the rate. Called from the data
+ * thread when the node starts a cycle. */
+static void update_clock_estimate(struct pw_node *this)
+{
+	struct pw_clock_estimate *c = &this->rt.clock;
+	int32_t rate;
+	int64_t ticks, monotonic_time;
+
+	if (this->clock == NULL || !this->live)
+		return;
+
+	if (spa_clock_get_time(this->clock, &rate, &ticks, &monotonic_time) < 0 || rate <= 0)
+		return;
+
+	if (c->rate == rate && ticks == c->ticks)
+		return;
+
+	if (c->rate == rate && ticks > c->ticks) {
+		if (c->dll.bw == 0.0)
+			spa_dll_set_bw(&c->dll, SPA_DLL_BW_MIN, ticks - c->ticks, rate);
+
+		c->position += (double) (monotonic_time - c->monotonic_time) *
+				rate * c->rate_diff / SPA_NSEC_PER_SEC;
+		c->error = c->position - ticks;
+
+		/* more than 100ms off is not drift but an xrun or a restart */
+		if (fabs(c->error) < rate / 10) {
+			c->rate_diff = spa_dll_update(&c->dll, c->error);
+			c->ticks = ticks;
+			c->monotonic_time = monotonic_time;
+
+			pw_node_report_clock(this, c->rate_diff, c->error);
+			return;
+		}
+		pw_log_debug("node %p: clock error %f, resync", this, c->error);
+	}
+
+	spa_dll_init(&c->dll);
+	c->rate = rate;
+	c->ticks = ticks;
+	c->monotonic_time = monotonic_time;
+	c->position = ticks;
+	c->rate_diff = 1.0;
+	c->error = 0.0;
+}
+
 static void node_need_input(void *data)
 {
 	struct pw_node *node = data;
+	update_clock_estimate(node);
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, need_input);
 	spa_graph_need_input(node->rt.graph, &node->rt.node);
 }
@@ -483,6 +623,7 @@ static void node_need_input(void *data)
 static void node_have_output(void *data)
 {
 	struct pw_node *node = data;
+	update_clock_estimate(node);
 	spa_graph_have_output(node->rt.graph, &node->rt.node);
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, have_output);
 }
@@ -593,6 +734,7 @@ void pw_node_destroy(struct pw_node *node)
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, free);
 
 	pw_work_queue_destroy(impl->work);
+	pw_loop_destroy_source(node->core->main_loop, impl->clock_event);
 
 	pw_map_clear(&node->input_port_map);
 	pw_map_clear(&node->output_port_map);
@@ -870,3 +1012,19 @@ bool pw_node_is_active(struct pw_node *node)
 {
 	return node->active;
 }
+
+int pw_node_get_time(struct pw_node *node, int32_t *rate, int64_t *ticks,
+		     int64_t *monotonic_time, double *rate_diff)
+{
+	int res;
+
+	if (node->clock == NULL || !node->live)
+		return SPA_RESULT_NOT_IMPLEMENTED;
+
+	if ((res = spa_clock_get_time(node->clock, rate, ticks, monotonic_time)) < 0)
+		return res;
+
+	*rate_diff = node->rt.clock.rate == *rate ? node->rt.clock.rate_diff : 1.0;
+
+	return SPA_RESULT_OK;
+}
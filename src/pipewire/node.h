@@ -90,6 +90,11 @@ struct pw_node_events {
 #define PW_NODE_PROP_AUTOCONNECT	"pipewire.autoconnect"
 /** Try to connect the node to this node id */
 #define PW_NODE_PROP_TARGET_NODE	"pipewire.target.node"
+/** Measured rate of the clock against its nominal rate, set on driving nodes
+ * and on resamplers between clocks */
+#define PW_NODE_PROP_CLOCK_RATE_DIFF	"pipewire.clock.rate-diff"
+/** Last error of the clock estimate in samples */
+#define PW_NODE_PROP_CLOCK_ERROR	"pipewire.clock.error"
 
 /** Create a new node \memberof pw_node */
 struct pw_node *
@@ -160,6 +165,12 @@ bool pw_node_set_active(struct pw_node *node, bool active);
 /** Check is a node is active */
 bool pw_node_is_active(struct pw_node *node);
 
+/** Get the time of the clock that drives a live node. \a rate_diff is the
+  * measured rate of the clock against the monotonic clock. Can be called
+  * from the data thread. */
+int pw_node_get_time(struct pw_node *node, int32_t *rate, int64_t *ticks,
+		     int64_t *monotonic_time, double *rate_diff);
+
 #ifdef __cplusplus
 }
 #endif
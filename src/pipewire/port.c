@@ -18,18 +18,65 @@
  */
 
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <errno.h>
 
+#include <spa/format-utils.h>
+#include <spa/audio/format-utils.h>
+
 #include "pipewire/pipewire.h"
 #include "pipewire/private.h"
 #include "pipewire/port.h"
 
+#define MAX_BRANCHES		32
+#define MAX_TEE_BUFFERS		64
+#define TEE_QUEUE_SIZE		4
+#define MAX_MIX_INPUTS		64
+#define MAX_MIX_BUFFERS		64
+
 /** \cond */
+struct type {
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+}
+
+/* write the sum of the samples of all @n_src sources to @dst in one pass */
+typedef void (*mix_func_t) (void *dst, const void *src[], uint32_t n_src, uint32_t n_samples);
+
+/* the buffers a tee branch did not take yet, oldest first */
+struct tee_queue {
+	uint32_t ids[TEE_QUEUE_SIZE];
+	uint32_t head;
+	uint32_t count;
+};
+
 struct impl {
 	struct pw_port this;
 
+	struct type type;
+
 	struct spa_node mix_node;
+	mix_func_t mix_func;			/**< mix function of the audio format */
+	uint32_t mix_stride;			/**< size of one sample */
+	uint64_t mix_busy;			/**< bitmap of the port buffers the
+						  *  node did not give back */
+	uint32_t mix_next;			/**< next port buffer to mix into */
+
+	uint32_t branches;			/**< bitmap of used tee branches */
+	uint32_t holders[MAX_TEE_BUFFERS];	/**< for each buffer, bitmap of the
+						  *  branches that still hold it */
+	struct tee_queue queues[MAX_BRANCHES];	/**< queued buffers of each branch */
 };
 /** \endcond */
 
@@ -43,6 +90,112 @@ static void port_update_state(struct pw_port *port, enum pw_port_state state)
 	}
 }
 
+/* Each link on an output port is a branch of the tee. All branches get
+ * the same buffer and the buffer goes back to the producer when the last
+ * branch released it, either in its io area or with port_reuse_buffer.
+ * The branch index is the port_id of the link port in the tee. */
+static inline bool tee_tracked(uint32_t branch, uint32_t buffer_id)
+{
+	return branch < MAX_BRANCHES && buffer_id < MAX_TEE_BUFFERS;
+}
+
+/* give the buffer back to the producer, in its io area when that is
+ * free or else with port_reuse_buffer */
+static void tee_recycle(struct impl *impl, struct spa_port_io *io, uint32_t buffer_id)
+{
+	struct pw_port *this = &impl->this;
+
+	pw_log_trace("tee %p: recycle buffer %d", this, buffer_id);
+	if (io && io->buffer_id == SPA_ID_INVALID)
+		io->buffer_id = buffer_id;
+	else
+		spa_node_port_reuse_buffer(this->node->node, this->port_id, buffer_id);
+}
+
+static void tee_release(struct impl *impl, struct spa_port_io *io,
+			uint32_t branch, uint32_t buffer_id)
+{
+	uint32_t *holders;
+
+	if (!tee_tracked(branch, buffer_id)) {
+		tee_recycle(impl, io, buffer_id);
+		return;
+	}
+	holders = &impl->holders[buffer_id];
+	if ((*holders & (1u << branch)) == 0)
+		return;
+
+	*holders &= ~(1u << branch);
+	if (*holders == 0)
+		tee_recycle(impl, io, buffer_id);
+}
+
+/* after a branch took its buffer, give it the next queued one */
+static void tee_pop(struct impl *impl, struct spa_graph_port *p)
+{
+	struct tee_queue *q;
+
+	if (p->port_id >= MAX_BRANCHES)
+		return;
+	q = &impl->queues[p->port_id];
+	if (q->count == 0)
+		return;
+
+	p->io->buffer_id = q->ids[q->head];
+	p->io->status = SPA_RESULT_HAVE_BUFFER;
+	q->head = (q->head + 1) % TEE_QUEUE_SIZE;
+	q->count--;
+}
+
+/* A stalled branch holds the buffer in its io and the ones in its queue.
+ * It may hold at most n_buffers - 1 of them, so that the producer always
+ * has a buffer left and the other branches keep running. */
+static inline uint32_t tee_queue_limit(struct impl *impl)
+{
+	uint32_t n_buffers = impl->this.n_buffers;
+	return n_buffers > 2 ? SPA_MIN(n_buffers - 2, TEE_QUEUE_SIZE) : 0;
+}
+
+/* give @buffer_id to a branch. When the branch did not take its previous
+ * buffer yet, the new one waits in the queue of the branch. A full queue
+ * drops its oldest buffer for that branch */
+static void tee_push(struct impl *impl, struct spa_graph_port *p,
+		     struct spa_port_io *io, uint32_t buffer_id)
+{
+	struct tee_queue *q;
+	uint32_t limit;
+	bool busy;
+
+	busy = p->io->status == SPA_RESULT_HAVE_BUFFER &&
+	    p->io->buffer_id != SPA_ID_INVALID && p->io->buffer_id != buffer_id;
+
+	if (p->port_id >= MAX_BRANCHES || (!busy && impl->queues[p->port_id].count == 0)) {
+		*p->io = *io;
+		p->io->buffer_id = buffer_id;
+		return;
+	}
+	q = &impl->queues[p->port_id];
+	limit = tee_queue_limit(impl);
+
+	if (limit == 0) {
+		pw_log_trace("tee %p: branch %d drops buffer %d", impl,
+			     p->port_id, buffer_id);
+		tee_release(impl, NULL, p->port_id, buffer_id);
+		return;
+	}
+	while (q->count >= limit) {
+		pw_log_trace("tee %p: branch %d drops buffer %d", impl,
+			     p->port_id, q->ids[q->head]);
+		tee_release(impl, NULL, p->port_id, q->ids[q->head]);
+		q->head = (q->head + 1) % TEE_QUEUE_SIZE;
+		q->count--;
+	}
+	q->ids[(q->head + q->count++) % TEE_QUEUE_SIZE] = buffer_id;
+
+	if (!busy)
+		tee_pop(impl, p);
+}
+
 static int schedule_tee_input(struct spa_node *data)
 {
 	struct impl *impl = SPA_CONTAINER_OF(data, struct impl, mix_node);
@@ -50,6 +203,7 @@ static int schedule_tee_input(struct spa_node *data)
 	struct spa_graph_node *node = &this->rt.mix_node;
 	struct spa_graph_port *p;
 	struct spa_port_io *io = this->rt.mix_port.io;
+	uint32_t buffer_id = io->buffer_id;
         int res;
 
 	if (spa_list_is_empty(&node->ports[SPA_DIRECTION_OUTPUT])) {
@@ -57,15 +211,21 @@ static int schedule_tee_input(struct spa_node *data)
 		res = SPA_RESULT_NEED_BUFFER;
 	}
 	else {
-		pw_log_trace("tee input %d %d", io->status, io->buffer_id);
-		spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link)
-			*p->io = *io;
-		io->status = SPA_RESULT_OK;
+		pw_log_trace("tee input %d %d", io->status, buffer_id);
 		io->buffer_id = SPA_ID_INVALID;
+
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+			if (tee_tracked(p->port_id, buffer_id))
+				impl->holders[buffer_id] |= (1u << p->port_id);
+
+			tee_push(impl, p, io, buffer_id);
+		}
+		io->status = SPA_RESULT_OK;
 		res = SPA_RESULT_HAVE_BUFFER;
 	}
         return res;
 }
+
 static int schedule_tee_output(struct spa_node *data)
 {
 	struct impl *impl = SPA_CONTAINER_OF(data, struct impl, mix_node);
@@ -74,8 +234,18 @@ static int schedule_tee_output(struct spa_node *data)
 	struct spa_graph_port *p;
 	struct spa_port_io *io = this->rt.mix_port.io;
 
-	spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link)
-		*io = *p->io;
+	io->buffer_id = SPA_ID_INVALID;
+
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+		if (p->io->status == SPA_RESULT_NEED_BUFFER) {
+			if (p->io->buffer_id != SPA_ID_INVALID) {
+				tee_release(impl, io, p->port_id, p->io->buffer_id);
+				p->io->buffer_id = SPA_ID_INVALID;
+			}
+			tee_pop(impl, p);
+		}
+		io->range = p->io->range;
+	}
 	io->status = SPA_RESULT_NEED_BUFFER;
 
 	return SPA_RESULT_NEED_BUFFER;
@@ -83,6 +253,10 @@ static int schedule_tee_output(struct spa_node *data)
 
 static int schedule_tee_reuse_buffer(struct spa_node *data, uint32_t port_id, uint32_t buffer_id)
 {
+	struct impl *impl = SPA_CONTAINER_OF(data, struct impl, mix_node);
+
+	tee_release(impl, NULL, port_id, buffer_id);
+
 	return SPA_RESULT_OK;
 }
 
@@ -94,22 +268,256 @@ static const struct spa_node schedule_tee_node = {
 	.port_reuse_buffer = schedule_tee_reuse_buffer,
 };
 
+static void mix_s16(void *dst, const void *src[], uint32_t n_src, uint32_t n_samples)
+{
+	int16_t *d = dst;
+	uint32_t i, j;
+	int32_t t;
+
+	for (i = 0; i < n_samples; i++) {
+		t = 0;
+		for (j = 0; j < n_src; j++)
+			t += ((const int16_t *) src[j])[i];
+		d[i] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void mix_s32(void *dst, const void *src[], uint32_t n_src, uint32_t n_samples)
+{
+	int32_t *d = dst;
+	uint32_t i, j;
+	int64_t t;
+
+	for (i = 0; i < n_samples; i++) {
+		t = 0;
+		for (j = 0; j < n_src; j++)
+			t += ((const int32_t *) src[j])[i];
+		d[i] = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+	}
+}
+
+static void mix_f32(void *dst, const void *src[], uint32_t n_src, uint32_t n_samples)
+{
+	float *d = dst;
+	uint32_t i, j;
+	float t;
+
+	for (i = 0; i < n_samples; i++) {
+		t = 0;
+		for (j = 0; j < n_src; j++)
+			t += ((const float *) src[j])[i];
+		d[i] = t;
+	}
+}
+
+static void mix_f64(void *dst, const void *src[], uint32_t n_src, uint32_t n_samples)
+{
+	double *d = dst;
+	uint32_t i, j;
+	double t;
+
+	for (i = 0; i < n_samples; i++) {
+		t = 0;
+		for (j = 0; j < n_src; j++)
+			t += ((const double *) src[j])[i];
+		d[i] = t;
+	}
+}
+
+/* With one link, the input port uses the buffers of the link and the
+ * buffers are passed on. When more links are added, the port gets its own
+ * buffers and the data of all links is mixed into them, so that the data of
+ * one client never ends up in the memory of another producer. */
+static inline bool mix_is_primary(struct pw_port *this, struct spa_graph_port *p)
+{
+	struct pw_link *link = p->scheduler_data;
+	return link->buffers == this->buffers;
+}
+
+static void mix_data(struct impl *impl, struct spa_data *d,
+		     struct spa_data *sd[], uint32_t n_src)
+{
+	const void *src[MAX_MIX_INPUTS], *tail[2];
+	uint32_t i, stride = impl->mix_stride, size, common, maxsize, s;
+	void *dst;
+
+	dst = SPA_MEMBER(d->data, d->chunk->offset, void);
+	maxsize = d->maxsize - d->chunk->offset;
+	size = common = SPA_MIN(sd[0]->chunk->size, maxsize);
+
+	for (i = 0; i < n_src; i++) {
+		s = SPA_MIN(sd[i]->chunk->size, maxsize);
+		src[i] = SPA_MEMBER(sd[i]->data, sd[i]->chunk->offset, void);
+		common = SPA_MIN(common, s);
+		size = SPA_MAX(size, s);
+	}
+	common -= common % stride;
+
+	/* sum all sources in one pass over the part they all have */
+	impl->mix_func(dst, src, n_src, common / stride);
+
+	/* past the shortest input, the longer ones are added to silence */
+	if (size > common) {
+		tail[0] = SPA_MEMBER(dst, common, void);
+		memset(SPA_MEMBER(dst, common, void), 0, size - common);
+		for (i = 0; i < n_src; i++) {
+			s = SPA_MIN(sd[i]->chunk->size, maxsize);
+			if (s <= common)
+				continue;
+			tail[1] = SPA_MEMBER(src[i], common, void);
+			impl->mix_func(SPA_MEMBER(dst, common, void), tail, 2, (s - common) / stride);
+		}
+	}
+	d->chunk->size = size;
+}
+
+static void copy_data(struct spa_data *d, struct spa_data *sd)
+{
+	uint32_t size = SPA_MIN(sd->chunk->size, d->maxsize);
+
+	memcpy(d->data, SPA_MEMBER(sd->data, sd->chunk->offset, void), size);
+	d->chunk->size = size;
+}
+
+static void mix_buffers(struct impl *impl, struct spa_buffer *b,
+			struct spa_graph_port *inputs[], uint32_t n_inputs)
+{
+	struct spa_buffer *sb[MAX_MIX_INPUTS];
+	struct spa_data *sd[MAX_MIX_INPUTS];
+	uint32_t i, j, n_src;
+
+	for (i = 0; i < n_inputs; i++) {
+		struct pw_link *link = inputs[i]->scheduler_data;
+		sb[i] = link->buffers[inputs[i]->io->buffer_id];
+	}
+	for (j = 0; j < b->n_datas; j++) {
+		struct spa_data *d = &b->datas[j];
+
+		if (d->data == NULL)
+			continue;
+
+		for (i = 0, n_src = 0; i < n_inputs; i++) {
+			if (j < sb[i]->n_datas && sb[i]->datas[j].data)
+				sd[n_src++] = &sb[i]->datas[j];
+		}
+		d->chunk->offset = 0;
+		d->chunk->size = 0;
+		if (n_src == 0)
+			continue;
+
+		d->chunk->stride = sd[0]->chunk->stride;
+		if (impl->mix_func)
+			mix_data(impl, d, sd, n_src);
+		else
+			copy_data(d, sd[0]);
+	}
+}
+
+/* take the next port buffer to mix into, skipping the ones the node did
+ * not give back yet. When all are busy there is nothing to mix into and
+ * the inputs stay queued until the node gives one back. */
+static uint32_t mix_get_buffer(struct impl *impl)
+{
+	struct pw_port *this = &impl->this;
+	uint32_t i, id, n_buffers = SPA_MIN(this->n_buffers, MAX_MIX_BUFFERS);
+
+	if (n_buffers == 0)
+		return SPA_ID_INVALID;
+
+	for (i = 0; i < n_buffers; i++) {
+		id = (impl->mix_next + i) % n_buffers;
+		if ((impl->mix_busy & (1ull << id)) == 0)
+			break;
+	}
+	if (i == n_buffers)
+		return SPA_ID_INVALID;
+
+	impl->mix_next = id + 1;
+	impl->mix_busy |= (1ull << id);
+
+	return id;
+}
+
+static inline void mix_release_buffer(struct impl *impl, uint32_t buffer_id)
+{
+	if (buffer_id < MAX_MIX_BUFFERS)
+		impl->mix_busy &= ~(1ull << buffer_id);
+}
+
+static int schedule_mix_buffers(struct impl *impl)
+{
+	struct pw_port *this = &impl->this;
+	struct spa_graph_node *node = &this->rt.mix_node;
+	struct spa_graph_port *p, *inputs[MAX_MIX_INPUTS];
+	struct spa_port_io *io = this->rt.mix_port.io;
+	uint32_t i, n_inputs = 0, buffer_id;
+
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		struct pw_link *link = p->scheduler_data;
+
+		pw_log_trace("mix %p: input %p %p->%p %d %d", node,
+				p, p->io, io, p->io->status, p->io->buffer_id);
+
+		if (p->io->status == SPA_RESULT_HAVE_BUFFER &&
+		    p->io->buffer_id < link->n_buffers &&
+		    n_inputs < MAX_MIX_INPUTS) {
+			inputs[n_inputs++] = p;
+			/* without a mix function we can only copy one input */
+			if (impl->mix_func == NULL)
+				break;
+		}
+	}
+	if (n_inputs == 0 || (buffer_id = mix_get_buffer(impl)) == SPA_ID_INVALID) {
+		io->status = SPA_RESULT_NEED_BUFFER;
+		return SPA_RESULT_NEED_BUFFER;
+	}
+
+	mix_buffers(impl, this->buffers[buffer_id], inputs, n_inputs);
+
+	/* only the inputs we mixed are consumed, the others stay for the
+	 * next cycle. They are recycled in process_output */
+	for (i = 0; i < n_inputs; i++)
+		inputs[i]->io->status = SPA_RESULT_OK;
+
+	io->status = SPA_RESULT_HAVE_BUFFER;
+	io->buffer_id = buffer_id;
+
+	return SPA_RESULT_HAVE_BUFFER;
+}
+
 static int schedule_mix_input(struct spa_node *data)
 {
 	struct impl *impl = SPA_CONTAINER_OF(data, struct impl, mix_node);
         struct pw_port *this = &impl->this;
 	struct spa_graph_node *node = &this->rt.mix_node;
-	struct spa_graph_port *p;
+	struct spa_graph_port *p, *primary = NULL;
 	struct spa_port_io *io = this->rt.mix_port.io;
 
+	if (spa_list_is_empty(&node->ports[SPA_DIRECTION_INPUT]))
+		return SPA_RESULT_HAVE_BUFFER;
+
+	if (this->mix_buffers)
+		return schedule_mix_buffers(impl);
+
+	/* pass on the input that has the buffers of the port. Other links
+	 * are only mixed when the port has its own buffers, until then their
+	 * data stays queued */
 	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
-		pw_log_trace("mix %p: input %p %p->%p %d %d", node,
-				p, p->io, io, p->io->status, p->io->buffer_id);
-		*io = *p->io;
-		p->io->status = SPA_RESULT_OK;
-		p->io->buffer_id = SPA_ID_INVALID;
-		break;
+		if (mix_is_primary(this, p)) {
+			primary = p;
+			break;
+		}
 	}
+	if (primary == NULL)
+		primary = spa_list_first(&node->ports[SPA_DIRECTION_INPUT], struct spa_graph_port, link);
+
+	pw_log_trace("mix %p: pass input %p %d %d", node,
+			primary, primary->io->status, primary->io->buffer_id);
+
+	*io = *primary->io;
+	primary->io->status = SPA_RESULT_OK;
+	primary->io->buffer_id = SPA_ID_INVALID;
+
 	return SPA_RESULT_HAVE_BUFFER;
 }
 
@@ -121,9 +529,19 @@ static int schedule_mix_output(struct spa_node *data)
 	struct spa_graph_port *p;
 	struct spa_port_io *io = this->rt.mix_port.io;
 
+	if (this->mix_buffers && io->buffer_id != SPA_ID_INVALID)
+		mix_release_buffer(impl, io->buffer_id);
+
 	io->status = SPA_RESULT_NEED_BUFFER;
-	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link)
-		*p->io = *io;
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		if (!this->mix_buffers && mix_is_primary(this, p)) {
+			*p->io = *io;
+		} else if (p->io->status == SPA_RESULT_OK) {
+			/* give back the buffer we mixed */
+			p->io->status = SPA_RESULT_NEED_BUFFER;
+			p->io->range = io->range;
+		}
+	}
 	io->buffer_id = SPA_ID_INVALID;
 
 	return SPA_RESULT_NEED_BUFFER;
@@ -131,6 +549,26 @@ static int schedule_mix_output(struct spa_node *data)
 
 static int schedule_mix_reuse_buffer(struct spa_node *data, uint32_t port_id, uint32_t buffer_id)
 {
+	struct impl *impl = SPA_CONTAINER_OF(data, struct impl, mix_node);
+        struct pw_port *this = &impl->this;
+	struct spa_graph_node *node = &this->rt.mix_node;
+	struct spa_graph_port *p, *pp;
+
+	if (this->mix_buffers) {
+		mix_release_buffer(impl, buffer_id);
+		return SPA_RESULT_OK;
+	}
+
+	/* the buffer came from the input we passed on, return it to the tee
+	 * of that link */
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		if (!mix_is_primary(this, p))
+			continue;
+		if ((pp = p->peer) != NULL)
+			spa_node_port_reuse_buffer(pp->node->implementation,
+						   pp->port_id, buffer_id);
+		break;
+	}
 	return SPA_RESULT_OK;
 }
 
@@ -244,6 +682,49 @@ void * pw_port_get_user_data(struct pw_port *port)
 	return port->user_data;
 }
 
+/** Forget the enumerated formats of \a port
+ * \memberof pw_port */
+void pw_port_reset_formats(struct pw_port *port)
+{
+	free(port->formats.data);
+	spa_zero(port->formats);
+}
+
+/** Add a link port to the mixer or tee of \a port, called from the data loop
+ * \memberof pw_port */
+void pw_port_add_mix_port(struct pw_port *port, struct spa_graph_port *p)
+{
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
+
+	if (port->direction == PW_DIRECTION_OUTPUT) {
+		/* give the link a tee branch */
+		p->port_id = ffs(~impl->branches) - 1;
+		if (p->port_id < MAX_BRANCHES)
+			impl->branches |= (1u << p->port_id);
+		else
+			p->port_id = SPA_ID_INVALID;
+	}
+	spa_graph_port_add(&port->rt.mix_node, p);
+}
+
+/** Remove a link port from the mixer or tee of \a port, called from the data loop
+ * \memberof pw_port */
+void pw_port_remove_mix_port(struct pw_port *port, struct spa_graph_port *p)
+{
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
+	uint32_t i;
+
+	spa_graph_port_remove(p);
+
+	if (port->direction == PW_DIRECTION_OUTPUT && p->port_id < MAX_BRANCHES) {
+		/* release everything the branch still holds */
+		for (i = 0; i < MAX_TEE_BUFFERS; i++)
+			tee_release(impl, NULL, p->port_id, i);
+		spa_zero(impl->queues[p->port_id]);
+		impl->branches &= ~(1u << p->port_id);
+	}
+}
+
 static int do_add_port(struct spa_loop *loop,
 		       bool async, uint32_t seq, size_t size, const void *data, void *user_data)
 {
@@ -335,12 +816,13 @@ void pw_port_destroy(struct pw_port *port)
 
 	if (port->allocated) {
 		free(port->buffers);
-		pw_memblock_free(&port->buffer_mem);
+		pw_mempool_free(port->node->core->mempool, &port->buffer_mem);
 	}
 
 	if (port->properties)
 		pw_properties_free(port->properties);
 
+	pw_port_reset_formats(port);
 	free(port);
 }
 
@@ -354,8 +836,60 @@ do_port_pause(struct spa_loop *loop,
 				&SPA_COMMAND_INIT(node->core->type.command_node.Pause));
 }
 
+/* forget the state of the old buffers, the data thread uses it */
+static int
+do_reset_buffers(struct spa_loop *loop,
+		 bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct impl *impl = user_data;
+
+	spa_zero(impl->holders);
+	spa_zero(impl->queues);
+	impl->mix_busy = 0;
+	impl->mix_next = 0;
+
+	return SPA_RESULT_OK;
+}
+
+/* select the function to mix the links of an input port */
+static void update_mix_func(struct impl *impl, const struct spa_format *format)
+{
+	struct pw_port *this = &impl->this;
+	struct type *t = &impl->type;
+	struct spa_audio_info_raw info = { 0, };
+
+	impl->mix_func = NULL;
+	impl->mix_stride = 0;
+
+	if (format == NULL || this->direction != PW_DIRECTION_INPUT)
+		return;
+
+	init_type(t, this->node->core->type.map);
+
+	if (SPA_FORMAT_MEDIA_TYPE(format) != t->media_type.audio ||
+	    SPA_FORMAT_MEDIA_SUBTYPE(format) != t->media_subtype.raw ||
+	    !spa_format_audio_raw_parse(format, &info, &t->format_audio))
+		return;
+
+	if (info.format == t->audio_format.S16) {
+		impl->mix_func = mix_s16;
+		impl->mix_stride = sizeof(int16_t);
+	} else if (info.format == t->audio_format.S32) {
+		impl->mix_func = mix_s32;
+		impl->mix_stride = sizeof(int32_t);
+	} else if (info.format == t->audio_format.F32) {
+		impl->mix_func = mix_f32;
+		impl->mix_stride = sizeof(float);
+	} else if (info.format == t->audio_format.F64) {
+		impl->mix_func = mix_f64;
+		impl->mix_stride = sizeof(double);
+	}
+	pw_log_debug("port %p: mix function %p", this, impl->mix_func);
+}
+
 int pw_port_set_format(struct pw_port *port, uint32_t flags, const struct spa_format *format)
 {
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
 	int res;
 
 	res = spa_node_port_set_format(port->node->node, port->direction, port->port_id, flags, format);
@@ -365,22 +899,25 @@ int pw_port_set_format(struct pw_port *port, uint32_t flags, const struct spa_fo
 		if (format == NULL) {
 			if (port->allocated) {
 				free(port->buffers);
-				pw_memblock_free(&port->buffer_mem);
+				pw_mempool_free(port->node->core->mempool, &port->buffer_mem);
 			}
 			port->buffers = NULL;
 			port->n_buffers = 0;
 			port->allocated = false;
+			port->mix_buffers = false;
 			port_update_state (port, PW_PORT_STATE_CONFIGURE);
 		}
 		else {
 			port_update_state (port, PW_PORT_STATE_READY);
 		}
+		update_mix_func(impl, format);
 	}
 	return res;
 }
 
 int pw_port_use_buffers(struct pw_port *port, struct spa_buffer **buffers, uint32_t n_buffers)
 {
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
 	int res;
 
 	if (n_buffers == 0 && port->state <= PW_PORT_STATE_READY)
@@ -400,11 +937,14 @@ int pw_port_use_buffers(struct pw_port *port, struct spa_buffer **buffers, uint3
 
 	if (port->allocated) {
 		free(port->buffers);
-		pw_memblock_free(&port->buffer_mem);
+		pw_mempool_free(port->node->core->mempool, &port->buffer_mem);
 	}
 	port->buffers = buffers;
 	port->n_buffers = n_buffers;
 	port->allocated = false;
+	port->mix_buffers = false;
+	pw_loop_invoke(port->node->data_loop,
+		       do_reset_buffers, SPA_ID_INVALID, 0, NULL, true, impl);
 
 	if (n_buffers == 0)
 		port_update_state (port, PW_PORT_STATE_READY);
@@ -418,6 +958,7 @@ int pw_port_alloc_buffers(struct pw_port *port,
 			  struct spa_param **params, uint32_t n_params,
 			  struct spa_buffer **buffers, uint32_t *n_buffers)
 {
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
 	int res;
 
 	if (port->state < PW_PORT_STATE_READY)
@@ -436,14 +977,34 @@ int pw_port_alloc_buffers(struct pw_port *port,
 							  buffers, n_buffers);
 	if (port->allocated) {
 		free(port->buffers);
-		pw_memblock_free(&port->buffer_mem);
+		pw_mempool_free(port->node->core->mempool, &port->buffer_mem);
 	}
 	port->buffers = buffers;
 	port->n_buffers = *n_buffers;
 	port->allocated = true;
+	port->mix_buffers = false;
+	pw_loop_invoke(port->node->data_loop,
+		       do_reset_buffers, SPA_ID_INVALID, 0, NULL, true, impl);
 
 	if (!SPA_RESULT_IS_ASYNC(res))
 		port_update_state (port, PW_PORT_STATE_PAUSED);
 
 	return res;
 }
+
+int pw_port_use_mix_buffers(struct pw_port *port, struct spa_buffer **buffers,
+			    uint32_t n_buffers, struct pw_memblock *mem)
+{
+	int res;
+
+	if ((res = pw_port_use_buffers(port, buffers, n_buffers)) < 0)
+		return res;
+
+	port->allocated = true;
+	port->buffer_mem = *mem;
+	port->mix_buffers = true;
+
+	pw_log_debug("port %p: mixing links into %d port buffers", port, n_buffers);
+
+	return res;
+}
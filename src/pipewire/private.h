@@ -25,9 +25,11 @@ extern "C" {
 #endif
 
 #include <spa/graph.h>
+#include <spa/dll.h>
 
 #include <sys/socket.h>
 
+#include "pipewire/arena.h"
 #include "pipewire/mem.h"
 #include "pipewire/pipewire.h"
 #include "pipewire/introspect.h"
@@ -82,6 +84,9 @@ struct pw_client {
 
 	struct spa_list resource_list;	/**< The list of resources of this client */
 
+	struct pw_array permissions;	/**< cached permissions, one byte per global id */
+	uint32_t permission_serial;	/**< core permission_serial of the cache */
+
 	bool busy;
 
 	struct spa_hook_list listener_list;
@@ -119,6 +124,8 @@ struct pw_core {
 
 	pw_permission_func_t permission_func;	/**< get permissions of an object */
 	void *permission_data;			/**< data passed to permission function */
+	uint32_t permission_serial;		/**< changes when all cached permissions
+						  *  are invalid */
 
 	struct pw_map globals;			/**< map of globals */
 
@@ -133,6 +140,14 @@ struct pw_core {
 	struct spa_list factory_list;		/**< list of factories */
 	struct spa_list link_list;		/**< list of links */
 
+	struct spa_list format_cache;		/**< negotiated formats, most recent first */
+	uint32_t n_format_cache;		/**< number of items in format_cache */
+
+	struct pw_arena arena;			/**< transient memory for negotiation, released
+						  *  in bulk after each round */
+
+	struct pw_mempool *mempool;		/**< pool for buffer memory */
+
 	struct spa_hook_list listener_list;
 
 	struct pw_loop *main_loop;	/**< main loop for control */
@@ -156,6 +171,8 @@ struct pw_data_loop {
 
         bool running;
         pthread_t thread;
+	int numa_node;		/**< NUMA node of the thread at start or -1,
+				  *  accessed atomically */
 };
 
 struct pw_main_loop {
@@ -216,6 +233,18 @@ struct pw_module {
 	void *user_data;                /**< module user_data */
 };
 
+/** The rate of a clock measured against the monotonic system clock */
+struct pw_clock_estimate {
+	struct spa_dll dll;		/**< loop that locks to the clock */
+	int32_t rate;			/**< nominal rate of the clock, 0 when not locked */
+	int64_t ticks;			/**< last ticks of the clock */
+	int64_t monotonic_time;		/**< time of the last ticks */
+	double position;		/**< predicted ticks at monotonic_time */
+	double rate_diff;		/**< measured rate / nominal rate */
+	double error;			/**< last error of the prediction in ticks */
+	int64_t next_report;		/**< when to update the node properties */
+};
+
 struct pw_node {
 	struct pw_core *core;		/**< core object */
 	struct spa_list link;		/**< link in core node_list */
@@ -249,6 +278,7 @@ struct pw_node {
 	struct {
 		struct spa_graph *graph;
 		struct spa_graph_node node;
+		struct pw_clock_estimate clock;	/**< estimate of the driving clock */
 	} rt;
 
         void *user_data;                /**< extra user data */
@@ -268,10 +298,21 @@ struct pw_port {
 	struct spa_port_io io;		/**< io area of the port */
 
 	bool allocated;			/**< if buffers are allocated */
+	bool mix_buffers;		/**< if the buffers are only used to mix
+					  *  the links into */
 	struct pw_memblock buffer_mem;	/**< allocated buffer memory */
 	struct spa_buffer **buffers;	/**< port buffers */
 	uint32_t n_buffers;		/**< number of port buffers */
 
+	struct {
+		bool valid;		/**< if data holds the formats */
+		void *data;		/**< all formats, padded to 8 bytes */
+		uint32_t size;		/**< size of data */
+		uint32_t n_formats;	/**< number of formats in data */
+		uint64_t hash;		/**< hash of data */
+	} formats;			/**< enumerated formats, kept for negotiation
+					  *  until the port info changes */
+
 	struct spa_list links;		/**< list of \ref pw_link */
 
 	struct spa_hook_list listener_list;
@@ -404,6 +445,16 @@ void pw_port_destroy(struct pw_port *port);
 /** Set a format on a port \memberof pw_port */
 int pw_port_set_format(struct pw_port *port, uint32_t flags, const struct spa_format *format);
 
+/** Forget the enumerated formats of a port, they are enumerated again
+ * on the next negotiation \memberof pw_port */
+void pw_port_reset_formats(struct pw_port *port);
+
+/** Add a link port to the mixer or tee of a port, from the data loop \memberof pw_port */
+void pw_port_add_mix_port(struct pw_port *port, struct spa_graph_port *p);
+
+/** Remove a link port from the mixer or tee of a port, from the data loop \memberof pw_port */
+void pw_port_remove_mix_port(struct pw_port *port, struct spa_graph_port *p);
+
 /** Use buffers on a port \memberof pw_port */
 int pw_port_use_buffers(struct pw_port *port, struct spa_buffer **buffers, uint32_t n_buffers);
 
@@ -412,12 +463,21 @@ int pw_port_alloc_buffers(struct pw_port *port,
 			  struct spa_param **params, uint32_t n_params,
 			  struct spa_buffer **buffers, uint32_t *n_buffers);
 
+/** Use buffers of the port itself to mix the links into, the port takes
+ * ownership of \a buffers and \a mem \memberof pw_port */
+int pw_port_use_mix_buffers(struct pw_port *port, struct spa_buffer **buffers,
+			    uint32_t n_buffers, struct pw_memblock *mem);
+
 /** Change the state of the node */
 int pw_node_set_state(struct pw_node *node, enum pw_node_state state);
 
 /** Update the state of the node, mostly used by node implementations */
 void pw_node_update_state(struct pw_node *node, enum pw_node_state state, char *error);
 
+/** Publish the state of a rate estimate in the node properties, at most
+ * once per second. Called from the data thread \memberof pw_node */
+void pw_node_report_clock(struct pw_node *node, double rate_diff, double error);
+
 /** Activate a link \memberof pw_link
   * Starts the negotiation of formats and buffers on \a link and then
   * starts data streaming */
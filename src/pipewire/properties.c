@@ -18,51 +18,311 @@
  */
 
 #include <stdio.h>
+#include <pthread.h>
 
 #include "pipewire/pipewire.h"
 #include "pipewire/properties.h"
 
 /** \cond */
+
+/** An interned key. Keys are shared between all properties in the
+ * process, the key of a dict item points to the key member. */
+struct atom {
+	struct atom *next;	/**< next atom in the bucket */
+	uint32_t hash;		/**< hash of key */
+	uint32_t refcount;	/**< number of items using the key */
+	char key[0];
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct atom **buckets;
+	uint32_t n_buckets;
+	uint32_t n_atoms;
+} atoms = { PTHREAD_MUTEX_INITIALIZER, };
+
+/** Items and hash index, shared between copies until one of them
+ * is changed */
+struct data {
+	int refcount;
+	struct pw_array items;	/**< array of spa_dict_item, used as the dict */
+	uint32_t *index;	/**< open addressing table of item index + 1, 0 is free */
+	uint32_t index_size;	/**< size of index, a power of 2 */
+};
+
 struct properties {
 	struct pw_properties this;
 
-	struct pw_array items;
+	struct data *data;
 };
 /** \endcond */
 
-static void add_func(struct pw_properties *this, char *key, char *value)
+#define ATOM_FROM_KEY(k)	(SPA_CONTAINER_OF(k, struct atom, key))
+
+static inline uint32_t hash_key(const char *key)
+{
+	uint32_t hash = 2166136261u;
+
+	/* FNV-1a */
+	while (*key) {
+		hash ^= (uint8_t) *key++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static bool grow_atoms(void)
+{
+	struct atom **buckets, *a, *next;
+	uint32_t i, n_buckets = atoms.n_buckets ? atoms.n_buckets * 2 : 256;
+
+	if ((buckets = calloc(n_buckets, sizeof(struct atom *))) == NULL)
+		return false;
+
+	for (i = 0; i < atoms.n_buckets; i++) {
+		for (a = atoms.buckets[i]; a; a = next) {
+			next = a->next;
+			a->next = buckets[a->hash & (n_buckets - 1)];
+			buckets[a->hash & (n_buckets - 1)] = a;
+		}
+	}
+	free(atoms.buckets);
+	atoms.buckets = buckets;
+	atoms.n_buckets = n_buckets;
+
+	return true;
+}
+
+static const char *intern_key(const char *key, uint32_t hash)
+{
+	struct atom *a = NULL, **bucket;
+	size_t len;
+
+	pthread_mutex_lock(&atoms.lock);
+	if (atoms.n_atoms >= atoms.n_buckets && !grow_atoms() && atoms.n_buckets == 0)
+		goto done;
+
+	bucket = &atoms.buckets[hash & (atoms.n_buckets - 1)];
+	for (a = *bucket; a; a = a->next) {
+		if (a->hash == hash && strcmp(a->key, key) == 0) {
+			a->refcount++;
+			goto done;
+		}
+	}
+
+	len = strlen(key);
+	if ((a = malloc(sizeof(struct atom) + len + 1)) == NULL)
+		goto done;
+
+	a->hash = hash;
+	a->refcount = 1;
+	memcpy(a->key, key, len + 1);
+	a->next = *bucket;
+	*bucket = a;
+	atoms.n_atoms++;
+
+      done:
+	pthread_mutex_unlock(&atoms.lock);
+	return a ? a->key : NULL;
+}
+
+static void release_key(const char *key)
+{
+	struct atom *a = ATOM_FROM_KEY(key), **bucket;
+
+	pthread_mutex_lock(&atoms.lock);
+	if (--a->refcount == 0) {
+		for (bucket = &atoms.buckets[a->hash & (atoms.n_buckets - 1)];
+		     *bucket; bucket = &(*bucket)->next) {
+			if (*bucket == a) {
+				*bucket = a->next;
+				break;
+			}
+		}
+		atoms.n_atoms--;
+		free(a);
+	}
+	pthread_mutex_unlock(&atoms.lock);
+}
+
+static inline uint32_t n_items(struct data *data)
+{
+	return pw_array_get_len(&data->items, struct spa_dict_item);
+}
+
+static inline struct spa_dict_item *get_item(struct data *data, uint32_t index)
+{
+	return pw_array_get_unchecked(&data->items, index, struct spa_dict_item);
+}
+
+static void update_dict(struct properties *impl)
+{
+	impl->this.dict.items = impl->data->items.data;
+	impl->this.dict.n_items = n_items(impl->data);
+}
+
+static void index_insert(struct data *data, uint32_t hash, uint32_t index)
+{
+	uint32_t mask = data->index_size - 1, i;
+
+	for (i = hash & mask; data->index[i] != 0; i = (i + 1) & mask);
+	data->index[i] = index + 1;
+}
+
+/* rebuild the index, making it big enough to stay at most half full */
+static bool rebuild_index(struct data *data, uint32_t n_needed)
+{
+	uint32_t i, size = data->index_size ? data->index_size : 16, n = n_items(data);
+
+	while (size < n_needed * 2)
+		size *= 2;
+
+	if (size != data->index_size) {
+		uint32_t *index = realloc(data->index, size * sizeof(uint32_t));
+		if (index == NULL)
+			return false;
+		data->index = index;
+		data->index_size = size;
+	}
+	memset(data->index, 0, data->index_size * sizeof(uint32_t));
+
+	for (i = 0; i < n; i++)
+		index_insert(data, ATOM_FROM_KEY(get_item(data, i)->key)->hash, i);
+
+	return true;
+}
+
+static struct data *data_new(void)
+{
+	struct data *data;
+
+	if ((data = calloc(1, sizeof(struct data))) == NULL)
+		return NULL;
+
+	data->refcount = 1;
+	pw_array_init(&data->items, 16);
+
+	return data;
+}
+
+static void data_unref(struct data *data)
 {
 	struct spa_dict_item *item;
-	struct properties *impl = SPA_CONTAINER_OF(this, struct properties, this);
 
-	item = pw_array_add(&impl->items, sizeof(struct spa_dict_item));
-	item->key = key;
-	item->value = value;
+	if (__atomic_sub_fetch(&data->refcount, 1, __ATOMIC_SEQ_CST) > 0)
+		return;
 
-	this->dict.items = impl->items.data;
-	this->dict.n_items = pw_array_get_len(&impl->items, struct spa_dict_item);
+	pw_array_for_each(item, &data->items) {
+		release_key(item->key);
+		free((char *) item->value);
+	}
+	pw_array_clear(&data->items);
+	free(data->index);
+	free(data);
 }
 
-static void clear_item(struct spa_dict_item *item)
+/* make sure impl has its own copy of the data before changing it */
+static bool make_writable(struct properties *impl)
 {
-	free((char *) item->key);
-	free((char *) item->value);
+	struct data *old = impl->data, *data;
+	struct spa_dict_item *item, *copy;
+
+	if (__atomic_load_n(&old->refcount, __ATOMIC_SEQ_CST) == 1)
+		return true;
+
+	if ((data = data_new()) == NULL)
+		return false;
+
+	if (!pw_array_ensure_size(&data->items, old->items.size))
+		goto no_mem;
+
+	pw_array_for_each(item, &old->items) {
+		copy = pw_array_add(&data->items, sizeof(struct spa_dict_item));
+		copy->key = intern_key(item->key, ATOM_FROM_KEY(item->key)->hash);
+		copy->value = item->value ? strdup(item->value) : NULL;
+	}
+	if (old->index_size) {
+		if ((data->index = malloc(old->index_size * sizeof(uint32_t))) == NULL)
+			goto no_mem;
+		memcpy(data->index, old->index, old->index_size * sizeof(uint32_t));
+		data->index_size = old->index_size;
+	}
+
+	impl->data = data;
+	data_unref(old);
+	update_dict(impl);
+
+	return true;
+
+      no_mem:
+	data_unref(data);
+	return false;
 }
 
-static int find_index(const struct pw_properties *this, const char *key)
+static int find_index(const struct pw_properties *this, const char *key, uint32_t hash)
 {
 	struct properties *impl = SPA_CONTAINER_OF(this, struct properties, this);
-	int i, len = pw_array_get_len(&impl->items, struct spa_dict_item);
+	struct data *data = impl->data;
+	uint32_t mask = data->index_size - 1, i, idx;
+
+	if (data->index_size == 0)
+		return -1;
 
-	for (i = 0; i < len; i++) {
-		struct spa_dict_item *item =
-		    pw_array_get_unchecked(&impl->items, i, struct spa_dict_item);
-		if (strcmp(item->key, key) == 0)
-			return i;
+	for (i = hash & mask; (idx = data->index[i]) != 0; i = (i + 1) & mask) {
+		const char *k = get_item(data, idx - 1)->key;
+		if (ATOM_FROM_KEY(k)->hash == hash && (k == key || strcmp(k, key) == 0))
+			return idx - 1;
 	}
 	return -1;
 }
 
+/* add a new item, takes ownership of value */
+static void add_func(struct pw_properties *this, const char *key, uint32_t hash, char *value)
+{
+	struct properties *impl = SPA_CONTAINER_OF(this, struct properties, this);
+	struct data *data = impl->data;
+	struct spa_dict_item *item;
+	const char *k;
+	uint32_t n = n_items(data);
+
+	if ((n + 1) * 2 > data->index_size && !rebuild_index(data, n + 1))
+		goto no_mem;
+
+	if ((k = intern_key(key, hash)) == NULL)
+		goto no_mem;
+
+	if ((item = pw_array_add(&data->items, sizeof(struct spa_dict_item))) == NULL) {
+		release_key(k);
+		goto no_mem;
+	}
+	item->key = k;
+	item->value = value;
+	index_insert(data, hash, n);
+
+	update_dict(impl);
+	return;
+
+      no_mem:
+	free(value);
+}
+
+static struct properties *properties_new(void)
+{
+	struct properties *impl;
+
+	impl = calloc(1, sizeof(struct properties));
+	if (impl == NULL)
+		return NULL;
+
+	if ((impl->data = data_new()) == NULL) {
+		free(impl);
+		return NULL;
+	}
+	update_dict(impl);
+
+	return impl;
+}
+
 /** Make a new properties object
  *
  * \param key a first key
@@ -77,16 +337,14 @@ struct pw_properties *pw_properties_new(const char *key, ...)
 	va_list varargs;
 	const char *value;
 
-	impl = calloc(1, sizeof(struct properties));
+	impl = properties_new();
 	if (impl == NULL)
 		return NULL;
 
-	pw_array_init(&impl->items, 16);
-
 	va_start(varargs, key);
 	while (key != NULL) {
 		value = va_arg(varargs, char *);
-		add_func(&impl->this, strdup(key), value ? strdup(value) : NULL);
+		pw_properties_set(&impl->this, key, value);
 		key = va_arg(varargs, char *);
 	}
 	va_end(varargs);
@@ -106,16 +364,13 @@ struct pw_properties *pw_properties_new_dict(const struct spa_dict *dict)
 	uint32_t i;
 	struct properties *impl;
 
-	impl = calloc(1, sizeof(struct properties));
+	impl = properties_new();
 	if (impl == NULL)
 		return NULL;
 
-	pw_array_init(&impl->items, 16);
-
 	for (i = 0; i < dict->n_items; i++) {
 		if (dict->items[i].key != NULL)
-			add_func(&impl->this, strdup(dict->items[i].key),
-				 dict->items[i].value ? strdup(dict->items[i].value) : NULL);
+			pw_properties_set(&impl->this, dict->items[i].key, dict->items[i].value);
 	}
 
 	return &impl->this;
@@ -126,22 +381,25 @@ struct pw_properties *pw_properties_new_dict(const struct spa_dict *dict)
  * \param properties properties to copy
  * \return a new properties object
  *
+ * The copy shares the keys and values with \a properties until one
+ * of them is changed.
+ *
  * \memberof pw_properties
  */
 struct pw_properties *pw_properties_copy(const struct pw_properties *properties)
 {
 	struct properties *impl = SPA_CONTAINER_OF(properties, struct properties, this);
-	struct pw_properties *copy;
-	struct spa_dict_item *item;
+	struct properties *copy;
 
-	copy = pw_properties_new(NULL, NULL);
+	copy = calloc(1, sizeof(struct properties));
 	if (copy == NULL)
 		return NULL;
 
-	pw_array_for_each(item, &impl->items)
-	    add_func(copy, strdup(item->key), item->value ? strdup(item->value) : NULL);
+	__atomic_add_fetch(&impl->data->refcount, 1, __ATOMIC_SEQ_CST);
+	copy->data = impl->data;
+	update_dict(copy);
 
-	return copy;
+	return &copy->this;
 }
 
 /** Merge properties into one
@@ -191,39 +449,52 @@ struct pw_properties *pw_properties_merge(const struct pw_properties *oldprops,
 void pw_properties_free(struct pw_properties *properties)
 {
 	struct properties *impl = SPA_CONTAINER_OF(properties, struct properties, this);
-	struct spa_dict_item *item;
-
-	pw_array_for_each(item, &impl->items)
-	    clear_item(item);
 
-	pw_array_clear(&impl->items);
+	data_unref(impl->data);
 	free(impl);
 }
 
-static void do_replace(struct pw_properties *properties, char *key, char *value)
+/* replace or remove the value of key, takes ownership of value */
+static void do_replace(struct pw_properties *properties, const char *key, char *value)
 {
 	struct properties *impl = SPA_CONTAINER_OF(properties, struct properties, this);
-	int index = find_index(properties, key);
+	uint32_t hash = hash_key(key);
+	int index = find_index(properties, key, hash);
+	struct spa_dict_item *item;
+	struct data *data;
 
 	if (index == -1) {
-		add_func(properties, key, value);
+		if (value == NULL)
+			return;
+		if (!make_writable(impl))
+			goto no_mem;
+		add_func(properties, key, hash, value);
+		return;
+	}
+
+	if (!make_writable(impl))
+		goto no_mem;
+
+	data = impl->data;
+	item = get_item(data, index);
+
+	free((char *) item->value);
+	if (value == NULL) {
+		struct spa_dict_item *other = get_item(data, n_items(data) - 1);
+
+		release_key(item->key);
+		item->key = other->key;
+		item->value = other->value;
+		data->items.size -= sizeof(struct spa_dict_item);
+		rebuild_index(data, n_items(data));
+		update_dict(impl);
 	} else {
-		struct spa_dict_item *item =
-		    pw_array_get_unchecked(&impl->items, index, struct spa_dict_item);
-
-		clear_item(item);
-		if (value == NULL) {
-			struct spa_dict_item *other = pw_array_get_unchecked(&impl->items,
-						     pw_array_get_len(&impl->items, struct spa_dict_item) - 1,
-						     struct spa_dict_item);
-			item->key = other->key;
-			item->value = other->value;
-			impl->items.size -= sizeof(struct spa_dict_item);
-		} else {
-			item->key = key;
-			item->value = value;
-		}
+		item->value = value;
 	}
+	return;
+
+      no_mem:
+	free(value);
 }
 
 /** Set a property value
@@ -240,7 +511,7 @@ static void do_replace(struct pw_properties *properties, char *key, char *value)
  */
 void pw_properties_set(struct pw_properties *properties, const char *key, const char *value)
 {
-	do_replace(properties, strdup(key), value ? strdup(value) : NULL);
+	do_replace(properties, key, value ? strdup(value) : NULL);
 }
 
 /** Set a property value by format
@@ -264,7 +535,7 @@ void pw_properties_setf(struct pw_properties *properties, const char *key, const
 	vasprintf(&value, format, varargs);
 	va_end(varargs);
 
-	do_replace(properties, strdup(key), value);
+	do_replace(properties, key, value);
 }
 
 /** Get a property
@@ -280,12 +551,12 @@ void pw_properties_setf(struct pw_properties *properties, const char *key, const
 const char *pw_properties_get(const struct pw_properties *properties, const char *key)
 {
 	struct properties *impl = SPA_CONTAINER_OF(properties, struct properties, this);
-	int index = find_index(properties, key);
+	int index = find_index(properties, key, hash_key(key));
 
 	if (index == -1)
 		return NULL;
 
-	return pw_array_get_unchecked(&impl->items, index, struct spa_dict_item)->value;
+	return get_item(impl->data, index)->value;
 }
 
 /** Iterate property values
@@ -311,10 +582,10 @@ const char *pw_properties_iterate(const struct pw_properties *properties, void *
 	else
 		index = SPA_PTR_TO_INT(*state);
 
-	if (!pw_array_check_index(&impl->items, index, struct spa_dict_item))
+	if (index >= n_items(impl->data))
 		 return NULL;
 
 	*state = SPA_INT_TO_PTR(index + 1);
 
-	return pw_array_get_unchecked(&impl->items, index, struct spa_dict_item)->key;
+	return get_item(impl->data, index)->key;
 }
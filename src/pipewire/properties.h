@@ -34,6 +34,9 @@
  * Both keys and values are strings which keeps things simple.
  * Encoding of arbitrary values should be done by using a string
  * serialization such as base64 for binary blobs.
+ *
+ * Keys are interned and looked up with a hash index. Copies share
+ * their keys and values until one of them is changed.
  */
 struct pw_properties {
 	struct spa_dict dict;
@@ -21,6 +21,7 @@
 #include <sys/socket.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <time.h>
 
@@ -41,12 +42,25 @@
 #define MAX_FDS         32
 #define MAX_INPUTS      64
 #define MAX_OUTPUTS     64
+#define MAX_UNUSED_MAPPINGS	8
 
+/* a mapping of the start of a file, shared by all mem_ids that refer to
+ * the same file, also when they were sent with a different fd */
+struct mapping {
+	struct spa_list link;
+	dev_t dev;
+	ino_t ino;
+	void *ptr;
+	size_t size;
+	uint32_t ref;
+};
+
+/* mem_ids are stored at their id, unused entries have fd -1 */
 struct mem_id {
 	uint32_t id;
 	int fd;
 	uint32_t flags;
-	void *ptr;
+	struct mapping *map;
 	uint32_t offset;
 	uint32_t size;
 };
@@ -87,12 +101,16 @@ struct stream {
 	struct spa_hook proxy_listener;
 
 	struct pw_client_node_transport *trans;
+	int time_readers;		/**< pw_stream_get_time calls reading trans */
+	struct pw_array retired;	/**< replaced transports, freed when no
+					  *  pw_stream_get_time reads them */
 
 	struct spa_source *timeout_source;
 
 	struct pw_array mem_ids;
-	struct pw_array buffer_ids;
-	bool in_order;
+	struct pw_array buffer_ids;	/**< buffers at their id, unused entries
+					  *  have no buf */
+	struct spa_list mappings;	/**< most recently used first */
 
 	struct spa_list free;
 	bool in_need_buffer;
@@ -103,11 +121,85 @@ struct stream {
 };
 /** \endcond */
 
+static struct mapping *get_mapping(struct stream *impl, int fd, size_t size)
+{
+	struct mapping *map;
+	struct stat st;
+
+	if (fstat(fd, &st) < 0) {
+		pw_log_warn("Failed to stat memory fd %d: %s", fd, strerror(errno));
+		return NULL;
+	}
+
+	spa_list_for_each(map, &impl->mappings, link) {
+		if (map->dev == st.st_dev && map->ino == st.st_ino && map->size >= size) {
+			pw_log_debug("stream %p: reuse mapping %p of fd %d", impl, map, fd);
+			spa_list_remove(&map->link);
+			goto found;
+		}
+	}
+
+	if ((map = calloc(1, sizeof(struct mapping))) == NULL)
+		return NULL;
+
+	map->ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map->ptr == MAP_FAILED) {
+		pw_log_warn("Failed to mmap memory %zd: %s", size, strerror(errno));
+		free(map);
+		return NULL;
+	}
+	map->dev = st.st_dev;
+	map->ino = st.st_ino;
+	map->size = size;
+
+      found:
+	spa_list_insert(&impl->mappings, &map->link);
+	map->ref++;
+	return map;
+}
+
+static void free_mapping(struct mapping *map)
+{
+	spa_list_remove(&map->link);
+	munmap(map->ptr, map->size);
+	free(map);
+}
+
+/* keep some unused mappings around, the server might send the same
+ * memory again after a renegotiation */
+static void trim_mappings(struct stream *impl, uint32_t max_unused)
+{
+	struct mapping *map, *t;
+	uint32_t n_unused = 0;
+
+	spa_list_for_each_safe(map, t, &impl->mappings, link) {
+		if (map->ref == 0 && ++n_unused > max_unused)
+			free_mapping(map);
+	}
+}
+
+static struct mem_id *add_mem_id(struct stream *impl, uint32_t id)
+{
+	uint32_t i, len = pw_array_get_len(&impl->mem_ids, struct mem_id);
+	struct mem_id *mid;
+
+	if (id >= len) {
+		if (pw_array_add(&impl->mem_ids, (id + 1 - len) * sizeof(struct mem_id)) == NULL)
+			return NULL;
+		for (i = len; i <= id; i++) {
+			mid = pw_array_get_unchecked(&impl->mem_ids, i, struct mem_id);
+			mid->fd = -1;
+			mid->map = NULL;
+		}
+	}
+	return pw_array_get_unchecked(&impl->mem_ids, id, struct mem_id);
+}
+
 static void clear_memid(struct stream *impl, struct mem_id *mid)
 {
-	if (mid->ptr != NULL)
-		munmap(mid->ptr, mid->size + mid->offset);
-	mid->ptr = NULL;
+	if (mid->map != NULL)
+		mid->map->ref--;
+	mid->map = NULL;
 	if (mid->fd != -1) {
 		bool has_ref = false;
 		int fd;
@@ -134,6 +226,7 @@ static void clear_mems(struct pw_stream *stream)
 	pw_array_for_each(mid, &impl->mem_ids)
 	    clear_memid(impl, mid);
 	impl->mem_ids.size = 0;
+	trim_mappings(impl, MAX_UNUSED_MAPPINGS);
 }
 
 static void clear_buffers(struct pw_stream *stream)
@@ -144,16 +237,51 @@ static void clear_buffers(struct pw_stream *stream)
 	pw_log_debug("stream %p: clear buffers", stream);
 
 	pw_array_for_each(bid, &impl->buffer_ids) {
+		if (bid->buf == NULL)
+			continue;
 		spa_hook_list_call(&stream->listener_list, struct pw_stream_events, remove_buffer, bid->id);
 		free(bid->buf);
 		bid->buf = NULL;
 		bid->used = false;
 	}
 	impl->buffer_ids.size = 0;
-	impl->in_order = true;
 	spa_list_init(&impl->free);
 }
 
+/* free the replaced transports when no pw_stream_get_time reads them, or
+ * all of them when @force is set */
+static void free_retired(struct stream *impl, bool force)
+{
+	struct pw_client_node_transport **t;
+
+	if (impl->retired.size == 0)
+		return;
+	if (!force && __atomic_load_n(&impl->time_readers, __ATOMIC_SEQ_CST) > 0)
+		return;
+
+	pw_array_for_each(t, &impl->retired)
+		pw_client_node_transport_destroy(*t);
+	impl->retired.size = 0;
+}
+
+/* replace the transport. pw_stream_get_time can read the clock of the old
+ * transport from another thread, so it is only freed when no reader uses
+ * it anymore, at the latest with the next replacement or the stream */
+static void set_transport(struct stream *impl, struct pw_client_node_transport *trans)
+{
+	struct pw_client_node_transport *old = impl->trans, **t;
+
+	__atomic_store_n(&impl->trans, trans, __ATOMIC_SEQ_CST);
+
+	if (old) {
+		if ((t = pw_array_add(&impl->retired, sizeof(old))) != NULL)
+			*t = old;
+		else
+			pw_log_warn("stream %p: leaking transport %p", impl, old);
+	}
+	free_retired(impl, false);
+}
+
 static bool stream_set_state(struct pw_stream *stream, enum pw_stream_state state, char *error)
 {
 	enum pw_stream_state old = stream->state;
@@ -231,8 +359,10 @@ struct pw_stream *pw_stream_new(struct pw_remote *remote,
 	pw_array_ensure_size(&impl->mem_ids, sizeof(struct mem_id) * 64);
 	pw_array_init(&impl->buffer_ids, 32);
 	pw_array_ensure_size(&impl->buffer_ids, sizeof(struct buffer_id) * 64);
+	pw_array_init(&impl->retired, 4);
 	impl->pending_seq = SPA_ID_INVALID;
 	spa_list_init(&impl->free);
+	spa_list_init(&impl->mappings);
 
 	spa_list_insert(&remote->stream_list, &this->link);
 
@@ -367,6 +497,10 @@ void pw_stream_destroy(struct pw_stream *stream)
 
 	clear_mems(stream);
 	pw_array_clear(&impl->mem_ids);
+	trim_mappings(impl, 0);
+
+	free_retired(impl, true);
+	pw_array_clear(&impl->retired);
 
 	if (stream->properties)
 		pw_properties_free(stream->properties);
@@ -472,28 +606,23 @@ static struct mem_id *find_mem(struct pw_stream *stream, uint32_t id)
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
 	struct mem_id *mid;
 
-	pw_array_for_each(mid, &impl->mem_ids) {
-		if (mid->id == id)
-			return mid;
-	}
-	return NULL;
+	if (!pw_array_check_index(&impl->mem_ids, id, struct mem_id))
+		return NULL;
+
+	mid = pw_array_get_unchecked(&impl->mem_ids, id, struct mem_id);
+	return mid->fd != -1 ? mid : NULL;
 }
 
 static struct buffer_id *find_buffer(struct pw_stream *stream, uint32_t id)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct buffer_id *bid;
 
-	if (impl->in_order && pw_array_check_index(&impl->buffer_ids, id, struct buffer_id)) {
-		return pw_array_get_unchecked(&impl->buffer_ids, id, struct buffer_id);
-	} else {
-		struct buffer_id *bid;
+	if (!pw_array_check_index(&impl->buffer_ids, id, struct buffer_id))
+		return NULL;
 
-		pw_array_for_each(bid, &impl->buffer_ids) {
-			if (bid->id == id)
-				return bid;
-		}
-	}
-	return NULL;
+	bid = pw_array_get_unchecked(&impl->buffer_ids, id, struct buffer_id);
+	return bid->buf ? bid : NULL;
 }
 
 static inline void reuse_buffer(struct pw_stream *stream, uint32_t id)
@@ -735,14 +864,18 @@ client_node_add_mem(void *data,
 			     mem_id, memfd, flags, offset, size);
 		clear_memid(impl, m);
 	} else {
-		m = pw_array_add(&impl->mem_ids, sizeof(struct mem_id));
+		if ((m = add_mem_id(impl, mem_id)) == NULL) {
+			pw_log_error("can't add mem %u", mem_id);
+			close(memfd);
+			return;
+		}
 		pw_log_debug("add mem %u, fd %d, flags %d, off %d, size %d",
 			     mem_id, memfd, flags, offset, size);
 	}
 	m->id = mem_id;
 	m->fd = memfd;
 	m->flags = flags;
-	m->ptr = NULL;
+	m->map = NULL;
 	m->offset = offset;
 	m->size = size;
 }
@@ -756,12 +889,23 @@ client_node_use_buffers(void *data,
 	struct stream *impl = data;
 	struct pw_stream *stream = &impl->this;
 	struct buffer_id *bid;
-	uint32_t i, j, len;
+	uint32_t i, j, max_id;
 	struct spa_buffer *b;
 
 	/* clear previous buffers */
 	clear_buffers(stream);
 
+	/* make room for all buffer ids now, the free list points into the array */
+	for (i = 0, max_id = 0; i < n_buffers; i++)
+		max_id = SPA_MAX(max_id, buffers[i].buffer->id + 1);
+	if (max_id > 0) {
+		if ((bid = pw_array_add(&impl->buffer_ids, max_id * sizeof(struct buffer_id))) == NULL) {
+			pw_log_error("can't add %u buffers", max_id);
+			n_buffers = 0;
+		} else
+			memset(bid, 0, max_id * sizeof(struct buffer_id));
+	}
+
 	for (i = 0; i < n_buffers; i++) {
 		off_t offset;
 
@@ -771,19 +915,17 @@ client_node_use_buffers(void *data,
 			continue;
 		}
 
-		if (mid->ptr == NULL) {
-			mid->ptr =
-			    mmap(NULL, mid->size + mid->offset, PROT_READ | PROT_WRITE, MAP_SHARED,
-				 mid->fd, 0);
-			if (mid->ptr == MAP_FAILED) {
-				mid->ptr = NULL;
-				pw_log_warn("Failed to mmap memory %d %p: %s", mid->size, mid,
-					    strerror(errno));
+		if (mid->map == NULL) {
+			mid->map = get_mapping(impl, mid->fd, mid->size + mid->offset);
+			if (mid->map == NULL)
 				continue;
-			}
 		}
-		len = pw_array_get_len(&impl->buffer_ids, struct buffer_id);
-		bid = pw_array_add(&impl->buffer_ids, sizeof(struct buffer_id));
+		bid = pw_array_get_unchecked(&impl->buffer_ids, buffers[i].buffer->id,
+					     struct buffer_id);
+		if (bid->buf != NULL) {
+			pw_log_warn("duplicate buffer id %u", buffers[i].buffer->id);
+			continue;
+		}
 		if (impl->direction == SPA_DIRECTION_OUTPUT) {
 			bid->used = false;
 			spa_list_insert(impl->free.prev, &bid->link);
@@ -793,7 +935,7 @@ client_node_use_buffers(void *data,
 
 		b = buffers[i].buffer;
 
-		bid->buf_ptr = SPA_MEMBER(mid->ptr, mid->offset + buffers[i].offset, void);
+		bid->buf_ptr = SPA_MEMBER(mid->map->ptr, mid->offset + buffers[i].offset, void);
 		{
 			size_t size;
 
@@ -813,10 +955,6 @@ client_node_use_buffers(void *data,
 		}
 		bid->id = b->id;
 
-		if (bid->id != len) {
-			pw_log_warn("unexpected id %u found, expected %u", bid->id, len);
-			impl->in_order = false;
-		}
 		pw_log_debug("add buffer %d %d %u", mid->id, bid->id, buffers[i].offset);
 
 		offset = 0;
@@ -887,9 +1025,7 @@ static void client_node_transport(void *data, uint32_t node_id,
 
 	stream->node_id = node_id;
 
-	if (impl->trans)
-		pw_client_node_transport_destroy(impl->trans);
-	impl->trans = transport;
+	set_transport(impl, transport);
 
 	pw_log_info("stream %p: create client transport %p with fds %d %d for node %u",
 			stream, impl->trans, readfd, writefd, node_id);
@@ -1015,20 +1151,37 @@ void pw_stream_disconnect(struct pw_stream *stream)
 		pw_client_node_proxy_destroy(impl->node_proxy);
 		impl->node_proxy = NULL;
 	}
-	if (impl->trans) {
-		pw_client_node_transport_destroy(impl->trans);
-		impl->trans = NULL;
-	}
+	set_transport(impl, NULL);
 }
 
 bool pw_stream_get_time(struct pw_stream *stream, struct pw_time *time)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct pw_client_node_transport *trans;
+	struct pw_client_node_clock clock;
 	int64_t elapsed;
 	struct timespec ts;
+	bool have_clock;
 
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 	time->now = SPA_TIMESPEC_TO_TIME(&ts);
+
+	/* the server publishes the clock of the driver in the transport. A
+	 * replaced transport is not freed while we read it, see free_retired */
+	__atomic_fetch_add(&impl->time_readers, 1, __ATOMIC_SEQ_CST);
+	trans = __atomic_load_n(&impl->trans, __ATOMIC_SEQ_CST);
+	have_clock = trans && pw_client_node_clock_read(&trans->area->clock, &clock);
+	__atomic_fetch_sub(&impl->time_readers, 1, __ATOMIC_RELEASE);
+
+	/* fall back to the last clock update when it has not done so yet */
+	if (have_clock && clock.rate > 0) {
+		elapsed = time->now - clock.monotonic_time;
+		time->ticks = clock.ticks +
+			(int64_t) (elapsed * clock.rate * clock.rate_diff / SPA_NSEC_PER_SEC);
+		time->rate = clock.rate;
+		return true;
+	}
+
 	elapsed = (time->now - impl->last_monotonic) / 1000;
 
 	time->ticks = impl->last_ticks + (elapsed * impl->last_rate) / SPA_USEC_PER_SEC;
@@ -293,7 +293,8 @@ pw_stream_finish_format(struct pw_stream *stream,	/**< a \ref pw_stream */
 			struct spa_param **params,	/**< an array of pointers to \ref spa_param */
 			uint32_t n_params		/**< number of elements in \a params */);
 
-/** Query the time on the stream \memberof pw_stream */
+/** Query the time on the stream. This does not send messages and takes no
+ * locks, it can be called from any thread \memberof pw_stream */
 bool pw_stream_get_time(struct pw_stream *stream, struct pw_time *time);
 
 /** Get the id of an empty buffer that can be filled \memberof pw_stream
@@ -0,0 +1,127 @@
+/* PipeWire
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <pipewire/mem.h>
+
+#define N_BLOCKS	80
+
+#define FLAGS	(PW_MEMBLOCK_FLAG_WITH_FD | PW_MEMBLOCK_FLAG_MAP_READWRITE)
+
+/* allocate more blocks of one size than fit in a region, every block
+ * must get its own memory and the pool must be empty again after */
+static void test_fill(size_t size)
+{
+	struct pw_mempool *pool;
+	struct pw_mempool_stats stats;
+	struct pw_memblock mem[N_BLOCKS];
+	int tag, i, j;
+
+	pool = pw_mempool_new(0);
+	assert(pool != NULL);
+
+	for (i = 0; i < N_BLOCKS; i++) {
+		assert(pw_mempool_alloc(pool, FLAGS, size, &tag, &mem[i]) == SPA_RESULT_OK);
+		assert(mem[i].size == size);
+
+		for (j = 0; j < i; j++)
+			assert(mem[i].fd != mem[j].fd || mem[i].offset != mem[j].offset);
+
+		memset(mem[i].ptr, i, size);
+	}
+	for (i = 0; i < N_BLOCKS; i++)
+		assert(((uint8_t *) mem[i].ptr)[size - 1] == i);
+
+	pw_mempool_get_stats(pool, &stats);
+	assert(stats.n_allocs == N_BLOCKS);
+	assert(stats.used >= N_BLOCKS * size);
+
+	for (i = 0; i < N_BLOCKS; i++)
+		pw_mempool_free(pool, &mem[i]);
+
+	pw_mempool_get_stats(pool, &stats);
+	assert(stats.used == 0);
+	assert(stats.resident == 0);
+
+	pw_mempool_destroy(pool);
+
+	printf("fill %zd: ok\n", size);
+}
+
+/* a freed slot is used again and cleared */
+static void test_reuse(void)
+{
+	struct pw_mempool *pool;
+	struct pw_memblock a, b;
+	int tag;
+
+	pool = pw_mempool_new(1024 * 1024);
+	assert(pool != NULL);
+
+	assert(pw_mempool_alloc(pool, FLAGS, 4096, &tag, &a) == SPA_RESULT_OK);
+	memset(a.ptr, 0xff, 4096);
+	pw_mempool_free(pool, &a);
+
+	assert(pw_mempool_alloc(pool, FLAGS, 4096, &tag, &b) == SPA_RESULT_OK);
+	assert(((uint8_t *) b.ptr)[0] == 0);
+	assert(((uint8_t *) b.ptr)[4095] == 0);
+	pw_mempool_free(pool, &b);
+
+	pw_mempool_destroy(pool);
+
+	printf("reuse: ok\n");
+}
+
+/* a large block is not rounded up to a power of two */
+static void test_large(void)
+{
+	struct pw_mempool *pool;
+	struct pw_mempool_stats stats;
+	struct pw_memblock mem;
+	size_t size = 5 * 1024 * 1024 + 100;
+	int tag;
+
+	pool = pw_mempool_new(0);
+	assert(pool != NULL);
+
+	assert(pw_mempool_alloc(pool, FLAGS, size, &tag, &mem) == SPA_RESULT_OK);
+	assert(mem.size == size);
+
+	pw_mempool_get_stats(pool, &stats);
+	assert(stats.resident == SPA_ROUND_UP_N(size, 4096));
+
+	pw_mempool_free(pool, &mem);
+	pw_mempool_destroy(pool);
+
+	printf("large: ok\n");
+}
+
+int main(int argc, char *argv[])
+{
+	test_fill(4096);
+	test_fill(8192);
+	test_fill(64 * 1024);
+	test_reuse();
+	test_large();
+
+	return 0;
+}